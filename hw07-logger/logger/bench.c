@@ -0,0 +1,156 @@
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <time.h>
+
+#include "logger.h"
+
+// Бенчмарк логгера: сообщений в секунду и задержка вызова logger_log
+// для 1..N потоков, разных размеров сообщений и режимов sync/async.
+// Результат выводится в stdout в виде JSON, по объекту на строку
+
+#define DEFAULT_MAX_THREADS 8
+#define DEFAULT_MESSAGES 100000
+#define DEFAULT_LOG_PATH "bench.log"
+
+static const size_t msg_sizes[] = { 16, 128, 512 };
+
+typedef struct {
+    Logger* logger;
+    const char* message;
+    size_t messages;
+    uint64_t* latency;
+    pthread_barrier_t* barrier;
+    uint64_t start;
+} BenchThread;
+
+static uint64_t now_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static int u64_compare(const void* a, const void* b) {
+    uint64_t va = *(const uint64_t*)a;
+    uint64_t vb = *(const uint64_t*)b;
+    return (va > vb) - (va < vb);
+}
+
+static uint64_t percentile(const uint64_t* sorted, size_t count, double p) {
+    size_t index = (size_t)(p * (count - 1));
+    return sorted[index];
+}
+
+static void* bench_producer(void* arg) {
+    BenchThread* data = (BenchThread*)arg;
+
+    pthread_barrier_wait(data->barrier);
+    data->start = now_ns();
+    for (size_t i = 0; i < data->messages; i++) {
+        uint64_t start = now_ns();
+        logger_info(data->logger, data->message);
+        data->latency[i] = now_ns() - start;
+    }
+
+    return NULL;
+}
+
+static void bench_run(LoggerMode_t mode, size_t thread_count, size_t msg_size,
+                      size_t messages, const char* log_path) {
+    remove(log_path);
+    Logger* logger = logger_create(mode);
+    if (logger_add_file_sink(logger, log_path, DEBUG) != 0) {
+        logger_free(logger);
+        exit(EXIT_FAILURE);
+    }
+
+    char* message = malloc(msg_size + 1);
+    memset(message, 'x', msg_size);
+    message[msg_size] = '\0';
+
+    const size_t total = thread_count * messages;
+    uint64_t* latency = malloc(sizeof(uint64_t) * total);
+
+    pthread_t threads[thread_count];
+    BenchThread thread_data[thread_count];
+    pthread_barrier_t barrier;
+    pthread_barrier_init(&barrier, NULL, thread_count + 1);
+
+    for (size_t i = 0; i < thread_count; i++) {
+        thread_data[i].logger = logger;
+        thread_data[i].message = message;
+        thread_data[i].messages = messages;
+        thread_data[i].latency = latency + i * messages;
+        thread_data[i].barrier = &barrier;
+        if (pthread_create(&threads[i], NULL, bench_producer, &thread_data[i]) != 0) {
+            fprintf(stderr, "Error creating thread %zu\n", i);
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    // Отсчет от первого потока, прошедшего барьер: главный поток может
+    // получить процессор только после того, как потоки уже все записали
+    pthread_barrier_wait(&barrier);
+    for (size_t i = 0; i < thread_count; i++)
+        pthread_join(threads[i], NULL);
+    uint64_t produced = now_ns();
+    uint64_t start = produced;
+    for (size_t i = 0; i < thread_count; i++) {
+        if (thread_data[i].start < start)
+            start = thread_data[i].start;
+    }
+    logger_flush(logger);
+    uint64_t finish = now_ns();
+
+    qsort(latency, total, sizeof(uint64_t), u64_compare);
+
+    const double seconds = (finish - start) / 1e9;
+    printf("{\"mode\":\"%s\",\"threads\":%zu,\"msg_size\":%zu,\"messages\":%zu,"
+           "\"seconds\":%.6f,\"produce_seconds\":%.6f,\"msgs_per_sec\":%.0f,"
+           "\"p50_ns\":%" PRIu64 ",\"p99_ns\":%" PRIu64 ",\"p999_ns\":%" PRIu64 ",\"max_ns\":%" PRIu64 "}\n",
+           mode == LOGGER_ASYNC ? "async" : "sync", thread_count, msg_size, total,
+           seconds, (produced - start) / 1e9, total / seconds,
+           percentile(latency, total, 0.50), percentile(latency, total, 0.99),
+           percentile(latency, total, 0.999), latency[total - 1]);
+    fflush(stdout);
+
+    pthread_barrier_destroy(&barrier);
+    free(latency);
+    free(message);
+    logger_free(logger);
+}
+
+int main(int argc, char* argv[]) {
+    size_t max_threads = DEFAULT_MAX_THREADS;
+    size_t messages = DEFAULT_MESSAGES;
+    const char* log_path = DEFAULT_LOG_PATH;
+
+    if (argc >= 2)
+        max_threads = strtoul(argv[1], NULL, 10);
+    if (argc >= 3)
+        messages = strtoul(argv[2], NULL, 10);
+    if (argc >= 4)
+        log_path = argv[3];
+
+    if (max_threads == 0 || messages == 0) {
+        fprintf(stderr, "Usage: %s [max_threads] [messages_per_thread] [log_path]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    const LoggerMode_t modes[] = { LOGGER_SYNC, LOGGER_ASYNC };
+    for (size_t m = 0; m < sizeof(modes) / sizeof(modes[0]); m++) {
+        for (size_t s = 0; s < sizeof(msg_sizes) / sizeof(msg_sizes[0]); s++) {
+            for (size_t threads = 1; threads <= max_threads; threads++) {
+                bench_run(modes[m], threads, msg_sizes[s], messages, log_path);
+            }
+        }
+    }
+
+    remove(log_path);
+    return EXIT_SUCCESS;
+}
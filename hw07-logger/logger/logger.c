@@ -3,47 +3,373 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <signal.h>
+#include <syslog.h>
+#include <unistd.h>
 #include <pthread.h>
 #include <execinfo.h>
+#include <stdatomic.h>
+#include <sys/socket.h>
+#include <sys/un.h>
 
-struct Logger {
+#define LOG_MSG_LEN 1024
+#define LOG_LINE_LEN 4096
+#define LOG_TRACE_DEPTH 10
+#define LOG_QUEUE_LEN 1024
+#define LOG_MAX_SINKS 8
+#define LOG_LEVEL_OFF (ERROR + 1)
+
+typedef enum {
+    SINK_FILE = 0,
+    SINK_SYSLOG,
+    SINK_SOCKET,
+    SINK_MEMORY
+} LogSinkType_t;
+
+typedef struct {
+    LogSinkType_t type;
+    LogType_t level;
     FILE* fp;
-    char* file_path;
+    char* path;
+    int sock;
+    char* ring;
+    size_t ring_cap;
+    size_t ring_head;
+    int ring_full;
+} LogSink;
+
+// Сообщение в очереди: форматирование и символизация стека
+// выполняются уже в фоновом потоке
+typedef struct {
+    LogType_t type;
+    int line;
+    const char* func;
+    const char* file;
+    int trace_size;
+    void* trace[LOG_TRACE_DEPTH];
+    char message[LOG_MSG_LEN];
+} LogRecord;
+
+struct Logger {
+    LoggerMode_t mode;
+    atomic_int min_level;
+
+    LogSink sinks[LOG_MAX_SINKS];
+    size_t sink_count;
+    pthread_mutex_t sink_mutex;
+
+    LogRecord* queue;
+    size_t head;
+    size_t count;
+    int stop;
     pthread_mutex_t mutex;
+    pthread_cond_t not_empty;
+    pthread_cond_t not_full;
+    pthread_cond_t drained;
+    pthread_t worker;
 };
 
-void logger_log_trace(Logger *logger) {
-    if (logger->fp == NULL) {
-        return;
+static Logger* crash_logger = NULL;
+
+static const char* logger_prefix(LogType_t log_type) {
+    switch(log_type) {
+        case DEBUG  : return "[DEBUG]";
+        case INFO   : return "[INFO ]";
+        case WARNING: return "[WARN ]";
+        case ERROR  : return "[ERROR]";
+        default     : return "[LOG  ]";
     }
+}
 
-    void *array[10];
-    char **strings;
-    int size, i;
+static int logger_syslog_priority(LogType_t log_type) {
+    switch(log_type) {
+        case DEBUG  : return LOG_DEBUG;
+        case INFO   : return LOG_INFO;
+        case WARNING: return LOG_WARNING;
+        case ERROR  : return LOG_ERR;
+        default     : return LOG_NOTICE;
+    }
+}
+
+static size_t logger_format(const LogRecord* rec, char* buf, size_t buf_len) {
+    int len = snprintf(buf, buf_len, "%s\t%s:%d\tfunction \'%s\'\t\t%s\n",
+                       logger_prefix(rec->type), rec->file, rec->line, rec->func, rec->message);
+    if (len < 0)
+        return 0;
+    if ((size_t)len >= buf_len)
+        len = buf_len - 1;
 
-    size = backtrace(array, 10);
-    strings = backtrace_symbols(array, size);
-    if (strings != NULL) {
-        for (i = 0; i < size; i++)
-            fprintf(logger->fp, "%s\n", strings[i]);
+    if (rec->trace_size > 0) {
+        char **strings = backtrace_symbols(rec->trace, rec->trace_size);
+        if (strings != NULL) {
+            for (int i = 0; i < rec->trace_size && (size_t)len < buf_len - 1; i++) {
+                int n = snprintf(buf + len, buf_len - len, "%s\n", strings[i]);
+                if (n < 0)
+                    break;
+                len += n;
+                if ((size_t)len >= buf_len)
+                    len = buf_len - 1;
+            }
+        }
+        free(strings);
     }
 
-    free(strings);
+    return len;
 }
 
-Logger *logger_init(const char *file_path) {
-    Logger* logger = (Logger*)malloc(sizeof(Logger));
-    const size_t file_path_len = strlen(file_path) + 1;
-    logger->file_path = (char*)malloc(file_path_len);
-    memcpy(logger->file_path, file_path, file_path_len);
-    logger->fp = fopen(file_path, "a");
-    if (logger->fp == NULL) {
-        perror(file_path);
+static void sink_ring_write(LogSink* sink, const char* data, size_t len) {
+    if (len > sink->ring_cap) {
+        data += len - sink->ring_cap;
+        len = sink->ring_cap;
+    }
+    size_t tail = sink->ring_cap - sink->ring_head;
+    if (len < tail) {
+        memcpy(sink->ring + sink->ring_head, data, len);
+        sink->ring_head += len;
+    } else {
+        memcpy(sink->ring + sink->ring_head, data, tail);
+        memcpy(sink->ring, data + tail, len - tail);
+        sink->ring_head = len - tail;
+        sink->ring_full = 1;
+    }
+}
+
+static void sink_write(LogSink* sink, LogType_t log_type, const char* line, size_t len) {
+    switch (sink->type) {
+        case SINK_FILE:
+            fwrite(line, 1, len, sink->fp);
+            break;
+        case SINK_SYSLOG:
+            syslog(logger_syslog_priority(log_type), "%.*s", (int)len, line);
+            break;
+        case SINK_SOCKET:
+            send(sink->sock, line, len, MSG_DONTWAIT);
+            break;
+        case SINK_MEMORY:
+            sink_ring_write(sink, line, len);
+            break;
+    }
+}
+
+static void sink_close(LogSink* sink) {
+    switch (sink->type) {
+        case SINK_FILE:
+            fclose(sink->fp);
+            break;
+        case SINK_SYSLOG:
+            closelog();
+            break;
+        case SINK_SOCKET:
+            close(sink->sock);
+            break;
+        case SINK_MEMORY:
+            free(sink->ring);
+            break;
     }
+    free(sink->path);
+}
+
+// Раздача одного сообщения всем приемникам подходящего уровня.
+// Вызывается под sink_mutex
+static void logger_dispatch(Logger* logger, const LogRecord* rec) {
+    char line[LOG_LINE_LEN];
+    size_t len = 0;
+
+    for (size_t i = 0; i < logger->sink_count; i++) {
+        LogSink* sink = &logger->sinks[i];
+        if (rec->type < sink->level)
+            continue;
+        if (len == 0)
+            len = logger_format(rec, line, sizeof(line));
+        sink_write(sink, rec->type, line, len);
+    }
+}
+
+static void logger_flush_sinks(Logger* logger) {
+    for (size_t i = 0; i < logger->sink_count; i++) {
+        if (logger->sinks[i].type == SINK_FILE)
+            fflush(logger->sinks[i].fp);
+    }
+}
+
+static void* logger_worker(void* arg) {
+    Logger* logger = (Logger*)arg;
+
+    pthread_mutex_lock(&logger->mutex);
+    for (;;) {
+        while (logger->count == 0 && !logger->stop)
+            pthread_cond_wait(&logger->not_empty, &logger->mutex);
+        if (logger->count == 0 && logger->stop)
+            break;
+
+        // Записи [head, head + batch) не перезаписываются, пока count не уменьшен
+        size_t head = logger->head;
+        size_t batch = logger->count;
+        pthread_mutex_unlock(&logger->mutex);
+
+        pthread_mutex_lock(&logger->sink_mutex);
+        for (size_t i = 0; i < batch; i++)
+            logger_dispatch(logger, &logger->queue[(head + i) % LOG_QUEUE_LEN]);
+        logger_flush_sinks(logger);
+        pthread_mutex_unlock(&logger->sink_mutex);
+
+        pthread_mutex_lock(&logger->mutex);
+        logger->head = (head + batch) % LOG_QUEUE_LEN;
+        logger->count -= batch;
+        pthread_cond_broadcast(&logger->not_full);
+        if (logger->count == 0)
+            pthread_cond_broadcast(&logger->drained);
+    }
+    pthread_mutex_unlock(&logger->mutex);
+
+    return NULL;
+}
+
+static void logger_update_level(Logger* logger) {
+    int level = LOG_LEVEL_OFF;
+    for (size_t i = 0; i < logger->sink_count; i++) {
+        if ((int)logger->sinks[i].level < level)
+            level = logger->sinks[i].level;
+    }
+    atomic_store(&logger->min_level, level);
+}
+
+static LogSink* logger_new_sink(Logger* logger, LogSinkType_t type, LogType_t min_level) {
+    if (logger->sink_count == LOG_MAX_SINKS) {
+        fprintf(stderr, "Logger sink limit (%d) reached\n", LOG_MAX_SINKS);
+        return NULL;
+    }
+    LogSink* sink = &logger->sinks[logger->sink_count];
+    memset(sink, 0, sizeof(LogSink));
+    sink->type = type;
+    sink->level = min_level;
+    sink->sock = -1;
+    return sink;
+}
+
+static void logger_commit_sink(Logger* logger) {
+    logger->sink_count++;
+    logger_update_level(logger);
+}
+
+Logger *logger_create(LoggerMode_t mode) {
+    Logger* logger = (Logger*)calloc(1, sizeof(Logger));
+    logger->mode = mode;
+    atomic_init(&logger->min_level, LOG_LEVEL_OFF);
+    pthread_mutex_init(&logger->sink_mutex, NULL);
     pthread_mutex_init(&logger->mutex, NULL);
+
+    if (mode == LOGGER_ASYNC) {
+        logger->queue = (LogRecord*)malloc(sizeof(LogRecord) * LOG_QUEUE_LEN);
+        pthread_cond_init(&logger->not_empty, NULL);
+        pthread_cond_init(&logger->not_full, NULL);
+        pthread_cond_init(&logger->drained, NULL);
+        if (pthread_create(&logger->worker, NULL, logger_worker, logger) != 0) {
+            perror("logger worker");
+            free(logger->queue);
+            logger->queue = NULL;
+            logger->mode = LOGGER_SYNC;
+        }
+    }
+
     return logger;
 }
 
+Logger *logger_init(const char *file_path) {
+    Logger* logger = logger_create(LOGGER_ASYNC);
+    logger_add_file_sink(logger, file_path, DEBUG);
+    return logger;
+}
+
+int logger_add_file_sink(Logger *logger, const char *file_path, LogType_t min_level) {
+    pthread_mutex_lock(&logger->sink_mutex);
+    LogSink* sink = logger_new_sink(logger, SINK_FILE, min_level);
+    if (sink == NULL) {
+        pthread_mutex_unlock(&logger->sink_mutex);
+        return -1;
+    }
+    sink->fp = fopen(file_path, "a");
+    if (sink->fp == NULL) {
+        perror(file_path);
+        pthread_mutex_unlock(&logger->sink_mutex);
+        return -1;
+    }
+    sink->path = strdup(file_path);
+    logger_commit_sink(logger);
+    pthread_mutex_unlock(&logger->sink_mutex);
+    return 0;
+}
+
+int logger_add_syslog_sink(Logger *logger, const char *ident, LogType_t min_level) {
+    pthread_mutex_lock(&logger->sink_mutex);
+    LogSink* sink = logger_new_sink(logger, SINK_SYSLOG, min_level);
+    if (sink == NULL) {
+        pthread_mutex_unlock(&logger->sink_mutex);
+        return -1;
+    }
+    // openlog() хранит указатель на ident, поэтому копия живет вместе с приемником
+    sink->path = ident != NULL ? strdup(ident) : NULL;
+    openlog(sink->path, LOG_PID | LOG_NDELAY, LOG_USER);
+    logger_commit_sink(logger);
+    pthread_mutex_unlock(&logger->sink_mutex);
+    return 0;
+}
+
+int logger_add_socket_sink(Logger *logger, const char *socket_path, LogType_t min_level) {
+    struct sockaddr_un addr = {0};
+    if (strlen(socket_path) >= sizeof(addr.sun_path)) {
+        fprintf(stderr, "Socket path too long: %s\n", socket_path);
+        return -1;
+    }
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, socket_path);
+
+    pthread_mutex_lock(&logger->sink_mutex);
+    LogSink* sink = logger_new_sink(logger, SINK_SOCKET, min_level);
+    if (sink == NULL) {
+        pthread_mutex_unlock(&logger->sink_mutex);
+        return -1;
+    }
+    sink->sock = socket(AF_UNIX, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+    if (sink->sock < 0) {
+        perror("socket");
+        pthread_mutex_unlock(&logger->sink_mutex);
+        return -1;
+    }
+    if (connect(sink->sock, (struct sockaddr*)&addr, sizeof(addr)) < 0) {
+        perror(socket_path);
+        close(sink->sock);
+        pthread_mutex_unlock(&logger->sink_mutex);
+        return -1;
+    }
+    sink->path = strdup(socket_path);
+    logger_commit_sink(logger);
+    pthread_mutex_unlock(&logger->sink_mutex);
+    return 0;
+}
+
+int logger_add_memory_sink(Logger *logger, size_t capacity, LogType_t min_level) {
+    if (capacity == 0)
+        return -1;
+
+    pthread_mutex_lock(&logger->sink_mutex);
+    LogSink* sink = logger_new_sink(logger, SINK_MEMORY, min_level);
+    if (sink == NULL) {
+        pthread_mutex_unlock(&logger->sink_mutex);
+        return -1;
+    }
+    sink->ring = (char*)malloc(capacity);
+    if (sink->ring == NULL) {
+        perror("logger ring");
+        pthread_mutex_unlock(&logger->sink_mutex);
+        return -1;
+    }
+    sink->ring_cap = capacity;
+    logger_commit_sink(logger);
+    pthread_mutex_unlock(&logger->sink_mutex);
+    return 0;
+}
+
 void logger_log(Logger* logger,
                 const LogType_t log_type,
                 const int line,
@@ -55,36 +381,116 @@ void logger_log(Logger* logger,
         return;
     }
 
-    if (logger->fp == NULL) {
-        perror(logger->file_path);
+    // Сообщения ниже уровня всех приемников отбрасываются без блокировок
+    if ((int)log_type < atomic_load_explicit(&logger->min_level, memory_order_relaxed))
         return;
+
+    LogRecord* rec;
+    LogRecord local;
+
+    if (logger->mode == LOGGER_ASYNC) {
+        pthread_mutex_lock(&logger->mutex);
+        while (logger->count == LOG_QUEUE_LEN)
+            pthread_cond_wait(&logger->not_full, &logger->mutex);
+        rec = &logger->queue[(logger->head + logger->count) % LOG_QUEUE_LEN];
+    } else {
+        rec = &local;
     }
 
-    const char* prefix;
+    rec->type = log_type;
+    rec->line = line;
+    rec->func = func;
+    rec->file = file;
+    rec->trace_size = log_type == ERROR ? backtrace(rec->trace, LOG_TRACE_DEPTH) : 0;
+    strncpy(rec->message, message, LOG_MSG_LEN - 1);
+    rec->message[LOG_MSG_LEN - 1] = '\0';
 
-    switch(log_type) {
-        case DEBUG  : prefix = "[DEBUG]"; break;
-        case INFO   : prefix = "[INFO ]"; break;
-        case WARNING: prefix = "[WARN ]"; break;
-        case ERROR  : prefix = "[ERROR]"; break;
-        default     : prefix = "[LOG  ]"; break;
+    if (logger->mode == LOGGER_ASYNC) {
+        logger->count++;
+        pthread_cond_signal(&logger->not_empty);
+        pthread_mutex_unlock(&logger->mutex);
+    } else {
+        pthread_mutex_lock(&logger->sink_mutex);
+        logger_dispatch(logger, rec);
+        pthread_mutex_unlock(&logger->sink_mutex);
     }
+}
 
-    pthread_mutex_lock(&logger->mutex);
+void logger_flush(Logger* logger) {
+    if (logger->mode == LOGGER_ASYNC) {
+        pthread_mutex_lock(&logger->mutex);
+        while (logger->count != 0)
+            pthread_cond_wait(&logger->drained, &logger->mutex);
+        pthread_mutex_unlock(&logger->mutex);
+    }
 
-    fprintf(logger->fp, "%s\t%s:%d\tfunction \'%s\'\t\t%s\n", prefix, file, line, func, message);
+    pthread_mutex_lock(&logger->sink_mutex);
+    logger_flush_sinks(logger);
+    pthread_mutex_unlock(&logger->sink_mutex);
+}
 
-    if (log_type == ERROR)
-        logger_log_trace(logger);
+void logger_dump_memory(Logger* logger, int fd) {
+    if (logger == NULL)
+        return;
 
-    pthread_mutex_unlock(&logger->mutex);
+    for (size_t i = 0; i < logger->sink_count; i++) {
+        LogSink* sink = &logger->sinks[i];
+        if (sink->type != SINK_MEMORY)
+            continue;
+        if (sink->ring_full) {
+            if (write(fd, sink->ring + sink->ring_head, sink->ring_cap - sink->ring_head) < 0)
+                return;
+        }
+        if (write(fd, sink->ring, sink->ring_head) < 0)
+            return;
+    }
+}
+
+static void logger_crash_handler(int signum) {
+    static const char header[] = "\n---- logger memory dump ----\n";
+    if (write(STDERR_FILENO, header, sizeof(header) - 1) >= 0)
+        logger_dump_memory(crash_logger, STDERR_FILENO);
+    raise(signum);
+}
+
+void logger_install_crash_handler(Logger* logger) {
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = logger_crash_handler;
+    sa.sa_flags = SA_RESETHAND;
+    sigemptyset(&sa.sa_mask);
+
+    crash_logger = logger;
+
+    const int signals[] = { SIGSEGV, SIGBUS, SIGFPE, SIGILL, SIGABRT };
+    for (size_t i = 0; i < sizeof(signals) / sizeof(signals[0]); i++) {
+        if (sigaction(signals[i], &sa, NULL) < 0)
+            perror("sigaction");
+    }
 }
 
 void logger_free(Logger* logger) {
-    if (logger->fp != NULL) {
-        fclose(logger->fp);
+    if (logger->mode == LOGGER_ASYNC) {
+        pthread_mutex_lock(&logger->mutex);
+        logger->stop = 1;
+        pthread_cond_signal(&logger->not_empty);
+        pthread_mutex_unlock(&logger->mutex);
+        pthread_join(logger->worker, NULL);
+
+        pthread_cond_destroy(&logger->not_empty);
+        pthread_cond_destroy(&logger->not_full);
+        pthread_cond_destroy(&logger->drained);
+        free(logger->queue);
     }
+
+    if (crash_logger == logger)
+        crash_logger = NULL;
+
+    for (size_t i = 0; i < logger->sink_count; i++)
+        sink_close(&logger->sinks[i]);
+
     pthread_mutex_destroy(&logger->mutex);
+    pthread_mutex_destroy(&logger->sink_mutex);
     free(logger);
     logger = NULL;
 }
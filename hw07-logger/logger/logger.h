@@ -1,5 +1,7 @@
 #pragma once
 
+#include <stddef.h>
+
 typedef enum {
     DEBUG = 0,
     INFO,
@@ -7,6 +9,12 @@ typedef enum {
     ERROR
 } LogType_t;
 
+// Режим работы логгера: запись в вызывающем потоке или в фоновом
+typedef enum {
+    LOGGER_SYNC = 0,
+    LOGGER_ASYNC
+} LoggerMode_t;
+
 #define logger_debug(logger, message) \
     logger_log(logger, DEBUG, __LINE__, __FUNCTION__, __FILE__, message)
 
@@ -21,8 +29,24 @@ typedef enum {
 
 typedef struct Logger Logger;
 
+// Асинхронный логгер с единственным файловым приемником уровня DEBUG
 Logger *logger_init(const char* file_path);
 
+// Логгер без приемников, они добавляются функциями logger_add_*_sink
+Logger *logger_create(LoggerMode_t mode);
+
+// Приемники получают только сообщения с уровнем не ниже min_level.
+// Возвращают 0 при успехе и -1 при ошибке
+int logger_add_file_sink(Logger *logger, const char *file_path, LogType_t min_level);
+
+int logger_add_syslog_sink(Logger *logger, const char *ident, LogType_t min_level);
+
+// Unix datagram сокет, одна датаграмма на сообщение
+int logger_add_socket_sink(Logger *logger, const char *socket_path, LogType_t min_level);
+
+// Кольцевой буфер в памяти, выгружается только по logger_dump_memory
+int logger_add_memory_sink(Logger *logger, size_t capacity, LogType_t min_level);
+
 void logger_log(
     Logger *logger,
     const LogType_t log_type,
@@ -32,5 +56,13 @@ void logger_log(
     const char *message
 );
 
-void logger_free(Logger *logger);
+// Ожидание записи всех сообщений из очереди
+void logger_flush(Logger *logger);
 
+// Выгрузка кольцевых буферов в fd (только write(), можно звать из обработчика сигнала)
+void logger_dump_memory(Logger *logger, int fd);
+
+// Выгрузка кольцевых буферов в stderr при SIGSEGV/SIGBUS/SIGFPE/SIGILL/SIGABRT
+void logger_install_crash_handler(Logger *logger);
+
+void logger_free(Logger *logger);
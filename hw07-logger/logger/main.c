@@ -4,11 +4,22 @@
 
 int main() {
     printf("Generating logs...\n");
-    Logger* logger = logger_init("log.txt");
+    Logger* logger = logger_create(LOGGER_ASYNC);
+    logger_add_file_sink(logger, "log.txt", INFO);
+    logger_add_memory_sink(logger, 64 * 1024, DEBUG);
+    logger_add_syslog_sink(logger, "logger_test", ERROR);
+    logger_install_crash_handler(logger);
+
     logger_debug(logger, "Debug message!");
     logger_info(logger, "Info message!");
     logger_warn(logger, "Warning message!");
     logger_error(logger, "Error message!");
+    logger_flush(logger);
+
+    printf("Memory ring:\n");
+    fflush(stdout);
+    logger_dump_memory(logger, 1);
+
     logger_free(logger);
     printf("Done!\n");
     return 0;
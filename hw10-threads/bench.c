@@ -0,0 +1,334 @@
+#define _GNU_SOURCE
+
+#include "topn_container.h"
+#include "log_stats.h"
+#include "stat_parser.h"
+#include "chunk_pool.h"
+#include "chunk_reader.h"
+#include "file_list.h"
+#include "log_gen.h"
+#include "column_store.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <time.h>
+#include <sys/stat.h>
+#include <sys/resource.h>
+
+// Бенчмарк анализатора по этапам для 1..N потоков:
+//   read      - чтение участков в буфер и подсчет строк
+//   parse     - чтение и разбор полей без агрегации
+//   aggregate - чтение, разбор и агрегация в статистику потока
+//   merge     - объединение статистик потоков после этапа aggregate
+// Для каждого запуска выводится JSON-строка с МБ/с, строк/с, пиковым RSS
+// процесса и эффективностью масштабирования относительно одного потока.
+// merge выводится от двух потоков, его эффективность не определена
+
+#define TOP 10
+#define DEFAULT_MAX_THREADS 8
+#define DEFAULT_CHUNK_MB 8
+
+typedef enum {
+    STAGE_READ = 0,
+    STAGE_PARSE,
+    STAGE_AGGREGATE,
+    STAGE_COUNT
+} BenchStage;
+
+static const char* stage_names[] = { "read", "parse", "aggregate", "merge" };
+
+static const char* parser_name = "bytes";
+
+typedef struct {
+    BenchStage stage;
+    size_t worker;
+    ChunkPool* pool;
+    LogStats* stats;
+    pthread_barrier_t* barrier;
+    guint64 bytes;
+    guint64 lines;
+    guint64 parsed;
+    guint64 start;
+} BenchThread;
+
+static guint64 now_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (guint64)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static long peak_rss_kb() {
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss;
+}
+
+static guint64 count_lines(const char* data, size_t size) {
+    guint64 lines = 0;
+    const char* p = data;
+    const char* end = data + size;
+    while (p < end && (p = memchr(p, '\n', end - p)) != NULL) {
+        lines++;
+        p++;
+    }
+    return lines;
+}
+
+static void count_parsed(const LogFields* fields, void* arg) {
+    (void)fields;
+    (*(guint64*)arg)++;
+}
+
+static void* bench_thread(void* arg) {
+    BenchThread* data = (BenchThread*)arg;
+    char* buf = NULL;
+    size_t buf_cap = 0;
+
+    pthread_barrier_wait(data->barrier);
+    data->start = now_ns();
+
+    Chunk chunk;
+    while (chunk_pool_next(data->pool, data->worker, &chunk)) {
+        const size_t size = chunk.end - chunk.start;
+        if (size > buf_cap) {
+            buf_cap = size;
+            buf = (char*)realloc(buf, buf_cap);
+        }
+
+        int fd = open(chunk.path, O_RDONLY);
+        if (fd < 0)
+            continue;
+        size_t done = 0;
+        while (done < size) {
+            ssize_t n = pread(fd, buf + done, size - done, chunk.start + done);
+            if (n <= 0)
+                break;
+            done += n;
+        }
+        close(fd);
+
+        data->bytes += done;
+        data->lines += count_lines(buf, done);
+        if (data->stage == STAGE_PARSE)
+            parse_combined_block(buf, done, count_parsed, &data->parsed);
+        else if (data->stage == STAGE_AGGREGATE)
+            chunk_reader_process_lines(buf, done, data->stats);
+    }
+
+    free(buf);
+    return NULL;
+}
+
+// efficiency < 0 выводится как null
+static void print_result(const char* stage, size_t threads, guint64 ns, guint64 bytes,
+                         guint64 lines, double efficiency) {
+    const double seconds = ns / 1e9;
+    const double rate = seconds > 0 ? bytes / seconds : 0;
+    char eff[32];
+    if (efficiency < 0)
+        strcpy(eff, "null");
+    else
+        snprintf(eff, sizeof(eff), "%.2f", efficiency);
+
+    printf("{\"stage\":\"%s\",\"parser\":\"%s\",\"threads\":%lu,\"seconds\":%.3f,\"mb_per_sec\":%.1f,"
+           "\"lines_per_sec\":%.0f,\"peak_rss_kb\":%ld,\"efficiency\":%s}\n",
+           stage, parser_name, threads, seconds, rate / (1 << 20), seconds > 0 ? lines / seconds : 0,
+           peak_rss_kb(), eff);
+    fflush(stdout);
+}
+
+// Чтение всех файлов, чтобы этапы сравнивались без учета диска
+static void warm_cache(GSList* file_list) {
+    char buf[1 << 16];
+    for (GSList* iter = file_list; iter != NULL; iter = iter->next) {
+        FILE* file = fopen((const char*)iter->data, "r");
+        if (file == NULL)
+            continue;
+        while (fread(buf, 1, sizeof(buf), file) > 0)
+            ;
+        fclose(file);
+    }
+}
+
+// Запуск этапа на threads потоках, base_rate - скорость этапа на одном потоке.
+// Возвращает байт в секунду
+static double run_stage(BenchStage stage, size_t threads, GSList* file_list, size_t chunk_size,
+                        double base_rate) {
+    ChunkPool* pool = chunk_pool_init(threads);
+    chunk_pool_add_files(pool, file_list, chunk_size);
+
+    pthread_t tids[threads];
+    BenchThread data[threads];
+    LogStats* stats[threads];
+    pthread_barrier_t barrier;
+    pthread_barrier_init(&barrier, NULL, threads + 1);
+
+    for (size_t i = 0; i < threads; ++i) {
+        data[i].stage = stage;
+        data[i].worker = i;
+        data[i].pool = pool;
+        data[i].stats = stats[i] = stage == STAGE_AGGREGATE ? stats_init(TOP * 100, 0) : NULL;
+        data[i].barrier = &barrier;
+        data[i].bytes = 0;
+        data[i].lines = 0;
+        data[i].parsed = 0;
+        pthread_create(&tids[i], NULL, bench_thread, &data[i]);
+    }
+
+    // Отсчет от первого потока, прошедшего барьер: главный поток может
+    // получить процессор только после того, как потоки уже начали работу
+    pthread_barrier_wait(&barrier);
+    for (size_t i = 0; i < threads; ++i)
+        pthread_join(tids[i], NULL);
+    const guint64 finish = now_ns();
+    guint64 start = finish;
+    for (size_t i = 0; i < threads; ++i)
+        start = MIN(start, data[i].start);
+    const guint64 elapsed = finish - start;
+    pthread_barrier_destroy(&barrier);
+    chunk_pool_free(pool);
+
+    guint64 bytes = 0, lines = 0;
+    for (size_t i = 0; i < threads; ++i) {
+        bytes += data[i].bytes;
+        lines += data[i].lines;
+    }
+    const double rate = elapsed ? bytes / (elapsed / 1e9) : 0;
+    print_result(stage_names[stage], threads, elapsed, bytes, lines,
+                 base_rate > 0 ? rate / (base_rate * threads) : 1.0);
+
+    if (stage == STAGE_AGGREGATE) {
+        // Скорость объединения - в исходных байтах логов, как и у остальных этапов
+        const guint64 merge_start = now_ns();
+        stats_merge_tree(stats, threads);
+        if (threads > 1)
+            print_result(stage_names[STAGE_COUNT], threads, now_ns() - merge_start, bytes, lines, -1);
+        stats_free(stats[0]);
+    }
+
+    return rate;
+}
+
+static void usage(const char* name) {
+    fprintf(stderr,
+            "Usage: %s [-T] [-g dir [-G]] [-n lines] [-f files] [-u urls] [-z zipf_s] [-c chunk_mb] "
+            "[-p parser] [max_threads] [log_path]\n"
+            "  -T  run container and column file self-tests and exit\n"
+            "  -g  generate synthetic logs into dir and benchmark them\n"
+            "  -G  only generate logs\n"
+            "  -p  bytes (default) or pcre\n", name);
+}
+
+// Выбор способа разбора по имени, возвращает -1 для неизвестного имени
+static int select_parser(const char* name) {
+    static const struct {
+        const char* name;
+        ParserKind kind;
+    } parsers[] = {
+        { "bytes", PARSER_BYTES },
+        { "pcre", PARSER_PCRE }
+    };
+
+    for (size_t i = 0; i < G_N_ELEMENTS(parsers); ++i) {
+        if (strcmp(name, parsers[i].name) != 0)
+            continue;
+        parse_set_kind(parsers[i].kind);
+        parser_name = parsers[i].name;
+        return 0;
+    }
+    return -1;
+}
+
+int main(int argc, char* argv[]) {
+    LogGenOptions gen;
+    log_gen_defaults(&gen);
+    const char* gen_dir = NULL;
+    gboolean gen_only = FALSE;
+    size_t chunk_size = (size_t)DEFAULT_CHUNK_MB << 20;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "Tg:Gn:f:u:z:c:p:")) != -1) {
+        switch (opt) {
+            case 'T':
+                topn_test();
+                column_test();
+                return 0;
+            case 'g':
+                gen_dir = optarg;
+                break;
+            case 'G':
+                gen_only = TRUE;
+                break;
+            case 'n':
+                gen.lines = strtoull(optarg, NULL, 10);
+                break;
+            case 'f':
+                gen.files = strtoull(optarg, NULL, 10);
+                break;
+            case 'u':
+                gen.url_count = strtoull(optarg, NULL, 10);
+                break;
+            case 'z':
+                gen.zipf_s = strtod(optarg, NULL);
+                break;
+            case 'c':
+                chunk_size = strtoull(optarg, NULL, 10) << 20;
+                break;
+            case 'p':
+                if (select_parser(optarg) != 0) {
+                    usage(argv[0]);
+                    return EXIT_FAILURE;
+                }
+                break;
+            default:
+                usage(argv[0]);
+                return EXIT_FAILURE;
+        }
+    }
+    argc -= optind - 1;
+    argv += optind - 1;
+
+    const size_t max_threads = argc >= 2 ? strtoull(argv[1], NULL, 10) : DEFAULT_MAX_THREADS;
+    const char* log_path = argc >= 3 ? argv[2] : gen_dir;
+    if (log_path == NULL || max_threads == 0 || chunk_size == 0) {
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    if (gen_dir) {
+        const guint64 start = now_ns();
+        const gint64 written = log_gen_write(gen_dir, &gen);
+        if (written < 0) {
+            fprintf(stderr, "Log generation failed!\n");
+            return EXIT_FAILURE;
+        }
+        fprintf(stderr, "Generated %lu lines, %" G_GINT64_FORMAT " bytes in %.2f s\n",
+                gen.lines, written, (now_ns() - start) / 1e9);
+        if (gen_only)
+            return 0;
+    }
+
+    GSList* file_list = get_file_list_by_mask(log_path, "*.log.*");
+    if (!file_list) {
+        fprintf(stderr, "Log files not found!\n");
+        return EXIT_FAILURE;
+    }
+
+    warm_cache(file_list);
+
+    for (int stage = STAGE_READ; stage < STAGE_COUNT; ++stage) {
+        double base_rate = 0;
+        for (size_t threads = 1; threads <= max_threads; threads++) {
+            const double rate = run_stage(stage, threads, file_list, chunk_size, base_rate);
+            if (threads == 1)
+                base_rate = rate;
+        }
+    }
+
+    free_file_list(file_list);
+    return 0;
+}
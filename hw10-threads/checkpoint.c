@@ -0,0 +1,298 @@
+#define _GNU_SOURCE
+
+#include "checkpoint.h"
+#include "decompress.h"
+#include "hash.h"
+#include "serialize.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#define CHECKPOINT_MAGIC "HW10CKP2"
+#define CHECKPOINT_CAPACITY 1000
+#define SCAN_BUF_SZ 4096
+// Байт начала файла для его опознания
+#define HEAD_SZ 4096
+
+static Checkpoint* checkpoint_new(size_t sketch_size) {
+    Checkpoint* checkpoint = (Checkpoint*)calloc(1, sizeof(Checkpoint));
+    checkpoint->sketch_size = sketch_size;
+    checkpoint->stats = stats_init(CHECKPOINT_CAPACITY, sketch_size);
+    return checkpoint;
+}
+
+void checkpoint_free(Checkpoint* checkpoint) {
+    for (size_t i = 0; i < checkpoint->count; ++i)
+        g_free(checkpoint->files[i].path);
+    free(checkpoint->files);
+    stats_free(checkpoint->stats);
+    free(checkpoint);
+}
+
+static FileCursor* cursor_find(Checkpoint* checkpoint, const struct stat* st) {
+    for (size_t i = 0; i < checkpoint->count; ++i) {
+        FileCursor* cursor = &checkpoint->files[i];
+        if (cursor->device == (guint64)st->st_dev && cursor->inode == (guint64)st->st_ino)
+            return cursor;
+    }
+    return NULL;
+}
+
+// Файл начинается так же, как запомненный. Начало короче запомненного
+// значит, что файл усечен или заменен
+static gboolean head_matches(const FileCursor* cursor, const char* head, size_t head_len) {
+    if (cursor->head_len == 0)
+        return TRUE;
+    return head_len >= cursor->head_len && fnv1a64(head, cursor->head_len) == cursor->head_hash;
+}
+
+static FileCursor* cursor_add(Checkpoint* checkpoint, const gchar* path, guint64 device,
+                              guint64 inode, guint64 offset, guint64 head_len, guint64 hash) {
+    if (checkpoint->count == checkpoint->capacity) {
+        checkpoint->capacity = checkpoint->capacity ? checkpoint->capacity * 2 : 16;
+        checkpoint->files = (FileCursor*)realloc(checkpoint->files, sizeof(FileCursor) * checkpoint->capacity);
+    }
+    FileCursor* cursor = &checkpoint->files[checkpoint->count++];
+    cursor->path = g_strdup(path);
+    cursor->device = device;
+    cursor->inode = inode;
+    cursor->offset = offset;
+    cursor->head_len = head_len;
+    cursor->head_hash = hash;
+    cursor->seen = FALSE;
+    return cursor;
+}
+
+// Позиция файла для прохода по его inode и первым head_len байтам:
+// найденная или новая с нуля
+static FileCursor* cursor_for(Checkpoint* checkpoint, const gchar* path, const struct stat* st,
+                              const char* head, size_t head_len) {
+    FileCursor* cursor = cursor_find(checkpoint, st);
+    if (cursor == NULL) {
+        cursor = cursor_add(checkpoint, path, st->st_dev, st->st_ino, 0, 0, 0);
+    } else if (cursor->offset > (guint64)st->st_size || !head_matches(cursor, head, head_len)) {
+        // Файл усечен на месте (copytruncate) или inode удаленного файла занят новым,
+        // который уже может быть длиннее прежней позиции
+        cursor->offset = 0;
+    }
+
+    if (g_strcmp0(cursor->path, path) != 0) {
+        g_free(cursor->path);
+        cursor->path = g_strdup(path);
+    }
+    // Начало дописываемого файла запоминается, пока не наберется HEAD_SZ байт
+    if (cursor->offset == 0 || head_len > cursor->head_len) {
+        cursor->head_len = head_len;
+        cursor->head_hash = fnv1a64(head, head_len);
+    }
+    cursor->seen = TRUE;
+    return cursor;
+}
+
+// Другой уже разбиравшийся файл с тем же началом, в том числе не встреченный
+// в этом проходе: исходный файл сжатой копии обычно уже удален
+static const FileCursor* cursor_source(const Checkpoint* checkpoint, const FileCursor* copy,
+                                       const char* head, size_t head_len) {
+    for (size_t i = 0; i < checkpoint->count; ++i) {
+        const FileCursor* cursor = &checkpoint->files[i];
+        if (cursor != copy && cursor->offset > 0 && cursor->head_len > 0 &&
+            head_matches(cursor, head, head_len))
+            return cursor;
+    }
+    return NULL;
+}
+
+Checkpoint* checkpoint_load(const gchar* path, size_t sketch_size) {
+    FILE* file = fopen(path, "rb");
+    if (file == NULL)
+        return checkpoint_new(sketch_size);
+
+    Checkpoint* checkpoint = checkpoint_new(sketch_size);
+    char magic[sizeof(CHECKPOINT_MAGIC) - 1];
+    guint64 saved_sketch, count;
+    gchar* name = NULL;
+    size_t cap = 0, len;
+
+    if (read_bytes(file, magic, sizeof(magic)) != 0)
+        goto fail;
+    if (memcmp(magic, CHECKPOINT_MAGIC, sizeof(magic)) != 0 ||
+        read_u64(file, &saved_sketch) != 0 || read_u64(file, &count) != 0)
+        goto fail;
+
+    if (saved_sketch != sketch_size) {
+        fprintf(stderr, "Checkpoint %s was written with %" G_GUINT64_FORMAT " counters, not %lu\n",
+                path, saved_sketch, sketch_size);
+        goto mismatch;
+    }
+
+    for (guint64 i = 0; i < count; ++i) {
+        guint64 device, inode, offset, head_len, hash;
+        if (read_str(file, &name, &cap, &len) != 0 || read_u64(file, &device) != 0 ||
+            read_u64(file, &inode) != 0 || read_u64(file, &offset) != 0 ||
+            read_u64(file, &head_len) != 0 || read_u64(file, &hash) != 0 || head_len > HEAD_SZ)
+            goto fail;
+        cursor_add(checkpoint, name, device, inode, offset, head_len, hash);
+    }
+
+    if (stats_load(checkpoint->stats, file) != 0)
+        goto fail;
+
+    g_free(name);
+    fclose(file);
+    return checkpoint;
+
+fail:
+    fprintf(stderr, "Checkpoint %s is corrupted\n", path);
+mismatch:
+    g_free(name);
+    fclose(file);
+    checkpoint_free(checkpoint);
+    return NULL;
+}
+
+int checkpoint_save(Checkpoint* checkpoint, const gchar* path) {
+    gchar* tmp_path = g_strdup_printf("%s.tmp", path);
+    FILE* file = fopen(tmp_path, "wb");
+    if (file == NULL) {
+        perror(tmp_path);
+        g_free(tmp_path);
+        return -1;
+    }
+
+    // Удаленные файлы больше не нужны, остальные ждут следующего планирования
+    size_t kept = 0;
+    for (size_t i = 0; i < checkpoint->count; ++i) {
+        if (checkpoint->files[i].seen) {
+            checkpoint->files[i].seen = FALSE;
+            checkpoint->files[kept++] = checkpoint->files[i];
+        } else {
+            g_free(checkpoint->files[i].path);
+        }
+    }
+    checkpoint->count = kept;
+
+    int result = 0;
+    if (write_bytes(file, CHECKPOINT_MAGIC, sizeof(CHECKPOINT_MAGIC) - 1) != 0 ||
+        write_u64(file, checkpoint->sketch_size) != 0 ||
+        write_u64(file, checkpoint->count) != 0)
+        result = -1;
+
+    for (size_t i = 0; result == 0 && i < checkpoint->count; ++i) {
+        const FileCursor* cursor = &checkpoint->files[i];
+        if (write_str(file, cursor->path, strlen(cursor->path)) != 0 ||
+            write_u64(file, cursor->device) != 0 || write_u64(file, cursor->inode) != 0 ||
+            write_u64(file, cursor->offset) != 0 || write_u64(file, cursor->head_len) != 0 ||
+            write_u64(file, cursor->head_hash) != 0)
+            result = -1;
+    }
+
+    if (result == 0 && stats_save(checkpoint->stats, file) != 0)
+        result = -1;
+    if (fflush(file) != 0 || fsync(fileno(file)) != 0)
+        result = -1;
+    if (fclose(file) != 0)
+        result = -1;
+
+    if (result == 0 && rename(tmp_path, path) != 0)
+        result = -1;
+    if (result != 0) {
+        fprintf(stderr, "Checkpoint %s not saved!\n", path);
+        unlink(tmp_path);
+    }
+
+    g_free(tmp_path);
+    return result;
+}
+
+// Позиция сразу после последнего '\n' в [start, size) или start
+static off_t last_line_end(int fd, off_t start, off_t size) {
+    char buf[SCAN_BUF_SZ];
+    off_t end = size;
+
+    while (end > start) {
+        const off_t begin = end - SCAN_BUF_SZ > start ? end - SCAN_BUF_SZ : start;
+        ssize_t n = pread(fd, buf, end - begin, begin);
+        if (n <= 0)
+            return start;
+        char* nl = memrchr(buf, '\n', n);
+        if (nl != NULL)
+            return begin + (nl - buf) + 1;
+        end = begin;
+    }
+
+    return start;
+}
+
+size_t checkpoint_plan_plain(Checkpoint* checkpoint, ChunkPool* pool, GSList* file_list, size_t chunk_size) {
+    size_t count = 0;
+
+    for (GSList* iter = file_list; iter != NULL; iter = iter->next) {
+        const gchar* path = (const gchar*)iter->data;
+        int fd = open(path, O_RDONLY);
+        if (fd < 0) {
+            fprintf(stderr, "File %s not opened!\n", path);
+            continue;
+        }
+
+        struct stat st;
+        char head[HEAD_SZ];
+        const ssize_t head_len = pread(fd, head, sizeof(head), 0);
+        if (fstat(fd, &st) < 0 || head_len < 0) {
+            perror(path);
+            close(fd);
+            continue;
+        }
+
+        FileCursor* cursor = cursor_for(checkpoint, path, &st, head, head_len);
+        const off_t end = last_line_end(fd, cursor->offset, st.st_size);
+        close(fd);
+
+        if (end > (off_t)cursor->offset) {
+            count += chunk_pool_add_range(pool, path, cursor->offset, end, chunk_size);
+            cursor->offset = end;
+        }
+    }
+
+    return count;
+}
+
+GSList* checkpoint_plan_compressed(Checkpoint* checkpoint, GSList* file_list) {
+    GSList* result = NULL;
+
+    for (GSList* iter = file_list; iter != NULL; iter = iter->next) {
+        const gchar* path = (const gchar*)iter->data;
+        struct stat st;
+        if (stat(path, &st) < 0) {
+            perror(path);
+            continue;
+        }
+
+        // Поврежденный файл опознается как новый, ошибку сообщит распаковка
+        char head[HEAD_SZ];
+        ssize_t head_len = decompress_head(path, head, sizeof(head));
+        if (head_len < 0)
+            head_len = 0;
+
+        FileCursor* cursor = cursor_for(checkpoint, path, &st, head, head_len);
+        if (cursor->offset != 0 || st.st_size == 0)
+            continue;
+        cursor->offset = st.st_size;
+
+        const FileCursor* source = cursor_source(checkpoint, cursor, head, head_len);
+        if (source != NULL) {
+            fprintf(stderr, "File %s skipped: compressed copy of already parsed %s\n", path, source->path);
+            continue;
+        }
+        result = g_slist_prepend(result, (gpointer)path);
+    }
+
+    return result;
+}
+
+void checkpoint_commit(Checkpoint* checkpoint, LogStats* src) {
+    stats_merge(checkpoint->stats, src);
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include "log_stats.h"
+#include "chunk_pool.h"
+
+// Позиция обработки файла. Файл определяется устройством и inode,
+// поэтому переименование при ротации не приводит к повторному разбору.
+// Хеш первых head_len байт (у сжатого файла - распакованных) отличает
+// новый файл на освобожденном inode и находит сжатую копию уже
+// разобранного файла. head_len == 0 - начало еще не известно
+typedef struct {
+    gchar* path;
+    guint64 device;
+    guint64 inode;
+    guint64 offset;
+    guint64 head_len;
+    guint64 head_hash;
+    gboolean seen;
+} FileCursor;
+
+// Состояние инкрементального режима: позиции файлов и накопленная статистика
+typedef struct {
+    FileCursor* files;
+    size_t count;
+    size_t capacity;
+    size_t sketch_size;
+    LogStats* stats;
+} Checkpoint;
+
+// Загрузка контрольной точки из path, пустая контрольная точка, если файла нет.
+// Возвращает NULL, если файл поврежден или записан с другим sketch_size
+Checkpoint* checkpoint_load(const gchar* path, size_t sketch_size);
+
+// Атомарная запись через временный файл, позиции файлов, не встреченных
+// при последнем планировании, отбрасываются. Возвращает 0 при успехе
+int checkpoint_save(Checkpoint* checkpoint, const gchar* path);
+
+void checkpoint_free(Checkpoint* checkpoint);
+
+// Добавление в pool только дописанных с прошлого раза целых строк текстовых
+// файлов, незавершенная последняя строка остается на следующий раз.
+// Усеченный файл, файл с новым inode или с другим началом разбирается с начала.
+// Возвращает количество участков
+size_t checkpoint_plan_plain(Checkpoint* checkpoint, ChunkPool* pool, GSList* file_list, size_t chunk_size);
+
+// Сжатые файлы, которые еще не разбирались целиком. Сжатые файлы не дописываются,
+// поэтому каждый inode разбирается один раз. Сжатая при ротации копия файла,
+// который уже разбирался (logrotate: access.log.1 -> access.log.2.gz), находится
+// по началу и пропускается: ее строки учтены, кроме дописанных в исходный файл
+// после последнего прохода. Список освобождается g_slist_free
+GSList* checkpoint_plan_compressed(Checkpoint* checkpoint, GSList* file_list);
+
+// Добавление статистики прохода, src не изменяется
+void checkpoint_commit(Checkpoint* checkpoint, LogStats* src);
@@ -0,0 +1,170 @@
+#include "chunk_pool.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/stat.h>
+
+#define ALIGN_BUF_SZ 4096
+
+// Двусторонняя очередь: владелец берет с конца, остальные крадут с начала
+typedef struct {
+    Chunk* items;
+    size_t head;
+    size_t tail;
+    size_t capacity;
+    pthread_spinlock_t lock;
+} ChunkDeque;
+
+struct ChunkPool {
+    ChunkDeque* deques;
+    size_t worker_count;
+    size_t next_worker;
+};
+
+ChunkPool* chunk_pool_init(size_t worker_count) {
+    ChunkPool* pool = (ChunkPool*)malloc(sizeof(ChunkPool));
+    pool->deques = (ChunkDeque*)calloc(worker_count, sizeof(ChunkDeque));
+    pool->worker_count = worker_count;
+    pool->next_worker = 0;
+    for (size_t i = 0; i < worker_count; ++i) {
+        pthread_spin_init(&pool->deques[i].lock, PTHREAD_PROCESS_PRIVATE);
+    }
+    return pool;
+}
+
+void chunk_pool_free(ChunkPool* pool) {
+    for (size_t i = 0; i < pool->worker_count; ++i) {
+        pthread_spin_destroy(&pool->deques[i].lock);
+        free(pool->deques[i].items);
+    }
+    free(pool->deques);
+    free(pool);
+}
+
+static void deque_push(ChunkDeque* deque, const Chunk* chunk) {
+    pthread_spin_lock(&deque->lock);
+    if (deque->tail == deque->capacity) {
+        deque->capacity = deque->capacity ? deque->capacity * 2 : 16;
+        deque->items = (Chunk*)realloc(deque->items, sizeof(Chunk) * deque->capacity);
+    }
+    deque->items[deque->tail++] = *chunk;
+    pthread_spin_unlock(&deque->lock);
+}
+
+static gboolean deque_pop_tail(ChunkDeque* deque, Chunk* chunk) {
+    gboolean found = FALSE;
+    pthread_spin_lock(&deque->lock);
+    if (deque->head < deque->tail) {
+        *chunk = deque->items[--deque->tail];
+        found = TRUE;
+    }
+    pthread_spin_unlock(&deque->lock);
+    return found;
+}
+
+static gboolean deque_steal_head(ChunkDeque* deque, Chunk* chunk) {
+    gboolean found = FALSE;
+    pthread_spin_lock(&deque->lock);
+    if (deque->head < deque->tail) {
+        *chunk = deque->items[deque->head++];
+        found = TRUE;
+    }
+    pthread_spin_unlock(&deque->lock);
+    return found;
+}
+
+// Позиция сразу после первого '\n' в [pos - 1, size) или size
+static off_t align_to_line(int fd, off_t pos, off_t size) {
+    char buf[ALIGN_BUF_SZ];
+    off_t offset = pos - 1;
+
+    while (offset < size) {
+        ssize_t n = pread(fd, buf, sizeof(buf), offset);
+        if (n <= 0)
+            return size;
+        char* nl = memchr(buf, '\n', n);
+        if (nl != NULL)
+            return offset + (nl - buf) + 1;
+        offset += n;
+    }
+
+    return size;
+}
+
+void chunk_pool_push(ChunkPool* pool, const Chunk* chunk) {
+    deque_push(&pool->deques[pool->next_worker], chunk);
+    pool->next_worker = (pool->next_worker + 1) % pool->worker_count;
+}
+
+static size_t add_range_fd(ChunkPool* pool, const gchar* path, int fd,
+                           off_t start, off_t end, size_t chunk_size) {
+    size_t count = 0;
+
+    while (start < end) {
+        off_t chunk_end = end;
+        if ((off_t)chunk_size < end - start)
+            chunk_end = align_to_line(fd, start + chunk_size, end);
+
+        Chunk chunk = { path, start, chunk_end, CHUNK_PLAIN, NULL, 0 };
+        chunk_pool_push(pool, &chunk);
+        count++;
+        start = chunk_end;
+    }
+
+    return count;
+}
+
+size_t chunk_pool_add_range(ChunkPool* pool, const gchar* path, off_t start, off_t end, size_t chunk_size) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        fprintf(stderr, "File %s not opened!\n", path);
+        return 0;
+    }
+
+    const size_t count = add_range_fd(pool, path, fd, start, end, chunk_size);
+    close(fd);
+    return count;
+}
+
+size_t chunk_pool_add_files(ChunkPool* pool, GSList* file_list, size_t chunk_size) {
+    size_t count = 0;
+
+    GSList* iter;
+    for (iter = file_list; iter != NULL; iter = iter->next) {
+        const gchar* path = (const gchar*)iter->data;
+        int fd = open(path, O_RDONLY);
+        if (fd < 0) {
+            fprintf(stderr, "File %s not opened!\n", path);
+            continue;
+        }
+
+        struct stat st;
+        if (fstat(fd, &st) < 0) {
+            perror(path);
+            close(fd);
+            continue;
+        }
+
+        count += add_range_fd(pool, path, fd, 0, st.st_size, chunk_size);
+        close(fd);
+    }
+
+    return count;
+}
+
+gboolean chunk_pool_next(ChunkPool* pool, size_t worker, Chunk* chunk) {
+    if (deque_pop_tail(&pool->deques[worker], chunk))
+        return TRUE;
+
+    for (size_t i = 1; i < pool->worker_count; ++i) {
+        const size_t victim = (worker + i) % pool->worker_count;
+        if (deque_steal_head(&pool->deques[victim], chunk))
+            return TRUE;
+    }
+
+    return FALSE;
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <glib.h>
+#include <sys/types.h>
+
+typedef enum {
+    CHUNK_PLAIN = 0,    // [start, end) - целые строки текстового файла
+    CHUNK_ZSTD_FRAME    // [start, end) - один фрейм zstd, строки могут пересекать границы фреймов
+} ChunkKind;
+
+// Стыки строк между фреймами одного сжатого файла
+typedef struct FrameSeams FrameSeams;
+
+// Участок файла для обработки
+typedef struct {
+    const gchar* path;
+    off_t start;
+    off_t end;
+    ChunkKind kind;
+    FrameSeams* seams;
+    size_t frame;
+} Chunk;
+
+// Набор очередей участков с кражей работы между исполнителями
+typedef struct ChunkPool ChunkPool;
+
+ChunkPool* chunk_pool_init(size_t worker_count);
+
+void chunk_pool_free(ChunkPool* pool);
+
+// Разбиение файлов на участки примерно по chunk_size байт с выравниванием
+// границ по концам строк. Участки раздаются по очередям исполнителей по кругу,
+// пути не копируются. Возвращает количество участков
+size_t chunk_pool_add_files(ChunkPool* pool, GSList* file_list, size_t chunk_size);
+
+// Разбиение диапазона [start, end) файла на участки, как в chunk_pool_add_files.
+// start и end должны быть границами строк. Возвращает количество участков
+size_t chunk_pool_add_range(ChunkPool* pool, const gchar* path, off_t start, off_t end, size_t chunk_size);
+
+// Добавление участка в очередь очередного исполнителя
+void chunk_pool_push(ChunkPool* pool, const Chunk* chunk);
+
+// Следующий участок для исполнителя worker: сначала из своей очереди,
+// затем кража из начала чужих. Возвращает FALSE, когда работы не осталось
+gboolean chunk_pool_next(ChunkPool* pool, size_t worker, Chunk* chunk);
@@ -0,0 +1,101 @@
+#define _GNU_SOURCE
+
+#include "chunk_reader.h"
+#include "stat_parser.h"
+#include "decompress.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+void chunk_reader_init(ChunkReader* reader, ReadMode mode) {
+    reader->mode = mode;
+    reader->line = NULL;
+    reader->line_cap = 0;
+}
+
+void chunk_reader_free(ChunkReader* reader) {
+    free(reader->line);
+    reader->line = NULL;
+    reader->line_cap = 0;
+}
+
+static int process_stdio(ChunkReader* reader, const Chunk* chunk, LogStats* stats) {
+    FILE *fd = fopen(chunk->path, "r");
+    if (fd == NULL) {
+        fprintf(stderr, "File %s not opened!\n", chunk->path);
+        return -1;
+    }
+
+    if (fseeko(fd, chunk->start, SEEK_SET) != 0) {
+        perror(chunk->path);
+        fclose(fd);
+        return -1;
+    }
+
+    off_t left = chunk->end - chunk->start;
+    ssize_t read;
+    while (left > 0 && (read = getline(&reader->line, &reader->line_cap, fd)) != -1) {
+        parse_combined_logline(stats, reader->line, read);
+        left -= read;
+    }
+
+    fclose(fd);
+    return 0;
+}
+
+// Строки передаются разбору срезами памяти без копирования, поиск концов строк -
+// векторизованный memchr из glibc (см. parse_combined_block)
+void chunk_reader_process_lines(const char* data, size_t size, LogStats* stats) {
+    parse_combined_lines(stats, data, size);
+}
+
+static int process_mmap(const Chunk* chunk, LogStats* stats) {
+    if (chunk->end <= chunk->start)
+        return 0;
+
+    int fd = open(chunk->path, O_RDONLY);
+    if (fd < 0) {
+        fprintf(stderr, "File %s not opened!\n", chunk->path);
+        return -1;
+    }
+
+    const off_t page = sysconf(_SC_PAGESIZE);
+    const off_t map_start = chunk->start - chunk->start % page;
+    const size_t map_size = chunk->end - map_start;
+
+    char *map = mmap(NULL, map_size, PROT_READ, MAP_PRIVATE, fd, map_start);
+    close(fd);
+    if (map == MAP_FAILED) {
+        perror(chunk->path);
+        return -1;
+    }
+
+    madvise(map, map_size, MADV_SEQUENTIAL);
+#ifdef MADV_HUGEPAGE
+    // Для файлового отображения работает только при поддержке THP для page cache,
+    // ошибка не критична
+    madvise(map, map_size, MADV_HUGEPAGE);
+#endif
+
+    chunk_reader_process_lines(map + (chunk->start - map_start), chunk->end - chunk->start, stats);
+
+    munmap(map, map_size);
+    return 0;
+}
+
+int chunk_reader_process(ChunkReader* reader, const Chunk* chunk, LogStats* stats) {
+    if (chunk->kind == CHUNK_ZSTD_FRAME)
+        return decompress_zstd_frame(chunk, stats);
+
+    switch (reader->mode) {
+        case READ_MMAP:
+            return process_mmap(chunk, stats);
+        case READ_STDIO:
+        default:
+            return process_stdio(reader, chunk, stats);
+    }
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include "chunk_pool.h"
+#include "log_stats.h"
+
+// Способ чтения участков файлов
+typedef enum {
+    READ_STDIO = 0,    // fopen/getline с копированием строк в буфер
+    READ_MMAP          // отображение в память, строки передаются разбору без копирования
+} ReadMode;
+
+// Состояние чтения одного потока
+typedef struct {
+    ReadMode mode;
+    char* line;
+    size_t line_cap;
+} ChunkReader;
+
+void chunk_reader_init(ChunkReader* reader, ReadMode mode);
+
+void chunk_reader_free(ChunkReader* reader);
+
+// Разбор всех строк участка в stats. Возвращает 0 при успехе и -1 при ошибке
+int chunk_reader_process(ChunkReader* reader, const Chunk* chunk, LogStats* stats);
+
+// Разбор строк из буфера в памяти без копирования
+void chunk_reader_process_lines(const char* data, size_t size, LogStats* stats);
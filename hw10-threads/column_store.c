@@ -0,0 +1,615 @@
+#define _GNU_SOURCE
+
+#include "column_store.h"
+#include "serialize.h"
+#include "stat_parser.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <assert.h>
+#include <unistd.h>
+
+#define COLUMN_MAGIC "HW10COL1"
+#define COLUMN_TOP_CAPACITY 1000
+
+// Сводка блока: диапазоны числовых столбцов по строкам блока,
+// минута - только по строкам с распознанным временем
+typedef struct {
+    guint32 segment;
+    guint32 rows;
+    guint32 no_minute;
+    guint32 min_status;
+    guint32 max_status;
+    gint32 min_minute;
+    gint32 max_minute;
+    guint32 reserved;
+    guint64 min_size;
+    guint64 max_size;
+} BlockHeader;
+
+// Запись оглавления: смещение столбцов блока и его сводка
+typedef struct {
+    guint64 offset;
+    BlockHeader header;
+} BlockEntry;
+
+// Столбцы блока, каждый на COLUMN_BLOCK_ROWS значений
+typedef struct {
+    guint32* ip;
+    guint32* url;
+    guint32* referer;
+    gint32* minute;
+    guint16* status;
+    guint64* size;
+} ColumnBlock;
+
+// Файл: магия, столбцы блоков и словари сегментов в порядке записи,
+// оглавление (блоки со сводками, смещения словарей), смещение оглавления
+struct ColumnFile {
+    FILE* file;
+    pthread_mutex_t lock;
+    BlockEntry* blocks;
+    size_t block_count;
+    size_t block_capacity;
+    guint64* dicts;
+    guint32 segments;
+    gboolean failed;
+};
+
+struct ColumnWriter {
+    ColumnFile* file;
+    BlockHeader header;
+    ColumnBlock block;
+};
+
+static void block_alloc(ColumnBlock* block) {
+    block->ip = (guint32*)malloc(sizeof(guint32) * COLUMN_BLOCK_ROWS);
+    block->url = (guint32*)malloc(sizeof(guint32) * COLUMN_BLOCK_ROWS);
+    block->referer = (guint32*)malloc(sizeof(guint32) * COLUMN_BLOCK_ROWS);
+    block->minute = (gint32*)malloc(sizeof(gint32) * COLUMN_BLOCK_ROWS);
+    block->status = (guint16*)malloc(sizeof(guint16) * COLUMN_BLOCK_ROWS);
+    block->size = (guint64*)malloc(sizeof(guint64) * COLUMN_BLOCK_ROWS);
+}
+
+static void block_release(ColumnBlock* block) {
+    free(block->ip);
+    free(block->url);
+    free(block->referer);
+    free(block->minute);
+    free(block->status);
+    free(block->size);
+}
+
+static int block_write(FILE* file, const ColumnBlock* block, size_t rows) {
+    if (write_bytes(file, block->ip, sizeof(guint32) * rows) != 0 ||
+        write_bytes(file, block->url, sizeof(guint32) * rows) != 0 ||
+        write_bytes(file, block->referer, sizeof(guint32) * rows) != 0 ||
+        write_bytes(file, block->minute, sizeof(gint32) * rows) != 0 ||
+        write_bytes(file, block->status, sizeof(guint16) * rows) != 0 ||
+        write_bytes(file, block->size, sizeof(guint64) * rows) != 0)
+        return -1;
+    return 0;
+}
+
+static int block_read(FILE* file, ColumnBlock* block, size_t rows) {
+    if (read_bytes(file, block->ip, sizeof(guint32) * rows) != 0 ||
+        read_bytes(file, block->url, sizeof(guint32) * rows) != 0 ||
+        read_bytes(file, block->referer, sizeof(guint32) * rows) != 0 ||
+        read_bytes(file, block->minute, sizeof(gint32) * rows) != 0 ||
+        read_bytes(file, block->status, sizeof(guint16) * rows) != 0 ||
+        read_bytes(file, block->size, sizeof(guint64) * rows) != 0)
+        return -1;
+    return 0;
+}
+
+static void header_reset(BlockHeader* header) {
+    header->rows = 0;
+    header->no_minute = 0;
+    header->min_status = G_MAXUINT32;
+    header->max_status = 0;
+    header->min_minute = G_MAXINT32;
+    header->max_minute = G_MININT32;
+    header->reserved = 0;
+    header->min_size = G_MAXUINT64;
+    header->max_size = 0;
+}
+
+ColumnFile* column_file_create(const gchar* path) {
+    FILE* file = fopen(path, "wb");
+    if (file == NULL) {
+        perror(path);
+        return NULL;
+    }
+    if (write_bytes(file, COLUMN_MAGIC, sizeof(COLUMN_MAGIC) - 1) != 0) {
+        perror(path);
+        fclose(file);
+        return NULL;
+    }
+
+    ColumnFile* columns = (ColumnFile*)calloc(1, sizeof(ColumnFile));
+    columns->file = file;
+    pthread_mutex_init(&columns->lock, NULL);
+    return columns;
+}
+
+int column_file_close(ColumnFile* columns) {
+    FILE* file = columns->file;
+    const off_t index = ftello(file);
+    int failed = columns->failed || index < 0 ||
+                 write_u64(file, columns->block_count) != 0 ||
+                 write_bytes(file, columns->blocks, sizeof(BlockEntry) * columns->block_count) != 0 ||
+                 write_u64(file, columns->segments) != 0 ||
+                 write_bytes(file, columns->dicts, sizeof(guint64) * columns->segments) != 0 ||
+                 write_u64(file, index) != 0;
+    if (fclose(file) != 0)
+        failed = 1;
+
+    pthread_mutex_destroy(&columns->lock);
+    free(columns->blocks);
+    free(columns->dicts);
+    free(columns);
+    return failed ? -1 : 0;
+}
+
+ColumnWriter* column_writer_init(ColumnFile* file) {
+    ColumnWriter* writer = (ColumnWriter*)malloc(sizeof(ColumnWriter));
+    writer->file = file;
+    header_reset(&writer->header);
+    block_alloc(&writer->block);
+
+    pthread_mutex_lock(&file->lock);
+    writer->header.segment = file->segments++;
+    file->dicts = (guint64*)realloc(file->dicts, sizeof(guint64) * file->segments);
+    file->dicts[writer->header.segment] = 0;
+    pthread_mutex_unlock(&file->lock);
+    return writer;
+}
+
+void column_writer_free(ColumnWriter* writer) {
+    block_release(&writer->block);
+    free(writer);
+}
+
+// Запись накопленного блока в конец файла
+static void writer_flush(ColumnWriter* writer) {
+    if (writer->header.rows == 0)
+        return;
+
+    ColumnFile* file = writer->file;
+    pthread_mutex_lock(&file->lock);
+    const off_t offset = ftello(file->file);
+    if (offset < 0 || block_write(file->file, &writer->block, writer->header.rows) != 0) {
+        file->failed = TRUE;
+    } else {
+        if (file->block_count == file->block_capacity) {
+            file->block_capacity = file->block_capacity ? file->block_capacity * 2 : 64;
+            file->blocks = (BlockEntry*)realloc(file->blocks, sizeof(BlockEntry) * file->block_capacity);
+        }
+        BlockEntry* entry = &file->blocks[file->block_count++];
+        entry->offset = offset;
+        entry->header = writer->header;
+    }
+    pthread_mutex_unlock(&file->lock);
+
+    header_reset(&writer->header);
+}
+
+void column_writer_add(ColumnWriter* writer, const ColumnRow* row) {
+    BlockHeader* header = &writer->header;
+    ColumnBlock* block = &writer->block;
+    const size_t i = header->rows++;
+
+    block->ip[i] = row->ip;
+    block->url[i] = row->url;
+    block->referer[i] = row->referer;
+    block->minute[i] = row->minute;
+    block->status[i] = row->status;
+    block->size[i] = row->size;
+
+    if (row->minute == COLUMN_NO_MINUTE) {
+        header->no_minute++;
+    } else {
+        header->min_minute = MIN(header->min_minute, row->minute);
+        header->max_minute = MAX(header->max_minute, row->minute);
+    }
+    header->min_status = MIN(header->min_status, row->status);
+    header->max_status = MAX(header->max_status, row->status);
+    header->min_size = MIN(header->min_size, row->size);
+    header->max_size = MAX(header->max_size, row->size);
+
+    if (header->rows == COLUMN_BLOCK_ROWS)
+        writer_flush(writer);
+}
+
+void column_writer_finish(ColumnWriter* writer, StrInterner* strings) {
+    writer_flush(writer);
+
+    ColumnFile* file = writer->file;
+    pthread_mutex_lock(&file->lock);
+    const off_t offset = ftello(file->file);
+    const guint32 count = intern_count(strings);
+    int failed = offset < 0 || write_u64(file->file, count) != 0;
+    for (guint32 id = 0; id < count && !failed; ++id)
+        failed = write_str(file->file, intern_str(strings, id), intern_len(strings, id)) != 0;
+    if (failed)
+        file->failed = TRUE;
+    else
+        file->dicts[writer->header.segment] = offset;
+    pthread_mutex_unlock(&file->lock);
+}
+
+void column_filter_all(ColumnFilter* filter) {
+    filter->minute_from = G_MININT64;
+    filter->minute_to = G_MAXINT64;
+    filter->status_from = 0;
+    filter->status_to = G_MAXINT;
+}
+
+// Оглавление и словари открытого файла
+typedef struct {
+    BlockEntry* blocks;
+    guint64 block_count;
+    guint64 segments;
+    // Перевод идентификаторов сегмента в идентификаторы общей таблицы
+    guint32** remap;
+    guint32* remap_size;
+} ColumnIndex;
+
+static void index_free(ColumnIndex* index) {
+    for (guint64 i = 0; i < index->segments && index->remap; ++i)
+        free(index->remap[i]);
+    free(index->remap);
+    free(index->remap_size);
+    free(index->blocks);
+}
+
+// Чтение оглавления и словарей в strings, возвращает 0 при успехе
+static int index_load(FILE* file, ColumnIndex* index, StrInterner* strings) {
+    memset(index, 0, sizeof(*index));
+
+    char magic[sizeof(COLUMN_MAGIC) - 1];
+    guint64 offset;
+    if (read_bytes(file, magic, sizeof(magic)) != 0 || memcmp(magic, COLUMN_MAGIC, sizeof(magic)) != 0 ||
+        fseeko(file, -(off_t)sizeof(guint64), SEEK_END) != 0)
+        return -1;
+    const off_t file_size = ftello(file) + sizeof(guint64);
+    if (read_u64(file, &offset) != 0 || offset >= (guint64)file_size ||
+        fseeko(file, offset, SEEK_SET) != 0 ||
+        read_u64(file, &index->block_count) != 0 ||
+        index->block_count > (guint64)file_size / sizeof(BlockEntry))
+        return -1;
+
+    index->blocks = (BlockEntry*)malloc(sizeof(BlockEntry) * (index->block_count + 1));
+    if (read_bytes(file, index->blocks, sizeof(BlockEntry) * index->block_count) != 0 ||
+        read_u64(file, &index->segments) != 0 ||
+        index->segments > (guint64)file_size / sizeof(guint64))
+        return -1;
+
+    guint64* dicts = (guint64*)malloc(sizeof(guint64) * (index->segments + 1));
+    index->remap = (guint32**)calloc(index->segments + 1, sizeof(guint32*));
+    index->remap_size = (guint32*)calloc(index->segments + 1, sizeof(guint32));
+    int failed = read_bytes(file, dicts, sizeof(guint64) * index->segments) != 0;
+
+    gchar* buf = NULL;
+    size_t cap = 0, len;
+    for (guint64 s = 0; s < index->segments && !failed; ++s) {
+        guint64 count;
+        if (dicts[s] == 0 || fseeko(file, dicts[s], SEEK_SET) != 0 ||
+            read_u64(file, &count) != 0 || count > G_MAXUINT32) {
+            failed = 1;
+            break;
+        }
+        index->remap[s] = (guint32*)malloc(sizeof(guint32) * (count + 1));
+        index->remap_size[s] = count;
+        for (guint64 id = 0; id < count && !failed; ++id) {
+            failed = read_str(file, &buf, &cap, &len) != 0;
+            if (!failed)
+                index->remap[s][id] = intern_id(strings, buf, len);
+        }
+    }
+    g_free(buf);
+    free(dicts);
+
+    for (guint64 b = 0; b < index->block_count && !failed; ++b) {
+        const BlockHeader* header = &index->blocks[b].header;
+        failed = header->segment >= index->segments || header->rows > COLUMN_BLOCK_ROWS;
+    }
+    return failed ? -1 : 0;
+}
+
+// Суммы по идентификаторам общей таблицы строк
+typedef struct {
+    guint64* url_size;
+    guint64* ref_count;
+    guint64* ip_count;
+    guint8* url_seen;
+} KeyTotals;
+
+// Перевод столбца в общие идентификаторы. Возвращает -1 при идентификаторе вне словаря
+static int remap_column(guint32* column, size_t rows, const guint32* remap, guint32 remap_size) {
+    guint32 bad = 0;
+    for (size_t i = 0; i < rows; ++i) {
+        const guint32 id = column[i];
+        const guint32 valid = id < remap_size;
+        bad |= (valid ^ 1) & (id != INTERN_NO_ID);
+        column[i] = valid ? remap[id] : INTERN_NO_ID;
+    }
+    return bad ? -1 : 0;
+}
+
+// Сжатие столбцов до строк, прошедших filter, возвращает их количество
+static size_t select_rows(ColumnBlock* block, size_t rows, const ColumnFilter* filter, gboolean by_time) {
+    size_t n = 0;
+    for (size_t i = 0; i < rows; ++i) {
+        const gint64 minute = block->minute[i];
+        const int status = block->status[i];
+        const int time_ok = (by_time ^ 1) | ((minute != COLUMN_NO_MINUTE) &
+                                        (minute >= filter->minute_from) & (minute <= filter->minute_to));
+        const int pass = time_ok & (status >= filter->status_from) & (status <= filter->status_to);
+
+        // Запись без ветвления: строка остается, только если n сдвигается
+        block->ip[n] = block->ip[i];
+        block->url[n] = block->url[i];
+        block->referer[n] = block->referer[i];
+        block->minute[n] = block->minute[i];
+        block->status[n] = block->status[i];
+        block->size[n] = block->size[i];
+        n += pass;
+    }
+    return n;
+}
+
+// Учет rows строк блока, по одному проходу на столбец
+static void aggregate_block(LogStats* stats, KeyTotals* totals, const ColumnBlock* block, size_t rows) {
+    guint64 total = 0;
+    for (size_t i = 0; i < rows; ++i)
+        total += block->size[i];
+    stats->total_size += total;
+
+    for (size_t i = 0; i < rows; ++i) {
+        const guint16 status = block->status[i];
+        stats->status[status < STATUS_MAX ? status : 0]++;
+    }
+
+    for (size_t i = 0; i < rows; ++i)
+        size_hist_add(&stats->sizes, block->size[i]);
+
+    for (size_t i = 0; i < rows; ++i) {
+        if (block->minute[i] != COLUMN_NO_MINUTE)
+            series_add(&stats->minutes, block->minute[i], 1, block->size[i]);
+    }
+
+    for (size_t i = 0; i < rows; ++i) {
+        const guint32 url = block->url[i];
+        if (url != INTERN_NO_ID) {
+            totals->url_size[url] += block->size[i];
+            totals->url_seen[url] = 1;
+        }
+    }
+
+    for (size_t i = 0; i < rows; ++i) {
+        if (block->referer[i] != INTERN_NO_ID)
+            totals->ref_count[block->referer[i]]++;
+    }
+
+    for (size_t i = 0; i < rows; ++i) {
+        if (block->ip[i] != INTERN_NO_ID)
+            totals->ip_count[block->ip[i]]++;
+    }
+}
+
+// Перенос ненулевых сумм в контейнер топ-N
+static void add_totals(TopNContainer* cont, StrInterner* strings, const guint64* values,
+                       const guint8* seen, guint32 count) {
+    const gboolean approx = topn_cont_is_approx(cont);
+    for (guint32 id = 0; id < count; ++id) {
+        if (seen ? !seen[id] : values[id] == 0)
+            continue;
+        if (approx)
+            topn_cont_add_len(cont, intern_str(strings, id), intern_len(strings, id), values[id]);
+        else
+            topn_cont_add_id(cont, id, values[id]);
+    }
+}
+
+LogStats* column_query(const gchar* path, const ColumnFilter* filter, size_t sketch_size) {
+    FILE* file = fopen(path, "rb");
+    if (file == NULL) {
+        perror(path);
+        return NULL;
+    }
+
+    LogStats* stats = stats_init(COLUMN_TOP_CAPACITY, sketch_size);
+    ColumnIndex index;
+    if (index_load(file, &index, stats->strings) != 0) {
+        fprintf(stderr, "Column file %s is corrupted\n", path);
+        index_free(&index);
+        stats_free(stats);
+        fclose(file);
+        return NULL;
+    }
+
+    const guint32 count = intern_count(stats->strings);
+    KeyTotals totals = {
+        .url_size = (guint64*)calloc(count + 1, sizeof(guint64)),
+        .ref_count = (guint64*)calloc(count + 1, sizeof(guint64)),
+        .ip_count = (guint64*)calloc(count + 1, sizeof(guint64)),
+        .url_seen = (guint8*)calloc(count + 1, sizeof(guint8))
+    };
+    ColumnBlock block;
+    block_alloc(&block);
+
+    const gboolean by_time = filter->minute_from > G_MININT64 || filter->minute_to < G_MAXINT64;
+    int failed = 0;
+    for (guint64 b = 0; b < index.block_count && !failed; ++b) {
+        const BlockEntry* entry = &index.blocks[b];
+        const BlockHeader* header = &entry->header;
+
+        // Блоки вне диапазонов фильтра не читаются
+        if ((gint64)header->max_status < filter->status_from || (gint64)header->min_status > filter->status_to)
+            continue;
+        if (by_time && (header->rows == header->no_minute ||
+                        header->max_minute < filter->minute_from || header->min_minute > filter->minute_to))
+            continue;
+
+        size_t rows = header->rows;
+        const guint32* remap = index.remap[header->segment];
+        const guint32 remap_size = index.remap_size[header->segment];
+        if (fseeko(file, entry->offset, SEEK_SET) != 0 || block_read(file, &block, rows) != 0 ||
+            remap_column(block.ip, rows, remap, remap_size) != 0 ||
+            remap_column(block.url, rows, remap, remap_size) != 0 ||
+            remap_column(block.referer, rows, remap, remap_size) != 0) {
+            failed = 1;
+            break;
+        }
+
+        // Блок целиком внутри диапазонов фильтра учитывается без отбора
+        const gboolean inside = (gint64)header->min_status >= filter->status_from &&
+                                (gint64)header->max_status <= filter->status_to &&
+                                (!by_time || (header->no_minute == 0 &&
+                                              header->min_minute >= filter->minute_from &&
+                                              header->max_minute <= filter->minute_to));
+        if (!inside)
+            rows = select_rows(&block, rows, filter, by_time);
+        aggregate_block(stats, &totals, &block, rows);
+    }
+
+    if (failed) {
+        fprintf(stderr, "Column file %s is corrupted\n", path);
+        stats_free(stats);
+        stats = NULL;
+    } else {
+        add_totals(stats->url_to_sz, stats->strings, totals.url_size, totals.url_seen, count);
+        add_totals(stats->ref_to_ct, stats->strings, totals.ref_count, NULL, count);
+        add_totals(stats->ip_to_ct, stats->strings, totals.ip_count, NULL, count);
+    }
+
+    block_release(&block);
+    free(totals.url_size);
+    free(totals.ref_count);
+    free(totals.ip_count);
+    free(totals.url_seen);
+    index_free(&index);
+    fclose(file);
+    return stats;
+}
+
+// Все ключи контейнеров совпадают вместе со значениями, порядок равных значений не важен
+static void assert_same_keys(TopNContainer* expected, TopNContainer* actual) {
+    const size_t count = topn_cont_size(expected);
+    assert(topn_cont_size(actual) == count);
+    TopNItem* x = (TopNItem*)malloc(sizeof(TopNItem) * count);
+    TopNItem* y = (TopNItem*)malloc(sizeof(TopNItem) * count);
+    G_GNUC_UNUSED const size_t expected_count = topn_cont_top(expected, count, x);
+    G_GNUC_UNUSED const size_t actual_count = topn_cont_top(actual, count, y);
+    assert(expected_count == count && actual_count == count);
+    for (size_t i = 0; i < count; ++i) {
+        size_t j = 0;
+        while (j < count && g_strcmp0(x[i].key, y[j].key) != 0)
+            j++;
+        assert(j < count && x[i].value == y[j].value);
+    }
+    free(x);
+    free(y);
+}
+
+static void assert_same_stats(LogStats* expected, LogStats* actual) {
+    assert(expected->total_size == actual->total_size);
+    assert(memcmp(expected->status, actual->status, sizeof(expected->status)) == 0);
+    assert(size_hist_percentile(&expected->sizes, 50) == size_hist_percentile(&actual->sizes, 50));
+    assert(size_hist_percentile(&expected->sizes, 99) == size_hist_percentile(&actual->sizes, 99));
+
+    gint64 expected_minute, actual_minute;
+    SeriesBucket expected_peak, actual_peak;
+    G_GNUC_UNUSED const gboolean expected_found = series_peak(&expected->minutes, &expected_minute, &expected_peak);
+    G_GNUC_UNUSED const gboolean actual_found = series_peak(&actual->minutes, &actual_minute, &actual_peak);
+    assert(expected_found && actual_found);
+    assert(expected_minute == actual_minute);
+    assert(expected_peak.requests == actual_peak.requests && expected_peak.bytes == actual_peak.bytes);
+
+    assert_same_keys(expected->url_to_sz, actual->url_to_sz);
+    assert_same_keys(expected->ref_to_ct, actual->ref_to_ct);
+    assert_same_keys(expected->ip_to_ct, actual->ip_to_ct);
+}
+
+void column_test() {
+    // 10/Oct/2023 13:00 UTC в минутах от начала эпохи
+    const gint64 base_minute = 28282380;
+    const size_t lines = COLUMN_BLOCK_ROWS + 30000;
+    const size_t capacity = lines * 128;
+    char* data = (char*)malloc(capacity);
+    size_t len = 0, split = 0;
+    guint64 not_found_size = 0, not_found_count = 0, range_size = 0;
+
+    for (size_t i = 0; i < lines; ++i) {
+        // Первый "поток" пишет полный блок и неполный, второй - неполный
+        if (i == COLUMN_BLOCK_ROWS + 10000)
+            split = len;
+        const int status = i % 7 == 0 ? 404 : 200;
+        const guint64 size = 100 + i % 13 * 10;
+        const int minute = i % 30;
+        len += snprintf(data + len, capacity - len,
+                        "10.0.0.%lu - - [10/Oct/2023:13:%02d:00 +0000] \"GET /u/%lu HTTP/1.1\" %d %lu "
+                        "\"http://r/%lu\" \"ua\"\n",
+                        i % 17, minute, i % 50, status, size, i % 11);
+        if (status == 404) {
+            not_found_size += size;
+            not_found_count++;
+        }
+        if (minute >= 10 && minute <= 19)
+            range_size += size;
+    }
+
+    char path[] = "/tmp/hw10-columns-XXXXXX";
+    int fd = mkstemp(path);
+    assert(fd >= 0);
+    close(fd);
+
+    ColumnFile* file = column_file_create(path);
+    assert(file != NULL);
+    const char* parts[2] = { data, data + split };
+    const size_t sizes[2] = { split, len - split };
+    LogStats* direct[2];
+    for (size_t i = 0; i < 2; ++i) {
+        direct[i] = stats_init(COLUMN_TOP_CAPACITY, 0);
+        direct[i]->columns = column_writer_init(file);
+        parse_combined_lines(direct[i], parts[i], sizes[i]);
+    }
+    for (size_t i = 0; i < 2; ++i) {
+        column_writer_finish(direct[i]->columns, direct[i]->strings);
+        column_writer_free(direct[i]->columns);
+        direct[i]->columns = NULL;
+    }
+    G_GNUC_UNUSED const int closed = column_file_close(file);
+    assert(closed == 0);
+    stats_merge_tree(direct, 2);
+
+    ColumnFilter filter;
+    column_filter_all(&filter);
+    LogStats* queried = column_query(path, &filter, 0);
+    assert(queried != NULL);
+    assert_same_stats(direct[0], queried);
+    stats_free(queried);
+
+    filter.status_from = filter.status_to = 404;
+    queried = column_query(path, &filter, 0);
+    assert(queried != NULL);
+    assert(queried->total_size == not_found_size && queried->status[404] == not_found_count);
+    assert(queried->status[200] == 0);
+    stats_free(queried);
+
+    column_filter_all(&filter);
+    filter.minute_from = base_minute + 10;
+    filter.minute_to = base_minute + 19;
+    queried = column_query(path, &filter, 0);
+    assert(queried != NULL);
+    assert(queried->total_size == range_size);
+    stats_free(queried);
+
+    printf("column file round trip test passed: %lu lines\n", lines);
+    stats_free(direct[0]);
+    unlink(path);
+    free(data);
+}
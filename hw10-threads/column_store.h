@@ -0,0 +1,66 @@
+#pragma once
+
+#include "log_stats.h"
+
+// Строк в одном блоке столбцов
+#define COLUMN_BLOCK_ROWS 65536
+// Минута строки без распознанного времени
+#define COLUMN_NO_MINUTE G_MININT32
+
+// Поля одной строки лога. Строки хранятся идентификаторами
+// таблицы строк потока, INTERN_NO_ID - поле не распознано
+typedef struct {
+    guint32 ip;
+    guint32 url;
+    guint32 referer;
+    gint32 minute;
+    guint16 status;
+    guint64 size;
+} ColumnRow;
+
+// Столбцовый файл разобранных строк. Потоки пишут блоки из
+// COLUMN_BLOCK_ROWS строк со своими словарями (сегментами), для каждого
+// блока хранятся минимум и максимум минуты, кода ответа и размера
+typedef struct ColumnFile ColumnFile;
+
+// Буфер блока одного потока, не потокобезопасен
+typedef struct ColumnWriter ColumnWriter;
+
+// Условие отбора строк запроса, границы включаются
+typedef struct {
+    gint64 minute_from;
+    gint64 minute_to;
+    int status_from;
+    int status_to;
+} ColumnFilter;
+
+// Создание файла path, NULL при ошибке
+ColumnFile* column_file_create(const gchar* path);
+
+// Запись словарей и оглавления, закрытие файла и освобождение.
+// Возвращает 0, если все блоки и словари записаны успешно
+int column_file_close(ColumnFile* file);
+
+// Буфер потока со своим номером сегмента
+ColumnWriter* column_writer_init(ColumnFile* file);
+
+void column_writer_add(ColumnWriter* writer, const ColumnRow* row);
+
+// Запись неполного блока и словаря сегмента из strings - таблицы строк,
+// идентификаторы которой записывались в строки. Вызывается после
+// завершения всех потоков, до объединения их статистики
+void column_writer_finish(ColumnWriter* writer, StrInterner* strings);
+
+void column_writer_free(ColumnWriter* writer);
+
+// Фильтр без ограничений
+void column_filter_all(ColumnFilter* filter);
+
+// Статистика по строкам файла path, прошедшим filter. Блоки вне
+// диапазонов filter пропускаются без чтения.
+// sketch_size - как в stats_init. Возвращает NULL при ошибке
+LogStats* column_query(const gchar* path, const ColumnFilter* filter, size_t sketch_size);
+
+// Проверка, что отчеты по записанному файлу совпадают с отчетами
+// прямого разбора, для hw10-bench -T
+void column_test();
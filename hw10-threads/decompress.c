@@ -0,0 +1,628 @@
+#define _GNU_SOURCE
+
+#include "decompress.h"
+#include "chunk_reader.h"
+#include "stat_parser.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <zlib.h>
+#ifdef HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+#define BLOCK_SZ (1 << 20)
+#define READ_BUF_SZ (256 << 10)
+#define QUEUE_BLOCKS_PER_THREAD 4
+
+typedef struct {
+    char* head;        // до первого '\n' включительно или весь фрейм без '\n'
+    size_t head_len;
+    char* tail;        // после последнего '\n'
+    size_t tail_len;
+    int has_newline;
+} FrameSeam;
+
+struct FrameSeams {
+    FrameSeam* frames;
+    size_t count;
+    atomic_size_t remaining;
+};
+
+struct DecompressPipeline {
+    GSList* stream_files;
+    GSList* next_file;
+    size_t job_count;
+
+    LineBlock* queue;
+    size_t capacity;
+    size_t head;
+    size_t count;
+    size_t producers;
+    pthread_mutex_t mutex;
+    pthread_cond_t not_empty;
+    pthread_cond_t not_full;
+
+    pthread_t* threads;
+    size_t thread_count;
+};
+
+// Буфер распаковки, из которого в очередь уходят только целые строки
+typedef struct {
+    char* buf;
+    size_t size;
+    size_t capacity;
+} BlockBuilder;
+
+Compression compression_detect(const gchar* path) {
+    if (g_str_has_suffix(path, ".gz"))
+        return COMPRESSION_GZIP;
+    if (g_str_has_suffix(path, ".zst") || g_str_has_suffix(path, ".zstd"))
+        return COMPRESSION_ZSTD;
+    return COMPRESSION_NONE;
+}
+
+static void queue_push(DecompressPipeline* pipeline, char* data, size_t size) {
+    pthread_mutex_lock(&pipeline->mutex);
+    while (pipeline->count == pipeline->capacity)
+        pthread_cond_wait(&pipeline->not_full, &pipeline->mutex);
+    LineBlock* block = &pipeline->queue[(pipeline->head + pipeline->count) % pipeline->capacity];
+    block->data = data;
+    block->size = size;
+    pipeline->count++;
+    pthread_cond_signal(&pipeline->not_empty);
+    pthread_mutex_unlock(&pipeline->mutex);
+}
+
+gboolean decompress_next_block(DecompressPipeline* pipeline, LineBlock* block) {
+    if (pipeline == NULL)
+        return FALSE;
+
+    pthread_mutex_lock(&pipeline->mutex);
+    while (pipeline->count == 0 && pipeline->producers > 0)
+        pthread_cond_wait(&pipeline->not_empty, &pipeline->mutex);
+    if (pipeline->count == 0) {
+        pthread_mutex_unlock(&pipeline->mutex);
+        return FALSE;
+    }
+    *block = pipeline->queue[pipeline->head];
+    pipeline->head = (pipeline->head + 1) % pipeline->capacity;
+    pipeline->count--;
+    pthread_cond_signal(&pipeline->not_full);
+    pthread_mutex_unlock(&pipeline->mutex);
+    return TRUE;
+}
+
+void decompress_block_free(LineBlock* block) {
+    free(block->data);
+    block->data = NULL;
+    block->size = 0;
+}
+
+static void builder_init(BlockBuilder* builder) {
+    builder->capacity = BLOCK_SZ;
+    builder->buf = (char*)malloc(builder->capacity);
+    builder->size = 0;
+}
+
+// Отправка целых строк из буфера, остаток переносится в новый буфер.
+// Строка длиннее буфера увеличивает его
+static void builder_emit(DecompressPipeline* pipeline, BlockBuilder* builder, gboolean final) {
+    if (final) {
+        if (builder->size > 0)
+            queue_push(pipeline, builder->buf, builder->size);
+        else
+            free(builder->buf);
+        builder->buf = NULL;
+        builder->size = 0;
+        return;
+    }
+
+    char* nl = memrchr(builder->buf, '\n', builder->size);
+    if (nl == NULL) {
+        builder->capacity *= 2;
+        builder->buf = (char*)realloc(builder->buf, builder->capacity);
+        return;
+    }
+
+    const size_t used = nl - builder->buf + 1;
+    const size_t rest = builder->size - used;
+    char* next = (char*)malloc(builder->capacity);
+    memcpy(next, builder->buf + used, rest);
+
+    queue_push(pipeline, builder->buf, used);
+    builder->buf = next;
+    builder->size = rest;
+}
+
+static void builder_reserve(DecompressPipeline* pipeline, BlockBuilder* builder) {
+    if (builder->size == builder->capacity)
+        builder_emit(pipeline, builder, FALSE);
+}
+
+static int stream_gzip(DecompressPipeline* pipeline, int fd, const gchar* path) {
+    z_stream strm;
+    memset(&strm, 0, sizeof(strm));
+    // 15 + 32: окно 32 КБ и автоопределение заголовка gzip/zlib
+    if (inflateInit2(&strm, 15 + 32) != Z_OK) {
+        fprintf(stderr, "inflateInit failed for %s\n", path);
+        return -1;
+    }
+
+    unsigned char* in = (unsigned char*)malloc(READ_BUF_SZ);
+    BlockBuilder builder;
+    builder_init(&builder);
+
+    int ret = Z_OK;
+    int result = 0;
+    // Пока выходной буфер заполняется целиком, в inflate могут оставаться данные
+    int output_full = 0;
+    for (;;) {
+        if (strm.avail_in == 0 && !output_full) {
+            ssize_t n = read(fd, in, READ_BUF_SZ);
+            if (n < 0) {
+                perror(path);
+                result = -1;
+                break;
+            }
+            if (n == 0)
+                break;
+            strm.next_in = in;
+            strm.avail_in = n;
+        }
+
+        builder_reserve(pipeline, &builder);
+        strm.next_out = (unsigned char*)builder.buf + builder.size;
+        strm.avail_out = builder.capacity - builder.size;
+        ret = inflate(&strm, Z_NO_FLUSH);
+        builder.size = builder.capacity - strm.avail_out;
+        output_full = strm.avail_out == 0;
+
+        if (ret == Z_STREAM_END) {
+            // Следующий член многочленного gzip, например после logrotate + cat
+            inflateReset(&strm);
+        } else if (ret != Z_OK && ret != Z_BUF_ERROR) {
+            fprintf(stderr, "inflate failed for %s: %s\n", path, strm.msg ? strm.msg : "error");
+            result = -1;
+            break;
+        }
+    }
+
+    builder_emit(pipeline, &builder, TRUE);
+    inflateEnd(&strm);
+    free(in);
+    return result;
+}
+
+#ifdef HAVE_ZSTD
+static int stream_zstd(DecompressPipeline* pipeline, int fd, const gchar* path) {
+    ZSTD_DStream* dstream = ZSTD_createDStream();
+    if (dstream == NULL) {
+        fprintf(stderr, "ZSTD_createDStream failed for %s\n", path);
+        return -1;
+    }
+    ZSTD_initDStream(dstream);
+
+    const size_t in_size = ZSTD_DStreamInSize();
+    char* in = (char*)malloc(in_size);
+    ZSTD_inBuffer input = { in, 0, 0 };
+    BlockBuilder builder;
+    builder_init(&builder);
+
+    int result = 0;
+    int output_full = 0;
+    for (;;) {
+        if (input.pos == input.size && !output_full) {
+            ssize_t n = read(fd, in, in_size);
+            if (n < 0) {
+                perror(path);
+                result = -1;
+                break;
+            }
+            if (n == 0)
+                break;
+            input.size = n;
+            input.pos = 0;
+        }
+
+        builder_reserve(pipeline, &builder);
+        ZSTD_outBuffer output = { builder.buf, builder.capacity, builder.size };
+        size_t ret = ZSTD_decompressStream(dstream, &output, &input);
+        builder.size = output.pos;
+        output_full = output.pos == output.size;
+        if (ZSTD_isError(ret)) {
+            fprintf(stderr, "zstd failed for %s: %s\n", path, ZSTD_getErrorName(ret));
+            result = -1;
+            break;
+        }
+    }
+
+    builder_emit(pipeline, &builder, TRUE);
+    ZSTD_freeDStream(dstream);
+    free(in);
+    return result;
+}
+
+// Разбиение многофреймового файла (pzstd, zstd -T с --rsyncable и т.п.) на участки.
+// Возвращает количество фреймов, участки добавляются только если их больше одного
+static size_t zstd_add_frames(ChunkPool* pool, const gchar* path) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return 0;
+
+    struct stat st;
+    if (fstat(fd, &st) < 0 || st.st_size == 0) {
+        close(fd);
+        return 0;
+    }
+
+    const char* map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED)
+        return 0;
+
+    size_t capacity = 0, count = 0;
+    off_t* bounds = NULL;
+
+    off_t pos = 0;
+    while (pos < st.st_size) {
+        size_t frame = ZSTD_findFrameCompressedSize(map + pos, st.st_size - pos);
+        if (ZSTD_isError(frame) || frame == 0)
+            break;
+        if (count + 1 >= capacity) {
+            capacity = capacity ? capacity * 2 : 16;
+            bounds = (off_t*)realloc(bounds, sizeof(off_t) * capacity);
+        }
+        bounds[count++] = pos;
+        pos += frame;
+    }
+    munmap((void*)map, st.st_size);
+
+    if (count > 1) {
+        bounds[count] = pos;
+        FrameSeams* seams = (FrameSeams*)malloc(sizeof(FrameSeams));
+        seams->frames = (FrameSeam*)calloc(count, sizeof(FrameSeam));
+        seams->count = count;
+        atomic_init(&seams->remaining, count);
+
+        for (size_t i = 0; i < count; ++i) {
+            Chunk chunk = { path, bounds[i], bounds[i + 1], CHUNK_ZSTD_FRAME, seams, i };
+            chunk_pool_push(pool, &chunk);
+        }
+    }
+
+    free(bounds);
+    return count;
+}
+#endif
+
+static void* decompress_thread(void* arg) {
+    DecompressPipeline* pipeline = (DecompressPipeline*)arg;
+
+    for (;;) {
+        pthread_mutex_lock(&pipeline->mutex);
+        GSList* item = pipeline->next_file;
+        if (item != NULL)
+            pipeline->next_file = item->next;
+        pthread_mutex_unlock(&pipeline->mutex);
+        if (item == NULL)
+            break;
+
+        const gchar* path = (const gchar*)item->data;
+        int fd = open(path, O_RDONLY);
+        if (fd < 0) {
+            fprintf(stderr, "File %s not opened!\n", path);
+            continue;
+        }
+        posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+
+        switch (compression_detect(path)) {
+            case COMPRESSION_GZIP:
+                stream_gzip(pipeline, fd, path);
+                break;
+#ifdef HAVE_ZSTD
+            case COMPRESSION_ZSTD:
+                stream_zstd(pipeline, fd, path);
+                break;
+#endif
+            default:
+                break;
+        }
+
+        close(fd);
+    }
+
+    pthread_mutex_lock(&pipeline->mutex);
+    pipeline->producers--;
+    pthread_cond_broadcast(&pipeline->not_empty);
+    pthread_mutex_unlock(&pipeline->mutex);
+
+    return NULL;
+}
+
+static ssize_t gzip_head(const gchar* path, char* buf, size_t size) {
+    gzFile file = gzopen(path, "rb");
+    if (file == NULL)
+        return -1;
+    size_t done = 0;
+    while (done < size) {
+        const int n = gzread(file, buf + done, size - done);
+        if (n < 0) {
+            gzclose(file);
+            return -1;
+        }
+        if (n == 0)
+            break;
+        done += n;
+    }
+    gzclose(file);
+    return done;
+}
+
+#ifdef HAVE_ZSTD
+static ssize_t zstd_head(const gchar* path, char* buf, size_t size) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return -1;
+    ZSTD_DStream* dstream = ZSTD_createDStream();
+    if (dstream == NULL) {
+        close(fd);
+        return -1;
+    }
+    ZSTD_initDStream(dstream);
+
+    char in[4096];
+    ZSTD_inBuffer input = { in, 0, 0 };
+    ZSTD_outBuffer output = { buf, size, 0 };
+    ssize_t result = 0;
+    while (output.pos < output.size) {
+        if (input.pos == input.size) {
+            ssize_t n = read(fd, in, sizeof(in));
+            if (n <= 0) {
+                result = n < 0 ? -1 : 0;
+                break;
+            }
+            input.size = n;
+            input.pos = 0;
+        }
+        if (ZSTD_isError(ZSTD_decompressStream(dstream, &output, &input))) {
+            result = -1;
+            break;
+        }
+    }
+
+    ZSTD_freeDStream(dstream);
+    close(fd);
+    return result < 0 ? -1 : (ssize_t)output.pos;
+}
+#endif
+
+ssize_t decompress_head(const gchar* path, char* buf, size_t size) {
+    switch (compression_detect(path)) {
+        case COMPRESSION_GZIP:
+            return gzip_head(path, buf, size);
+#ifdef HAVE_ZSTD
+        case COMPRESSION_ZSTD:
+            return zstd_head(path, buf, size);
+#endif
+        default:
+            return -1;
+    }
+}
+
+DecompressPipeline* decompress_start(GSList* file_list, ChunkPool* pool, size_t max_threads) {
+    if (file_list == NULL)
+        return NULL;
+
+    DecompressPipeline* pipeline = (DecompressPipeline*)calloc(1, sizeof(DecompressPipeline));
+    pthread_mutex_init(&pipeline->mutex, NULL);
+    pthread_cond_init(&pipeline->not_empty, NULL);
+    pthread_cond_init(&pipeline->not_full, NULL);
+
+    GSList* iter;
+    for (iter = file_list; iter != NULL; iter = iter->next) {
+        const gchar* path = (const gchar*)iter->data;
+        if (compression_detect(path) == COMPRESSION_ZSTD) {
+#ifdef HAVE_ZSTD
+            const size_t frames = zstd_add_frames(pool, path);
+            if (frames > 1) {
+                pipeline->job_count += frames;
+                continue;
+            }
+#else
+            (void)pool;
+            fprintf(stderr, "File %s skipped: built without zstd support\n", path);
+            continue;
+#endif
+        }
+        // Блоки одного потокового файла разбираются всеми потоками
+        pipeline->stream_files = g_slist_prepend(pipeline->stream_files, (gpointer)path);
+        pipeline->job_count += max_threads;
+    }
+    pipeline->next_file = pipeline->stream_files;
+
+    pipeline->thread_count = g_slist_length(pipeline->stream_files);
+    if (pipeline->thread_count > max_threads)
+        pipeline->thread_count = max_threads;
+
+    pipeline->capacity = (pipeline->thread_count ? pipeline->thread_count : 1) * QUEUE_BLOCKS_PER_THREAD;
+    pipeline->queue = (LineBlock*)malloc(sizeof(LineBlock) * pipeline->capacity);
+    pipeline->threads = (pthread_t*)malloc(sizeof(pthread_t) * (pipeline->thread_count ? pipeline->thread_count : 1));
+
+    size_t started = 0;
+    pipeline->producers = pipeline->thread_count;
+    for (size_t i = 0; i < pipeline->thread_count; ++i) {
+        if (pthread_create(&pipeline->threads[started], NULL, decompress_thread, pipeline) != 0) {
+            fprintf(stderr, "Error creating decompress thread %lu\n", i);
+            pthread_mutex_lock(&pipeline->mutex);
+            pipeline->producers--;
+            pthread_mutex_unlock(&pipeline->mutex);
+            continue;
+        }
+        started++;
+    }
+    pipeline->thread_count = started;
+
+    return pipeline;
+}
+
+size_t decompress_job_count(DecompressPipeline* pipeline) {
+    return pipeline != NULL ? pipeline->job_count : 0;
+}
+
+void decompress_finish(DecompressPipeline* pipeline) {
+    if (pipeline == NULL)
+        return;
+
+    for (size_t i = 0; i < pipeline->thread_count; ++i) {
+        pthread_join(pipeline->threads[i], NULL);
+    }
+
+    LineBlock block;
+    while (decompress_next_block(pipeline, &block))
+        decompress_block_free(&block);
+
+    pthread_cond_destroy(&pipeline->not_empty);
+    pthread_cond_destroy(&pipeline->not_full);
+    pthread_mutex_destroy(&pipeline->mutex);
+    g_slist_free(pipeline->stream_files);
+    free(pipeline->threads);
+    free(pipeline->queue);
+    free(pipeline);
+}
+
+#ifdef HAVE_ZSTD
+static char* copy_bytes(const char* data, size_t size) {
+    char* copy = (char*)malloc(size ? size : 1);
+    memcpy(copy, data, size);
+    return copy;
+}
+
+// Склейка строк на стыках фреймов, выполняется потоком, завершившим последний фрейм
+static void seams_stitch(FrameSeams* seams, LogStats* stats) {
+    char* carry = NULL;
+    size_t carry_len = 0;
+
+    for (size_t i = 0; i < seams->count; ++i) {
+        FrameSeam* seam = &seams->frames[i];
+
+        carry = (char*)realloc(carry, carry_len + seam->head_len + 1);
+        memcpy(carry + carry_len, seam->head, seam->head_len);
+        carry_len += seam->head_len;
+        free(seam->head);
+
+        if (seam->has_newline) {
+            if (carry_len > 0)
+                parse_combined_logline(stats, carry, carry_len);
+            free(carry);
+            carry = seam->tail;
+            carry_len = seam->tail_len;
+        }
+    }
+
+    if (carry_len > 0)
+        parse_combined_logline(stats, carry, carry_len);
+    free(carry);
+
+    free(seams->frames);
+    free(seams);
+}
+
+static char* zstd_decompress_frame(const char* src, size_t src_size, size_t* out_size) {
+    unsigned long long content = ZSTD_getFrameContentSize(src, src_size);
+    size_t capacity = (content != ZSTD_CONTENTSIZE_UNKNOWN && content != ZSTD_CONTENTSIZE_ERROR)
+                      ? content : src_size * 4;
+    if (capacity == 0)
+        capacity = BLOCK_SZ;
+
+    ZSTD_DStream* dstream = ZSTD_createDStream();
+    if (dstream == NULL)
+        return NULL;
+    ZSTD_initDStream(dstream);
+
+    char* out = (char*)malloc(capacity);
+    ZSTD_inBuffer input = { src, src_size, 0 };
+    ZSTD_outBuffer output = { out, capacity, 0 };
+    for (;;) {
+        size_t ret = ZSTD_decompressStream(dstream, &output, &input);
+        if (ZSTD_isError(ret)) {
+            fprintf(stderr, "zstd frame failed: %s\n", ZSTD_getErrorName(ret));
+            free(out);
+            out = NULL;
+            break;
+        }
+        if (ret == 0)
+            break;
+        if (output.pos == output.size) {
+            output.size *= 2;
+            out = (char*)realloc(out, output.size);
+            output.dst = out;
+        } else if (input.pos == input.size) {
+            fprintf(stderr, "zstd frame truncated\n");
+            free(out);
+            out = NULL;
+            break;
+        }
+    }
+
+    ZSTD_freeDStream(dstream);
+    *out_size = output.pos;
+    return out;
+}
+
+int decompress_zstd_frame(const Chunk* chunk, LogStats* stats) {
+    FrameSeams* seams = chunk->seams;
+    FrameSeam* seam = &seams->frames[chunk->frame];
+    int result = -1;
+
+    const size_t src_size = chunk->end - chunk->start;
+    char* src = (char*)malloc(src_size);
+    int fd = open(chunk->path, O_RDONLY);
+    if (fd >= 0 && pread(fd, src, src_size, chunk->start) == (ssize_t)src_size) {
+        size_t size = 0;
+        char* data = zstd_decompress_frame(src, src_size, &size);
+        if (data != NULL) {
+            char* first = memchr(data, '\n', size);
+            if (first == NULL) {
+                seam->head = data;
+                seam->head_len = size;
+                data = NULL;
+            } else {
+                char* last = memrchr(data, '\n', size);
+                seam->has_newline = 1;
+                seam->head_len = first - data + 1;
+                seam->head = copy_bytes(data, seam->head_len);
+                seam->tail_len = data + size - (last + 1);
+                seam->tail = copy_bytes(last + 1, seam->tail_len);
+                chunk_reader_process_lines(first + 1, last - first, stats);
+            }
+            free(data);
+            result = 0;
+        }
+    } else {
+        fprintf(stderr, "File %s not read!\n", chunk->path);
+    }
+    if (fd >= 0)
+        close(fd);
+    free(src);
+
+    if (atomic_fetch_sub(&seams->remaining, 1) == 1)
+        seams_stitch(seams, stats);
+
+    return result;
+}
+#else
+int decompress_zstd_frame(const Chunk* chunk, LogStats* stats) {
+    (void)chunk;
+    (void)stats;
+    return -1;
+}
+#endif
@@ -0,0 +1,51 @@
+#pragma once
+
+#include "chunk_pool.h"
+#include "log_stats.h"
+
+#include <sys/types.h>
+
+typedef enum {
+    COMPRESSION_NONE = 0,
+    COMPRESSION_GZIP,
+    COMPRESSION_ZSTD
+} Compression;
+
+// Блок распакованных данных из целых строк
+typedef struct {
+    char* data;
+    size_t size;
+} LineBlock;
+
+// Потоки распаковки, передающие блоки строк потокам разбора
+typedef struct DecompressPipeline DecompressPipeline;
+
+// Тип сжатия по расширению файла
+Compression compression_detect(const gchar* path);
+
+// Запуск распаковки сжатых файлов из file_list, не более max_threads потоков.
+// Файлы zstd из нескольких фреймов разбиваются на участки CHUNK_ZSTD_FRAME
+// в pool и распаковываются потоками разбора параллельно, остальные файлы
+// распаковываются потоковым способом. Возвращает NULL, если file_list пуст
+DecompressPipeline* decompress_start(GSList* file_list, ChunkPool* pool, size_t max_threads);
+
+// Оценка количества параллельных задач: участки, добавленные в pool,
+// плюс max_threads на каждый потоковый файл
+size_t decompress_job_count(DecompressPipeline* pipeline);
+
+// Следующий блок строк, ожидает его появления.
+// Возвращает FALSE, когда все файлы распакованы и очередь пуста
+gboolean decompress_next_block(DecompressPipeline* pipeline, LineBlock* block);
+
+void decompress_block_free(LineBlock* block);
+
+// Ожидание завершения потоков распаковки и освобождение ресурсов
+void decompress_finish(DecompressPipeline* pipeline);
+
+// Первые до size байт распакованного файла path в buf.
+// Возвращает их количество и -1 при ошибке или неизвестном сжатии
+ssize_t decompress_head(const gchar* path, char* buf, size_t size);
+
+// Распаковка участка CHUNK_ZSTD_FRAME и разбор его строк в stats.
+// Возвращает 0 при успехе и -1 при ошибке
+int decompress_zstd_frame(const Chunk* chunk, LogStats* stats);
@@ -0,0 +1,15 @@
+#pragma once
+
+#include <glib.h>
+
+// FNV-1a: хеш строк для таблиц интернирования и счетчиков, а также
+// отпечаток начала файла в checkpoint
+static inline guint64 fnv1a64(const void* data, size_t len) {
+    const unsigned char* bytes = (const unsigned char*)data;
+    guint64 hash = 14695981039346656037ull;
+    for (size_t i = 0; i < len; ++i) {
+        hash ^= bytes[i];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
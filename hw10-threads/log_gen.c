@@ -0,0 +1,163 @@
+#include "log_gen.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <time.h>
+
+#define GEN_START_TIME 1696942800 // 2023-10-10 13:00:00 UTC
+#define GEN_LINES_PER_SECOND 50
+
+static const char* methods[] = { "GET", "GET", "GET", "GET", "GET", "GET", "GET", "POST", "HEAD", "PUT" };
+
+static const char* agents[] = {
+    "Mozilla/5.0 (Windows NT 10.0; Win64; x64) AppleWebKit/537.36 (KHTML, like Gecko) Chrome/118.0 Safari/537.36",
+    "Mozilla/5.0 (X11; Linux x86_64; rv:109.0) Gecko/20100101 Firefox/118.0",
+    "Mozilla/5.0 (iPhone; CPU iPhone OS 17_0 like Mac OS X) AppleWebKit/605.1.15 (KHTML, like Gecko) Mobile/15E148",
+    "curl/8.4.0",
+    "Googlebot/2.1 (+http://www.google.com/bot.html)"
+};
+
+static const char* extensions[] = { "", ".html", ".css", ".js", ".png", ".jpg", "/" };
+
+// Распределение кодов ответа в промилле
+static const struct {
+    int code;
+    int weight;
+} statuses[] = {
+    { 200, 820 }, { 304, 80 }, { 301, 20 }, { 404, 60 }, { 403, 5 }, { 500, 10 }, { 503, 5 }
+};
+
+// xorshift64*: детерминированный и быстрый генератор для воспроизводимых данных
+static inline guint64 gen_next(guint64* state) {
+    guint64 x = *state;
+    x ^= x >> 12;
+    x ^= x << 25;
+    x ^= x >> 27;
+    *state = x;
+    return x * 2685821657736338717ull;
+}
+
+static inline double gen_uniform(guint64* state) {
+    return (gen_next(state) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+// Таблица распределения Ципфа: P(k) ~ 1 / k^s, выборка двоичным поиском
+typedef struct {
+    double* cdf;
+    size_t count;
+} ZipfTable;
+
+static void zipf_init(ZipfTable* table, size_t count, double s) {
+    table->count = count ? count : 1;
+    table->cdf = (double*)malloc(sizeof(double) * table->count);
+
+    double sum = 0.0;
+    for (size_t k = 0; k < table->count; ++k) {
+        sum += 1.0 / pow((double)(k + 1), s);
+        table->cdf[k] = sum;
+    }
+    for (size_t k = 0; k < table->count; ++k)
+        table->cdf[k] /= sum;
+}
+
+static size_t zipf_sample(const ZipfTable* table, guint64* state) {
+    const double u = gen_uniform(state);
+    size_t lo = 0, hi = table->count - 1;
+    while (lo < hi) {
+        const size_t mid = (lo + hi) / 2;
+        if (table->cdf[mid] < u)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+void log_gen_defaults(LogGenOptions* opts) {
+    opts->lines = 1000000;
+    opts->files = 4;
+    opts->url_count = 100000;
+    opts->zipf_s = 1.1;
+    opts->referer_count = 1000;
+    opts->ip_count = 50000;
+    opts->seed = 42;
+}
+
+// Размер ответа: логнормальное распределение с медианой около 8 КБ
+static guint64 gen_size(guint64* state) {
+    const double u1 = gen_uniform(state) + 1e-12;
+    const double u2 = gen_uniform(state);
+    const double normal = sqrt(-2.0 * log(u1)) * cos(2.0 * G_PI * u2);
+    return (guint64)exp(9.0 + 1.5 * normal);
+}
+
+static int gen_status(guint64* state) {
+    int roll = gen_next(state) % 1000;
+    for (size_t i = 0; i < G_N_ELEMENTS(statuses); ++i) {
+        if (roll < statuses[i].weight)
+            return statuses[i].code;
+        roll -= statuses[i].weight;
+    }
+    return 200;
+}
+
+gint64 log_gen_write(const gchar* dir, const LogGenOptions* opts) {
+    static const char* months[] = { "Jan", "Feb", "Mar", "Apr", "May", "Jun",
+                                    "Jul", "Aug", "Sep", "Oct", "Nov", "Dec" };
+    ZipfTable urls, referers;
+    zipf_init(&urls, opts->url_count, opts->zipf_s);
+    zipf_init(&referers, opts->referer_count, opts->zipf_s);
+
+    const size_t files = opts->files ? opts->files : 1;
+    const size_t ip_count = opts->ip_count ? opts->ip_count : 1;
+    guint64 state = opts->seed ? opts->seed : 1;
+    gint64 written = 0;
+    size_t line = 0;
+
+    for (size_t f = 0; f < files && written >= 0; ++f) {
+        gchar* path = g_strdup_printf("%s/access.log.%lu", dir, f);
+        FILE* file = fopen(path, "w");
+        if (file == NULL) {
+            perror(path);
+            g_free(path);
+            written = -1;
+            break;
+        }
+
+        const size_t file_lines = opts->lines / files + (f < opts->lines % files);
+        for (size_t i = 0; i < file_lines; ++i, ++line) {
+            const time_t seconds = GEN_START_TIME + line / GEN_LINES_PER_SECOND;
+            struct tm tm;
+            gmtime_r(&seconds, &tm);
+
+            const guint32 ip = gen_next(&state) % ip_count;
+            const size_t url = zipf_sample(&urls, &state);
+            const size_t referer = zipf_sample(&referers, &state);
+            const int status = gen_status(&state);
+            const guint64 size = status == 304 ? 0 : gen_size(&state);
+
+            const int n = fprintf(file,
+                "10.%u.%u.%u - - [%02d/%s/%04d:%02d:%02d:%02d +0000] \"%s /content/%lu%s HTTP/1.1\" "
+                "%d %" G_GUINT64_FORMAT " \"https://site%lu.example.com/page\" \"%s\"\n",
+                (ip >> 16) & 0xff, (ip >> 8) & 0xff, ip & 0xff,
+                tm.tm_mday, months[tm.tm_mon], tm.tm_year + 1900, tm.tm_hour, tm.tm_min, tm.tm_sec,
+                methods[gen_next(&state) % G_N_ELEMENTS(methods)],
+                url, extensions[url % G_N_ELEMENTS(extensions)],
+                status, size, referer, agents[gen_next(&state) % G_N_ELEMENTS(agents)]);
+            if (n < 0) {
+                written = -1;
+                break;
+            }
+            written += n;
+        }
+
+        if (fclose(file) != 0)
+            written = -1;
+        g_free(path);
+    }
+
+    free(urls.cdf);
+    free(referers.cdf);
+    return written;
+}
@@ -0,0 +1,20 @@
+#pragma once
+
+#include <glib.h>
+
+// Параметры синтетических логов в Combined Log Format
+typedef struct {
+    size_t lines;          // строк во всех файлах
+    size_t files;          // файлы access.log.0 .. access.log.<files - 1>
+    size_t url_count;      // различных URL
+    double zipf_s;         // показатель распределения Ципфа для URL и Referer
+    size_t referer_count;  // различных Referer
+    size_t ip_count;       // различных адресов клиентов
+    guint64 seed;
+} LogGenOptions;
+
+void log_gen_defaults(LogGenOptions* opts);
+
+// Запись файлов в каталог dir, каталог должен существовать.
+// Возвращает количество записанных байт или -1 при ошибке
+gint64 log_gen_write(const gchar* dir, const LogGenOptions* opts);
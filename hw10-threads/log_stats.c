@@ -0,0 +1,133 @@
+#include "log_stats.h"
+#include "serialize.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+typedef struct {
+    LogStats* dst;
+    LogStats* src;
+} MergePair;
+
+LogStats* stats_init(size_t capacity, size_t sketch_size) {
+    LogStats* stats = (LogStats*)malloc(sizeof(LogStats));
+    stats->strings = intern_init(capacity);
+    if (sketch_size > 0) {
+        stats->url_to_sz = topn_cont_init_approx(sketch_size);
+        stats->ref_to_ct = topn_cont_init_approx(sketch_size);
+        stats->ip_to_ct = topn_cont_init_approx(sketch_size);
+    } else {
+        stats->url_to_sz = topn_cont_init(stats->strings, capacity);
+        stats->ref_to_ct = topn_cont_init(stats->strings, capacity);
+        stats->ip_to_ct = topn_cont_init(stats->strings, capacity);
+    }
+    stats->total_size = 0;
+    memset(stats->status, 0, sizeof(stats->status));
+    size_hist_init(&stats->sizes);
+    series_init(&stats->minutes);
+    stats->columns = NULL;
+    return stats;
+}
+
+void stats_free(LogStats* stats) {
+    topn_cont_free(stats->url_to_sz);
+    topn_cont_free(stats->ref_to_ct);
+    topn_cont_free(stats->ip_to_ct);
+    series_free(&stats->minutes);
+    intern_free(stats->strings);
+    free(stats);
+}
+
+void stats_merge(LogStats* dst, LogStats* src) {
+    // Строки src переводятся в идентификаторы dst один раз, дальше слияние по числам
+    guint32* remap = intern_merge(dst->strings, src->strings);
+    topn_cont_merge(dst->url_to_sz, src->url_to_sz, remap);
+    topn_cont_merge(dst->ref_to_ct, src->ref_to_ct, remap);
+    topn_cont_merge(dst->ip_to_ct, src->ip_to_ct, remap);
+    g_free(remap);
+    dst->total_size += src->total_size;
+    for (size_t i = 0; i < STATUS_MAX; ++i)
+        dst->status[i] += src->status[i];
+    size_hist_merge(&dst->sizes, &src->sizes);
+    series_merge(&dst->minutes, &src->minutes);
+}
+
+void stats_print_status(LogStats* stats) {
+    guint64 total = 0;
+    for (size_t i = 0; i < STATUS_MAX; ++i)
+        total += stats->status[i];
+
+    for (size_t i = 1; i < STATUS_MAX; ++i) {
+        if (stats->status[i])
+            printf("%lu => %" G_GUINT64_FORMAT " (%.2f%%)\n",
+                   i, stats->status[i], 100.0 * stats->status[i] / total);
+    }
+    if (stats->status[0])
+        printf("other => %" G_GUINT64_FORMAT " (%.2f%%)\n",
+               stats->status[0], 100.0 * stats->status[0] / total);
+}
+
+int stats_save(LogStats* stats, FILE* file) {
+    if (write_u64(file, stats->total_size) != 0 ||
+        write_bytes(file, stats->status, sizeof(stats->status)) != 0 ||
+        topn_cont_save(stats->url_to_sz, file) != 0 ||
+        topn_cont_save(stats->ref_to_ct, file) != 0 ||
+        topn_cont_save(stats->ip_to_ct, file) != 0 ||
+        size_hist_save(&stats->sizes, file) != 0 ||
+        series_save(&stats->minutes, file) != 0)
+        return -1;
+    return 0;
+}
+
+int stats_load(LogStats* stats, FILE* file) {
+    guint64 total_size;
+    guint64 status[STATUS_MAX];
+    if (read_u64(file, &total_size) != 0 ||
+        read_bytes(file, status, sizeof(status)) != 0 ||
+        topn_cont_load(stats->url_to_sz, file) != 0 ||
+        topn_cont_load(stats->ref_to_ct, file) != 0 ||
+        topn_cont_load(stats->ip_to_ct, file) != 0 ||
+        size_hist_load(&stats->sizes, file) != 0 ||
+        series_load(&stats->minutes, file) != 0)
+        return -1;
+
+    stats->total_size += total_size;
+    for (size_t i = 0; i < STATUS_MAX; ++i)
+        stats->status[i] += status[i];
+    return 0;
+}
+
+static void* stats_merge_pair(void* arg) {
+    MergePair* pair = (MergePair*)arg;
+    stats_merge(pair->dst, pair->src);
+    stats_free(pair->src);
+    return NULL;
+}
+
+void stats_merge_tree(LogStats** stats, size_t count) {
+    for (size_t stride = 1; stride < count; stride *= 2) {
+        const size_t pair_count = (count - stride + 2 * stride - 1) / (2 * stride);
+        pthread_t threads[pair_count];
+        MergePair pairs[pair_count];
+        int started[pair_count];
+
+        size_t p = 0;
+        for (size_t i = 0; i + stride < count; i += 2 * stride, ++p) {
+            pairs[p].dst = stats[i];
+            pairs[p].src = stats[i + stride];
+            stats[i + stride] = NULL;
+            started[p] = pthread_create(&threads[p], NULL, stats_merge_pair, &pairs[p]) == 0;
+            if (!started[p]) {
+                fprintf(stderr, "Error creating merge thread, merging inline\n");
+                stats_merge_pair(&pairs[p]);
+            }
+        }
+
+        for (size_t i = 0; i < p; ++i) {
+            if (started[i])
+                pthread_join(threads[i], NULL);
+        }
+    }
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include "topn_container.h"
+#include "size_histogram.h"
+#include "time_series.h"
+
+// Коды ответа 0..STATUS_MAX-1, остальные учитываются в status[0]
+#define STATUS_MAX 600
+
+// Накопленная статистика по логам. Каждый поток заполняет собственный
+// экземпляр без блокировок, объединение выполняется после завершения потоков
+typedef struct {
+    StrInterner* strings;
+    TopNContainer* url_to_sz;
+    TopNContainer* ref_to_ct;
+    TopNContainer* ip_to_ct;
+    guint64 total_size;
+    guint64 status[STATUS_MAX];
+    SizeHistogram sizes;
+    TimeSeries minutes;
+    // Запись разобранных строк в столбцовый файл (см. column_store.h), NULL - без записи.
+    // Принадлежит вызывающему, stats_free и stats_merge его не трогают
+    struct ColumnWriter* columns;
+} LogStats;
+
+// Инициализация статистики, capacity - начальный размер контейнеров.
+// sketch_size > 0 включает приближенные контейнеры на sketch_size ключей
+LogStats* stats_init(size_t capacity, size_t sketch_size);
+
+void stats_free(LogStats* stats);
+
+// Вывод гистограммы кодов ответа
+void stats_print_status(LogStats* stats);
+
+// Добавление src в dst, src не изменяется
+void stats_merge(LogStats* dst, LogStats* src);
+
+// Запись всей статистики в file, возвращает 0 при успехе
+int stats_save(LogStats* stats, FILE* file);
+
+// Добавление статистики, записанной stats_save, в stats.
+// Приближенные контейнеры stats должны быть пусты. Возвращает 0 при успехе
+int stats_load(LogStats* stats, FILE* file);
+
+// Параллельное попарное объединение count экземпляров в stats[0].
+// Остальные экземпляры освобождаются
+void stats_merge_tree(LogStats** stats, size_t count);
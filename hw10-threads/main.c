@@ -3,126 +3,147 @@
 #define SHOULD_SHOW_DEBUG 1
 
 #include "topn_container.h"
+#include "log_stats.h"
 #include "stat_parser.h"
+#include "chunk_pool.h"
+#include "chunk_reader.h"
+#include "decompress.h"
 #include "file_list.h"
+#include "checkpoint.h"
+#include "column_store.h"
 
 #include <stdio.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <poll.h>
+#include <sys/inotify.h>
 
 #define TOP 10
+#define DEFAULT_CHUNK_MB 32
+#define WATCH_DELAY_MS 1000
+
+typedef struct {
+    size_t thread_count;
+    size_t chunk_size;
+    size_t sketch_size;
+    ReadMode read_mode;
+    gboolean full_series;
+    const char *log_path;
+    const char *state_path;
+    gboolean watch;
+    const char *columns_path;
+    const char *query_path;
+    ColumnFilter filter;
+} Options;
 
 typedef struct {
     int thread_id;
-    GSList *file_list;
+    size_t worker;
+    ChunkPool *pool;
+    ReadMode read_mode;
+    DecompressPipeline *pipeline;
+    LogStats *stats;
 } ThreadData;
 
-TopNContainer*  gl_url_to_sz;
-TopNContainer*  gl_ref_to_ct;
-TotalSize*      gl_total_size;
-
 void* get_stat(void* arg) {
     ThreadData *data = (ThreadData*)arg;
 
 #ifdef SHOULD_SHOW_DEBUG
-    printf("Thread %d started. Files:\n", data->thread_id);
-    print_file_list(data->file_list);
+    printf("Thread %d started.\n", data->thread_id);
 #endif
 
-    char *logline = NULL;
-    size_t len = 0;
-    ssize_t read;
+    ChunkReader reader;
+    chunk_reader_init(&reader, data->read_mode);
+    size_t chunks = 0;
 
-    GSList *iter;
-    for (iter = data->file_list; iter != NULL; iter = iter->next) {
-        TopNContainer *url_to_sz = NULL, *ref_to_ct = NULL;
-        FILE *fd = fopen((char*)iter->data, "r");
-        if (fd != NULL) {
-#ifdef SHOULD_SHOW_DEBUG
-            printf("File %s opened!\n", (char*)iter->data);
-#endif
-            url_to_sz = topn_cont_init(TOP * 100);
-            ref_to_ct = topn_cont_init(TOP * 100);
-            while ((read = getline(&logline, &len, fd)) != -1) {
-                parse_combined_logline(url_to_sz, ref_to_ct, gl_total_size, logline);
-            }
-            fclose(fd);
-#ifdef SHOULD_SHOW_DEBUG
-            printf("File %s closed!\n", (char*)iter->data);
-#endif
-
-            topn_cont_merge(gl_url_to_sz, url_to_sz);
-            topn_cont_free(url_to_sz);
+    Chunk chunk;
+    while (chunk_pool_next(data->pool, data->worker, &chunk)) {
+        chunk_reader_process(&reader, &chunk, data->stats);
+        chunks++;
+    }
 
-            topn_cont_merge(gl_ref_to_ct, ref_to_ct);
-            topn_cont_free(ref_to_ct);
-        } else {
-            fprintf(stderr, "File %s not opened!\n", (char*)iter->data);
-        }
+    // Новые участки в пуле не появляются, дальше только блоки распаковки
+    LineBlock block;
+    while (decompress_next_block(data->pipeline, &block)) {
+        chunk_reader_process_lines(block.data, block.size, data->stats);
+        decompress_block_free(&block);
+        chunks++;
     }
 
 #ifdef SHOULD_SHOW_DEBUG
-    printf("Thread %d finished.\n", data->thread_id);
+    printf("Thread %d finished, %lu chunks.\n", data->thread_id, chunks);
 #endif
 
-    free_file_list(data->file_list);
+    chunk_reader_free(&reader);
 
     int *result = malloc(sizeof(int));
     *result = 0;
     return (void*)result;
 }
 
-int main(int argc, char *argv[]) {
-    size_t thread_count = 7;
-    char log_path[256];
-
-    if (argc >= 3) {
-        strcpy(log_path, argv[2]);
-    } else {
-        fprintf(stderr, "Log path not specified!\n");
-        strcpy(log_path, "/home/user/Temp/logs/");
-    }
-
-    GSList *file_list = get_file_list_by_mask(log_path, "*.log.*");
+// Один проход по файлам log_path. С checkpoint разбираются только новые данные.
+// Возвращает NULL, если файлы не найдены
+static LogStats* run_pass(const Options *opts, Checkpoint *checkpoint) {
+    GSList *file_list = get_file_list_by_mask(opts->log_path, "*.log.*");
     if (!file_list) {
         fprintf(stderr, "Log files not found!\n");
-        exit(EXIT_FAILURE);
+        return NULL;
     }
 
-    if (argc >= 2) {
-        thread_count = atoi(argv[1]);
-    } else {
-        fprintf(stderr, "Thread count not specified!\n");
+    GSList *plain_list = NULL, *compressed_list = NULL;
+    for (GSList *iter = file_list; iter != NULL; iter = iter->next) {
+        if (compression_detect((gchar*)iter->data) == COMPRESSION_NONE)
+            plain_list = g_slist_prepend(plain_list, iter->data);
+        else
+            compressed_list = g_slist_prepend(compressed_list, iter->data);
     }
 
-    gl_url_to_sz = topn_cont_init(TOP * 100);
-    gl_ref_to_ct = topn_cont_init(TOP * 100);
-    gl_total_size = ts_init();
-
+    ColumnFile *columns = NULL;
+    if (opts->columns_path) {
+        columns = column_file_create(opts->columns_path);
+        if (!columns) {
+            g_slist_free(plain_list);
+            g_slist_free(compressed_list);
+            free_file_list(file_list);
+            return NULL;
+        }
+    }
 
-    size_t count = g_slist_length(file_list);
+    size_t thread_count = opts->thread_count;
+    ChunkPool *pool = chunk_pool_init(thread_count);
+    size_t count;
+    if (checkpoint) {
+        count = checkpoint_plan_plain(checkpoint, pool, plain_list, opts->chunk_size);
+        GSList *pending = checkpoint_plan_compressed(checkpoint, compressed_list);
+        g_slist_free(compressed_list);
+        compressed_list = pending;
+    } else {
+        count = chunk_pool_add_files(pool, plain_list, opts->chunk_size);
+    }
+    DecompressPipeline *pipeline = decompress_start(compressed_list, pool, thread_count);
+    count += decompress_job_count(pipeline);
+    if (count == 0) {
+        if (!checkpoint)
+            fprintf(stderr, "Log files are empty!\n");
+        count = 1;
+    }
     if (thread_count > count) {
         thread_count = count;
     }
 
     pthread_t threads[thread_count];
     ThreadData thread_data[thread_count];
+    LogStats *thread_stats[thread_count];
 
-    size_t j = 0, file_per_thread = count / thread_count;
     for (size_t i = 0; i < thread_count; ++i) {
-        int thread_file_list_pos = (i * file_per_thread);
-        GSList *thread_file_list = NULL;
-        for (j = 0; j < file_per_thread; ++j) {
-            const int file_index = thread_file_list_pos + j;
-            thread_file_list = g_slist_append(thread_file_list, g_slist_nth_data(file_list, file_index));
-        }
-        if (file_per_thread * thread_count < count && i == thread_count - 1) {
-            for (j = file_per_thread * thread_count; j < count; ++j) {
-                printf("pos: %d j: %lu\n", thread_file_list_pos, j);
-                thread_file_list = g_slist_append(thread_file_list, g_slist_nth_data(file_list, j));
-            }
-        }
-
         thread_data[i].thread_id = i + 1;
-        thread_data[i].file_list = thread_file_list;
+        thread_data[i].worker = i;
+        thread_data[i].pool = pool;
+        thread_data[i].read_mode = opts->read_mode;
+        thread_data[i].pipeline = pipeline;
+        thread_data[i].stats = thread_stats[i] = stats_init(TOP * 100, opts->sketch_size);
+        if (columns)
+            thread_stats[i]->columns = column_writer_init(columns);
 
         int rc = pthread_create(&threads[i], NULL, get_stat, &thread_data[i]);
         if (rc) {
@@ -134,28 +155,274 @@ int main(int argc, char *argv[]) {
     for (unsigned int i = 0; i < thread_count; i++) {
         void *retval;
         pthread_join(threads[i], &retval);
+        free(retval);
     }
+    decompress_finish(pipeline);
+
+    // Словари сегментов пишутся до объединения таблиц строк потоков
+    if (columns) {
+        for (size_t i = 0; i < thread_count; ++i) {
+            column_writer_finish(thread_stats[i]->columns, thread_stats[i]->strings);
+            column_writer_free(thread_stats[i]->columns);
+            thread_stats[i]->columns = NULL;
+        }
+        if (column_file_close(columns) != 0)
+            fprintf(stderr, "Error writing column file %s\n", opts->columns_path);
+    }
+
+    stats_merge_tree(thread_stats, thread_count);
 
+    chunk_pool_free(pool);
+    g_slist_free(compressed_list);
+    g_slist_free(plain_list);
+    free_file_list(file_list);
+
+    return thread_stats[0];
+}
+
+static void print_reports(LogStats *stats, gboolean full_series) {
     printf("\n\n");
     printf("-------------------\n");
     printf("Top 10 URL by size:\n");
     printf("-------------------\n");
-    topn_cont_print(gl_url_to_sz, TOP);
+    topn_cont_print(stats->url_to_sz, TOP);
 
     printf("\n\n");
     printf("-------------------\n");
     printf("Top 10 Referer by count:\n");
     printf("-------------------\n");
-    topn_cont_print(gl_ref_to_ct, TOP);
+    topn_cont_print(stats->ref_to_ct, TOP);
+
+    printf("\n\n");
+    printf("-------------------\n");
+    printf("Top 10 IP by count:\n");
+    printf("-------------------\n");
+    topn_cont_print(stats->ip_to_ct, TOP);
+
+    printf("\n\n");
+    printf("-------------------\n");
+    printf("Status codes:\n");
+    printf("-------------------\n");
+    stats_print_status(stats);
+
+    printf("\n\n");
+    printf("-------------------\n");
+    printf("Response size percentiles:\n");
+    printf("-------------------\n");
+    size_hist_print(&stats->sizes);
+
+    printf("\n\n");
+    printf("-------------------\n");
+    printf("Requests per minute:\n");
+    printf("-------------------\n");
+    series_print(&stats->minutes, full_series);
 
     printf("\n\n");
     printf("-------------------\n");
-    printf("Total: %lu bytes\n", gl_total_size->total);
+    printf("Total: %" G_GUINT64_FORMAT " bytes\n", stats->total_size);
     printf("-------------------\n");
+    fflush(stdout);
+}
+
+// Разбор "from-to" в *from и *to, возвращает 0 при успехе
+static int parse_range(const char *arg, gint64 *from, gint64 *to) {
+    char *end;
+    *from = strtoll(arg, &end, 10);
+    if (end == arg || *end != '-')
+        return -1;
+    arg = end + 1;
+    *to = strtoll(arg, &end, 10);
+    return end == arg || *end != '\0' || *from > *to ? -1 : 0;
+}
+
+// Ожидание изменений в каталоге логов. Изменения за WATCH_DELAY_MS
+// после первого события обрабатываются одним проходом
+static int wait_for_changes(int inotify_fd) {
+    char buf[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+    struct pollfd pfd = { inotify_fd, POLLIN, 0 };
+
+    if (poll(&pfd, 1, -1) < 0) {
+        perror("poll");
+        return -1;
+    }
+    poll(NULL, 0, WATCH_DELAY_MS);
+    while (read(inotify_fd, buf, sizeof(buf)) > 0)
+        ;
+    return 0;
+}
+
+// Инкрементальный режим: состояние между запусками хранится в opts->state_path,
+// при opts->watch проходы повторяются при изменении файлов
+static int run_incremental(const Options *opts) {
+    Checkpoint *checkpoint = checkpoint_load(opts->state_path, opts->sketch_size);
+    if (!checkpoint)
+        return EXIT_FAILURE;
+
+    int inotify_fd = -1;
+    if (opts->watch) {
+        inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        if (inotify_fd < 0 ||
+            inotify_add_watch(inotify_fd, opts->log_path,
+                              IN_MODIFY | IN_CLOSE_WRITE | IN_CREATE | IN_MOVED_TO | IN_DELETE) < 0) {
+            perror(opts->log_path);
+            checkpoint_free(checkpoint);
+            return EXIT_FAILURE;
+        }
+    }
+
+    int result = EXIT_SUCCESS;
+    for (;;) {
+        LogStats *stats = run_pass(opts, checkpoint);
+        if (stats) {
+            checkpoint_commit(checkpoint, stats);
+            stats_free(stats);
+            print_reports(checkpoint->stats, opts->full_series);
+            if (checkpoint_save(checkpoint, opts->state_path) != 0)
+                result = EXIT_FAILURE;
+        } else if (!opts->watch) {
+            result = EXIT_FAILURE;
+        }
+
+        if (!opts->watch || result != EXIT_SUCCESS || wait_for_changes(inotify_fd) != 0)
+            break;
+    }
+
+    if (inotify_fd >= 0)
+        close(inotify_fd);
+    checkpoint_free(checkpoint);
+    return result;
+}
+
+int main(int argc, char *argv[]) {
+    Options opts = {
+        .thread_count = 7,
+        .chunk_size = (size_t)DEFAULT_CHUNK_MB << 20,
+        .sketch_size = 0,
+        .read_mode = READ_STDIO,
+        .full_series = FALSE,
+        .log_path = NULL,
+        .state_path = NULL,
+        .watch = FALSE,
+        .columns_path = NULL,
+        .query_path = NULL
+    };
+    column_filter_all(&opts.filter);
+    gint64 from, to;
+    gboolean filtered = FALSE;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "a:c:ms:two:q:R:S:")) != -1) {
+        switch (opt) {
+            case 'a':
+                opts.sketch_size = strtoull(optarg, NULL, 10);
+                break;
+            case 'c':
+                opts.chunk_size = strtoull(optarg, NULL, 10) << 20;
+                break;
+            case 'm':
+                opts.read_mode = READ_MMAP;
+                break;
+            case 's':
+                opts.state_path = optarg;
+                break;
+            case 't':
+                opts.full_series = TRUE;
+                break;
+            case 'w':
+                opts.watch = TRUE;
+                break;
+            case 'o':
+                opts.columns_path = optarg;
+                break;
+            case 'q':
+                opts.query_path = optarg;
+                break;
+            case 'R':
+                // Unix-время в секундах, в фильтре - минуты
+                if (parse_range(optarg, &from, &to) != 0) {
+                    fprintf(stderr, "Invalid time range: %s\n", optarg);
+                    exit(EXIT_FAILURE);
+                }
+                opts.filter.minute_from = from >= 0 ? from / 60 : -((59 - from) / 60);
+                opts.filter.minute_to = to >= 0 ? to / 60 : -((59 - to) / 60);
+                filtered = TRUE;
+                break;
+            case 'S':
+                if (parse_range(optarg, &from, &to) != 0 || from < 0 || to > G_MAXINT) {
+                    fprintf(stderr, "Invalid status range: %s\n", optarg);
+                    exit(EXIT_FAILURE);
+                }
+                opts.filter.status_from = from;
+                opts.filter.status_to = to;
+                filtered = TRUE;
+                break;
+            default:
+                fprintf(stderr, "Usage: %s [-a counters] [-c chunk_mb] [-m] [-t] [-s state_file [-w]] "
+                                "[-o column_file] [thread_count] [log_path]\n"
+                                "       %s -q column_file [-a counters] [-t] [-R from-to] [-S from-to]\n",
+                        argv[0], argv[0]);
+                exit(EXIT_FAILURE);
+        }
+    }
+    argc -= optind - 1;
+    argv += optind - 1;
+
+    if (opts.chunk_size == 0) {
+        fprintf(stderr, "Chunk size must be positive!\n");
+        exit(EXIT_FAILURE);
+    }
+
+    if (opts.watch && !opts.state_path) {
+        fprintf(stderr, "Watch mode requires a state file!\n");
+        exit(EXIT_FAILURE);
+    }
+
+    if (filtered && !opts.query_path) {
+        fprintf(stderr, "Time and status filters require a column file query!\n");
+        exit(EXIT_FAILURE);
+    }
+
+    if (opts.columns_path && opts.state_path) {
+        fprintf(stderr, "Column file can't be written in incremental mode!\n");
+        exit(EXIT_FAILURE);
+    }
+
+    // Отчеты по ранее записанному столбцовому файлу, логи не читаются
+    if (opts.query_path) {
+        LogStats *stats = column_query(opts.query_path, &opts.filter, opts.sketch_size);
+        if (!stats)
+            exit(EXIT_FAILURE);
+        print_reports(stats, opts.full_series);
+        stats_free(stats);
+        return 0;
+    }
+
+    if (argc >= 3) {
+        opts.log_path = argv[2];
+    } else {
+        fprintf(stderr, "Log path not specified!\n");
+        opts.log_path = "/home/user/Temp/logs/";
+    }
+
+    if (argc >= 2) {
+        opts.thread_count = atoi(argv[1]);
+    } else {
+        fprintf(stderr, "Thread count not specified!\n");
+    }
+
+    if (opts.thread_count == 0) {
+        opts.thread_count = 1;
+    }
+
+    if (opts.state_path)
+        return run_incremental(&opts);
+
+    LogStats *stats = run_pass(&opts, NULL);
+    if (!stats)
+        exit(EXIT_FAILURE);
 
-    ts_free(gl_total_size);
-    topn_cont_free(gl_ref_to_ct);
-    topn_cont_free(gl_url_to_sz);
+    print_reports(stats, opts.full_series);
+    stats_free(stats);
 
     return 0;
 }
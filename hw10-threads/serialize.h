@@ -0,0 +1,54 @@
+#pragma once
+
+#include <glib.h>
+#include <stdio.h>
+
+// Двоичная запись и чтение состояния в порядке байт машины.
+// Функции чтения возвращают 0 при успехе и -1 при ошибке или конце файла
+
+static inline int write_bytes(FILE* file, const void* data, size_t size) {
+    return fwrite(data, 1, size, file) == size ? 0 : -1;
+}
+
+static inline int read_bytes(FILE* file, void* data, size_t size) {
+    return fread(data, 1, size, file) == size ? 0 : -1;
+}
+
+static inline int write_u64(FILE* file, guint64 value) {
+    return write_bytes(file, &value, sizeof(value));
+}
+
+static inline int read_u64(FILE* file, guint64* value) {
+    return read_bytes(file, value, sizeof(*value));
+}
+
+static inline int write_i64(FILE* file, gint64 value) {
+    return write_bytes(file, &value, sizeof(value));
+}
+
+static inline int read_i64(FILE* file, gint64* value) {
+    return read_bytes(file, value, sizeof(*value));
+}
+
+// Строка с длиной впереди
+static inline int write_str(FILE* file, const gchar* str, size_t len) {
+    if (write_u64(file, len) != 0)
+        return -1;
+    return write_bytes(file, str, len);
+}
+
+// Чтение строки в *buf с увеличением буфера при необходимости
+static inline int read_str(FILE* file, gchar** buf, size_t* cap, size_t* len) {
+    guint64 size;
+    if (read_u64(file, &size) != 0 || size > G_MAXUINT32)
+        return -1;
+    if (size + 1 > *cap) {
+        *cap = size + 1;
+        *buf = (gchar*)g_realloc(*buf, *cap);
+    }
+    if (read_bytes(file, *buf, size) != 0)
+        return -1;
+    (*buf)[size] = '\0';
+    *len = size;
+    return 0;
+}
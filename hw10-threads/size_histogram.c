@@ -0,0 +1,123 @@
+#include "size_histogram.h"
+#include "serialize.h"
+
+#include <stdio.h>
+#include <string.h>
+
+void size_hist_init(SizeHistogram* hist) {
+    memset(hist, 0, sizeof(SizeHistogram));
+    hist->min = G_MAXUINT64;
+}
+
+static inline size_t size_hist_index(guint64 value) {
+    if (value < SIZE_HIST_SUB)
+        return value;
+
+    // Старший бит задает интервал, следующие SUB_BITS бит - ячейку в нем
+    const int exponent = 63 - __builtin_clzll(value);
+    const int shift = exponent - SIZE_HIST_SUB_BITS;
+    return SIZE_HIST_SUB * (shift + 1) + ((value >> shift) - SIZE_HIST_SUB);
+}
+
+// Наибольшее значение, попадающее в ячейку index
+static guint64 size_hist_upper(size_t index) {
+    if (index < SIZE_HIST_SUB)
+        return index;
+
+    const int shift = index / SIZE_HIST_SUB - 1;
+    const guint64 mantissa = SIZE_HIST_SUB + index % SIZE_HIST_SUB;
+    return ((mantissa + 1) << shift) - 1;
+}
+
+void size_hist_add(SizeHistogram* hist, guint64 value) {
+    hist->counts[size_hist_index(value)]++;
+    hist->total++;
+    if (value < hist->min)
+        hist->min = value;
+    if (value > hist->max)
+        hist->max = value;
+}
+
+void size_hist_merge(SizeHistogram* dst, const SizeHistogram* src) {
+    if (src->total == 0)
+        return;
+
+    for (size_t i = 0; i < SIZE_HIST_BUCKETS; ++i)
+        dst->counts[i] += src->counts[i];
+    dst->total += src->total;
+    if (src->min < dst->min)
+        dst->min = src->min;
+    if (src->max > dst->max)
+        dst->max = src->max;
+}
+
+guint64 size_hist_percentile(const SizeHistogram* hist, double percentile) {
+    if (hist->total == 0)
+        return 0;
+
+    guint64 rank = (guint64)(percentile / 100.0 * hist->total + 0.5);
+    if (rank == 0)
+        rank = 1;
+
+    guint64 seen = 0;
+    for (size_t i = 0; i < SIZE_HIST_BUCKETS; ++i) {
+        seen += hist->counts[i];
+        if (seen >= rank) {
+            const guint64 upper = size_hist_upper(i);
+            return upper < hist->max ? upper : hist->max;
+        }
+    }
+    return hist->max;
+}
+
+void size_hist_print(const SizeHistogram* hist) {
+    if (hist->total == 0) {
+        printf("No responses\n");
+        return;
+    }
+
+    printf("min   => %" G_GUINT64_FORMAT "\n", hist->min);
+    printf("p50   => %" G_GUINT64_FORMAT "\n", size_hist_percentile(hist, 50.0));
+    printf("p90   => %" G_GUINT64_FORMAT "\n", size_hist_percentile(hist, 90.0));
+    printf("p99   => %" G_GUINT64_FORMAT "\n", size_hist_percentile(hist, 99.0));
+    printf("p99.9 => %" G_GUINT64_FORMAT "\n", size_hist_percentile(hist, 99.9));
+    printf("max   => %" G_GUINT64_FORMAT "\n", hist->max);
+}
+
+int size_hist_save(const SizeHistogram* hist, FILE* file) {
+    guint64 used = 0;
+    for (size_t i = 0; i < SIZE_HIST_BUCKETS; ++i)
+        used += hist->counts[i] != 0;
+
+    if (write_u64(file, hist->min) != 0 || write_u64(file, hist->max) != 0 ||
+        write_u64(file, used) != 0)
+        return -1;
+    for (size_t i = 0; i < SIZE_HIST_BUCKETS; ++i) {
+        if (hist->counts[i] == 0)
+            continue;
+        if (write_u64(file, i) != 0 || write_u64(file, hist->counts[i]) != 0)
+            return -1;
+    }
+    return 0;
+}
+
+int size_hist_load(SizeHistogram* hist, FILE* file) {
+    SizeHistogram loaded;
+    size_hist_init(&loaded);
+
+    guint64 used;
+    if (read_u64(file, &loaded.min) != 0 || read_u64(file, &loaded.max) != 0 ||
+        read_u64(file, &used) != 0)
+        return -1;
+    for (guint64 i = 0; i < used; ++i) {
+        guint64 index, count;
+        if (read_u64(file, &index) != 0 || read_u64(file, &count) != 0 ||
+            index >= SIZE_HIST_BUCKETS)
+            return -1;
+        loaded.counts[index] = count;
+        loaded.total += count;
+    }
+
+    size_hist_merge(hist, &loaded);
+    return 0;
+}
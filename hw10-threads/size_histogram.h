@@ -0,0 +1,36 @@
+#pragma once
+
+#include <glib.h>
+#include <stdio.h>
+
+// Гистограмма размеров в стиле HDR: логарифмические интервалы,
+// каждый разбит на SIZE_HIST_SUB линейных ячеек. Относительная
+// погрешность квантилей не превышает 1 / SIZE_HIST_SUB
+#define SIZE_HIST_SUB_BITS 7
+#define SIZE_HIST_SUB (1 << SIZE_HIST_SUB_BITS)
+#define SIZE_HIST_BUCKETS (SIZE_HIST_SUB * (64 - SIZE_HIST_SUB_BITS + 1))
+
+typedef struct {
+    guint64 counts[SIZE_HIST_BUCKETS];
+    guint64 total;
+    guint64 min;
+    guint64 max;
+} SizeHistogram;
+
+void size_hist_init(SizeHistogram* hist);
+
+void size_hist_add(SizeHistogram* hist, guint64 value);
+
+void size_hist_merge(SizeHistogram* dst, const SizeHistogram* src);
+
+// Значение, не меньше которого percentile процентов значений (0..100)
+guint64 size_hist_percentile(const SizeHistogram* hist, double percentile);
+
+// Вывод min, p50, p90, p99, p99.9 и max
+void size_hist_print(const SizeHistogram* hist);
+
+// Запись непустых ячеек в file, возвращает 0 при успехе
+int size_hist_save(const SizeHistogram* hist, FILE* file);
+
+// Добавление гистограммы, записанной size_hist_save. Возвращает 0 при успехе
+int size_hist_load(SizeHistogram* hist, FILE* file);
@@ -1,134 +1,331 @@
+#define _GNU_SOURCE
+
 #include "stat_parser.h"
+#include "column_store.h"
 
 #include <stdio.h>
+#include <string.h>
+#include <pthread.h>
 
 #define OVECCOUNT 30
 
-#define REQUEST 4
-#define SIZE 6
-#define REFERER 7
-
 const char *combined_fields[] = {
     "ip", "ident", "user", "time", "request", "status", "size", "referer", "agent"
 };
 
-TotalSize *ts_init() {
-    TotalSize* total_size = (TotalSize*)malloc(sizeof(TotalSize));
-    pthread_mutex_init(&total_size->mutex, NULL);
-    total_size->total = 0;
-    return total_size;
+// Запасной шаблон мягче быстрого разбора: допускает несколько пробелов
+// между полями, экранированные кавычки и размер "-"
+static const char *fallback_pattern =
+    "^(?P<ip>\\S+)\\s+(?P<ident>\\S+)\\s+(?P<user>\\S+)\\s+\\[(?P<time>[^\\]]+)\\]\\s+"
+    "\"(?P<request>(?:[^\"\\\\]|\\\\.)*)\"\\s+(?P<status>\\d+)\\s+(?P<size>\\d+|-)\\s+"
+    "\"(?P<referer>(?:[^\"\\\\]|\\\\.)*)\"\\s+\"(?P<agent>(?:[^\"\\\\]|\\\\.)*)\"";
+
+static ParserKind parser_kind = PARSER_BYTES;
+
+static pthread_once_t fallback_once = PTHREAD_ONCE_INIT;
+static pcre *fallback_re = NULL;
+static pcre_extra *fallback_extra = NULL;
+static int fallback_index[CF_COUNT];
+
+static void fallback_compile() {
+    const char *error;
+    int erroffset;
+
+    fallback_re = pcre_compile(fallback_pattern, 0, &error, &erroffset, NULL);
+    if (fallback_re == NULL) {
+        fprintf(stderr, "PCRE compilation failed at offset %d: %s\n", erroffset, error);
+        return;
+    }
+
+    fallback_extra = pcre_study(fallback_re, 0, &error);
+    for (int i = 0; i < CF_COUNT; ++i) {
+        fallback_index[i] = pcre_get_stringnumber(fallback_re, combined_fields[i]);
+    }
 }
 
-void ts_free(TotalSize *total_size) {
-    total_size->total = 0;
-    pthread_mutex_destroy(&total_size->mutex);
-    free(total_size);
+static int parse_fallback(const char *logline, size_t len, LogFields *fields) {
+    int ovector[OVECCOUNT];
+
+    pthread_once(&fallback_once, fallback_compile);
+    if (fallback_re == NULL)
+        return -1;
+
+    int rc = pcre_exec(fallback_re, fallback_extra, logline, len, 0, 0, ovector, OVECCOUNT);
+    if (rc < 0) {
+#ifdef SHOULD_SHOW_DEBUG
+        switch(rc) {
+            case PCRE_ERROR_NOMATCH:
+                printf("No match found: %.*s\n", (int)len, logline);
+                break;
+            default:
+                printf("Matching error %d\n", rc);
+                break;
+        }
+#endif
+        return -1;
+    }
+
+    for (int i = 0; i < CF_COUNT; ++i) {
+        const int index = fallback_index[i];
+        if (index < 0)
+            return -1;
+        fields->field[i].ptr = logline + ovector[2 * index];
+        fields->field[i].len = ovector[2 * index + 1] - ovector[2 * index];
+    }
+
+    return 0;
 }
 
-void ts_add(TotalSize *total_size, size_t size) {
-    pthread_mutex_lock(&total_size->mutex);
-    total_size->total += size;
-    pthread_mutex_unlock(&total_size->mutex);
+static inline int is_space(char c) {
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\f' || c == '\v';
 }
 
-char* alloc_value_from_pcre(const char *logline, pcre *re, int *ovector, int field) {
-    char *value;
-    int index = pcre_get_stringnumber(re, combined_fields[field]);
-    if (index >= 0) {
-        const char *substring_start = logline + ovector[2 * index];
-        const int substring_length = ovector[2 * index + 1] - ovector[2 * index];
+static inline int is_digit(char c) {
+    return c >= '0' && c <= '9';
+}
 
-        value = malloc(substring_length + 1);
-        memcpy(value, substring_start, substring_length);
-        value[substring_length] = '\0';
-    } else {
-        value = NULL;
+// \S+ с последующим пробелом
+static const char* scan_token(const char *p, const char *end, StrView *out) {
+    const char *start = p;
+    while (p < end && !is_space(*p))
+        p++;
+    if (p == start || p == end || *p != ' ')
+        return NULL;
+    out->ptr = start;
+    out->len = p - start;
+    return p + 1;
+}
+
+// \d+ с последующим пробелом
+static const char* scan_number(const char *p, const char *end, StrView *out) {
+    const char *start = p;
+    while (p < end && is_digit(*p))
+        p++;
+    if (p == start || p == end || *p != ' ')
+        return NULL;
+    out->ptr = start;
+    out->len = p - start;
+    return p + 1;
+}
+
+// Содержимое между open и close без вложенных close
+static const char* scan_quoted(const char *p, const char *end, char open, char close, StrView *out) {
+    if (p == end || *p != open)
+        return NULL;
+    p++;
+    const char *stop = memchr(p, close, end - p);
+    if (stop == NULL)
+        return NULL;
+    out->ptr = p;
+    out->len = stop - p;
+    return stop + 1;
+}
+
+static int parse_fast(const char *logline, size_t len, LogFields *fields) {
+    const char *p = logline;
+    const char *end = logline + len;
+    StrView *f = fields->field;
+
+    if ((p = scan_token(p, end, &f[CF_IP])) == NULL) return -1;
+    if ((p = scan_token(p, end, &f[CF_IDENT])) == NULL) return -1;
+    if ((p = scan_token(p, end, &f[CF_USER])) == NULL) return -1;
+
+    if ((p = scan_quoted(p, end, '[', ']', &f[CF_TIME])) == NULL || f[CF_TIME].len == 0) return -1;
+    if (p == end || *p++ != ' ') return -1;
+
+    if ((p = scan_quoted(p, end, '"', '"', &f[CF_REQUEST])) == NULL) return -1;
+    if (p == end || *p++ != ' ') return -1;
+
+    if ((p = scan_number(p, end, &f[CF_STATUS])) == NULL) return -1;
+    if ((p = scan_number(p, end, &f[CF_SIZE])) == NULL) return -1;
+
+    if ((p = scan_quoted(p, end, '"', '"', &f[CF_REFERER])) == NULL) return -1;
+    if (p == end || *p++ != ' ') return -1;
+
+    if ((p = scan_quoted(p, end, '"', '"', &f[CF_AGENT])) == NULL) return -1;
+
+    return 0;
+}
+
+void parse_set_kind(ParserKind kind) {
+    parser_kind = kind;
+}
+
+int parse_combined_fields(const char *logline, size_t len, LogFields *fields) {
+    if (parser_kind != PARSER_PCRE && parse_fast(logline, len, fields) == 0)
+        return 0;
+    return parse_fallback(logline, len, fields);
+}
+
+// Разбор строки [p, end) и передача полей func
+static inline void parse_line(const char *p, const char *end, LineFieldsFunc func, void *arg) {
+    LogFields fields;
+    if (parse_combined_fields(p, end - p, &fields) == 0)
+        func(&fields, arg);
+}
+
+size_t parse_combined_block(const char *data, size_t size, LineFieldsFunc func, void *arg) {
+    const char *p = data;
+    const char *end = data + size;
+    size_t lines = 0;
+
+    while (p < end) {
+        const char *nl = memchr(p, '\n', end - p);
+        const char *next = nl != NULL ? nl + 1 : end;
+        parse_line(p, next, func, arg);
+        lines++;
+        p = next;
+    }
+    return lines;
+}
+
+static size_t view_to_size(StrView view) {
+    size_t value = 0;
+    for (size_t i = 0; i < view.len; ++i) {
+        if (!is_digit(view.ptr[i]))
+            break;
+        value = value * 10 + (view.ptr[i] - '0');
     }
     return value;
 }
 
-void parse_combined_logline(TopNContainer* url_to_sz, TopNContainer* ref_to_ct, TotalSize *total_sz, const char* logline) {
-    pcre *re;
-    const char *error;
-    int erroffset;
-    int ovector[OVECCOUNT];
-    int rc;
+// URL из запроса "METHOD PATH PROTOCOL"; запрос без версии HTTP берется целиком
+static int request_url(StrView request, StrView *url) {
+    if (memmem(request.ptr, request.len, "HTTP/", 5) == NULL) {
+        *url = request;
+        return 0;
+    }
+
+    StrView token[3];
+    const char *p = request.ptr;
+    const char *end = request.ptr + request.len;
+    for (int i = 0; i < 3; ++i) {
+        while (p < end && is_space(*p))
+            p++;
+        if (p == end)
+            return -1;
+        token[i].ptr = p;
+        while (p < end && !is_space(*p))
+            p++;
+        token[i].len = p - token[i].ptr;
+    }
 
-    const char *pattern =
-        "^(?P<ip>\\S+) (?P<ident>\\S+) (?P<user>\\S+) \\[(?P<time>[^\\]]+)\\] "
-        "\"(?P<request>[^\"]*)\" (?P<status>\\d+) (?P<size>\\d+) \"(?P<referer>[^\"]*)\" \"(?P<agent>[^\"]*)\"";
+    *url = token[1];
+    return 0;
+}
 
-    re = pcre_compile(pattern, 0, &error, &erroffset, NULL);
-    if (re == NULL) {
-        fprintf(stderr, "PCRE compilation failed at offset %d: %s\n", erroffset, error);
-        return;
+static int parse_digits(const char *p, int count) {
+    int value = 0;
+    for (int i = 0; i < count; ++i) {
+        if (!is_digit(p[i]))
+            return -1;
+        value = value * 10 + (p[i] - '0');
     }
+    return value;
+}
 
-    rc = pcre_exec(re, NULL, logline, strlen(logline), 0, 0, ovector, OVECCOUNT);
+// Количество дней от 1970-01-01 по григорианскому календарю
+static gint64 days_from_civil(gint64 year, int month, int day) {
+    year -= month <= 2;
+    const gint64 era = (year >= 0 ? year : year - 399) / 400;
+    const gint64 yoe = year - era * 400;
+    const gint64 doy = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+    const gint64 doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return era * 146097 + doe - 719468;
+}
 
-    if (rc < 0) {
-    #ifdef SHOULD_SHOW_DEBUG
-            switch(rc) {
-                case PCRE_ERROR_NOMATCH:
-                    printf("No match found: %s\n", logline);
-                    break;
-                default:
-                    printf("Matching error %d\n", rc);
-                    break;
-            }
-    #endif
-            pcre_free(re);
-            return;
-        }
+// Минута UTC из поля времени "10/Oct/2023:13:55:36 -0700"
+static int time_to_minute(StrView time, gint64 *minute) {
+    static const char months[] = "JanFebMarAprMayJunJulAugSepOctNovDec";
 
-        char *request = alloc_value_from_pcre(logline, re, ovector, REQUEST);
-        char *size = alloc_value_from_pcre(logline, re, ovector, SIZE);
-        if (request != NULL && size != NULL) {
-            char *url = NULL;
-            if (strstr(request, "HTTP/")) {
-                char method[16], path[256], protocol[16];
-                if (sscanf(request, "%15s %255s %15s", method, path, protocol) == 3) {
-                    const size_t len = strlen(path);
-                    url = malloc(len + 1);
-                    url[len] = '\0';
-                    strcpy(url, path);
-                } else {
-    #ifdef SHOULD_SHOW_DEBUG
-                    printf("Invalid request format: %s\n", request);
-    #endif
-                }
-            } else {
-                const size_t len = strlen(request);
-                url = malloc(len + 1);
-                url[len] = '\0';
-                strcpy(url, request);
-            }
-
-            if (url != NULL) {
-                topn_cont_add(url_to_sz, url, atoi(size));
-                free(url);
-            }
-
-            ts_add(total_sz, atoi(size));
-
-            free(size);
-            free(request);
-        } else {
-    #ifdef SHOULD_SHOW_DEBUG
-            if (request == NULL) printf("URL not parsed\n");
-            if (size == NULL) printf("Size not parsed\n");
-    #endif
-        }
+    if (time.len < 17 || time.ptr[2] != '/' || time.ptr[6] != '/' || time.ptr[11] != ':')
+        return -1;
+
+    int month = 0;
+    while (month < 12 && memcmp(months + month * 3, time.ptr + 3, 3) != 0)
+        month++;
+    if (month == 12)
+        return -1;
 
-        char *referer = alloc_value_from_pcre(logline, re, ovector, REFERER);
-        if (referer != NULL) {
-            topn_cont_add(ref_to_ct, referer, 1);
-            free(referer);
-        } else {
-    #ifdef SHOULD_SHOW_DEBUG
-            printf("Referer not parsed\n");
-    #endif
+    const int day = parse_digits(time.ptr, 2);
+    const int year = parse_digits(time.ptr + 7, 4);
+    const int hour = parse_digits(time.ptr + 12, 2);
+    const int min = parse_digits(time.ptr + 15, 2);
+    if (day < 0 || year < 0 || hour < 0 || min < 0)
+        return -1;
+
+    gint64 result = (days_from_civil(year, month + 1, day) * 24 + hour) * 60 + min;
+
+    // Смещение часового пояса, если оно есть
+    if (time.len >= 26 && (time.ptr[21] == '+' || time.ptr[21] == '-')) {
+        const int tz_hour = parse_digits(time.ptr + 22, 2);
+        const int tz_min = parse_digits(time.ptr + 24, 2);
+        if (tz_hour >= 0 && tz_min >= 0) {
+            const int offset = tz_hour * 60 + tz_min;
+            result += time.ptr[21] == '+' ? -offset : offset;
         }
+    }
+
+    *minute = result;
+    return 0;
+}
+
+// Добавление ключа в контейнер. При записи столбцов ключ получает
+// идентификатор в таблице строк потока, он же возвращается для строки
+static guint32 add_key(LogStats *stats, TopNContainer *cont, StrView key, gint64 value) {
+    if (stats->columns == NULL || topn_cont_is_approx(cont)) {
+        topn_cont_add_len(cont, key.ptr, key.len, value);
+        return stats->columns ? intern_id(stats->strings, key.ptr, key.len) : INTERN_NO_ID;
+    }
+    const guint32 id = intern_id(stats->strings, key.ptr, key.len);
+    topn_cont_add_id(cont, id, value);
+    return id;
+}
+
+// Учет разобранной строки в статистике arg
+static void add_fields(const LogFields *fields, void *arg) {
+    LogStats *stats = (LogStats*)arg;
+    const size_t size = view_to_size(fields->field[CF_SIZE]);
+    ColumnRow row = { INTERN_NO_ID, INTERN_NO_ID, INTERN_NO_ID, COLUMN_NO_MINUTE, 0, size };
+
+    StrView url;
+    if (request_url(fields->field[CF_REQUEST], &url) == 0) {
+        row.url = add_key(stats, stats->url_to_sz, url, size);
+    } else {
+#ifdef SHOULD_SHOW_DEBUG
+        printf("Invalid request format: %.*s\n",
+               (int)fields->field[CF_REQUEST].len, fields->field[CF_REQUEST].ptr);
+#endif
+    }
+
+    stats->total_size += size;
+    size_hist_add(&stats->sizes, size);
+
+    row.referer = add_key(stats, stats->ref_to_ct, fields->field[CF_REFERER], 1);
+    row.ip = add_key(stats, stats->ip_to_ct, fields->field[CF_IP], 1);
+
+    const StrView status = fields->field[CF_STATUS];
+    const int code = status.len == 3 ? parse_digits(status.ptr, 3) : -1;
+    row.status = code > 0 && code < STATUS_MAX ? code : 0;
+    stats->status[row.status]++;
+
+    gint64 minute;
+    if (time_to_minute(fields->field[CF_TIME], &minute) == 0) {
+        series_add(&stats->minutes, minute, 1, size);
+        if (minute > G_MININT32 && minute <= G_MAXINT32)
+            row.minute = minute;
+    }
+
+    if (stats->columns)
+        column_writer_add(stats->columns, &row);
+}
+
+void parse_combined_logline(LogStats* stats, const char* logline, size_t len) {
+    LogFields fields;
+    if (parse_combined_fields(logline, len, &fields) == 0)
+        add_fields(&fields, stats);
+}
 
-        pcre_free(re);
+void parse_combined_lines(LogStats* stats, const char* data, size_t size) {
+    parse_combined_block(data, size, add_fields, stats);
 }
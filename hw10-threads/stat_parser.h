@@ -1,24 +1,60 @@
 #pragma once
 
-#include "topn_container.h"
+#include "log_stats.h"
 
 #include <pcre.h>
 
 
+// Срез строки без копирования (не завершается нулем)
 typedef struct {
-    pthread_mutex_t mutex;
-    size_t total;
-} TotalSize;
+    const char* ptr;
+    size_t len;
+} StrView;
+
+// Поля Combined Log Format в порядке следования в строке
+typedef enum {
+    CF_IP = 0,
+    CF_IDENT,
+    CF_USER,
+    CF_TIME,
+    CF_REQUEST,
+    CF_STATUS,
+    CF_SIZE,
+    CF_REFERER,
+    CF_AGENT,
+    CF_COUNT
+} CombinedField;
 
-TotalSize* ts_init();
+typedef struct {
+    StrView field[CF_COUNT];
+} LogFields;
+
+// Способ разбора строк
+typedef enum {
+    PARSER_BYTES = 0,  // побайтовый проход по каждой строке
+    PARSER_PCRE        // только регулярное выражение
+} ParserKind;
+
+// Выбор способа разбора до запуска потоков разбора, по умолчанию PARSER_BYTES.
+// Для сравнения в hw10-bench -p
+void parse_set_kind(ParserKind kind);
+
+// Однопроходный разбор строки без выделения памяти, поля ссылаются на logline.
+// Строки, не прошедшие быстрый разбор, разбираются через PCRE.
+// Возвращает 0 при успехе и -1, если строка не распознана
+int parse_combined_fields(const char* logline, size_t len, LogFields* fields);
 
-void ts_free(TotalSize* total_size);
+// Обработчик полей разобранной строки
+typedef void (*LineFieldsFunc)(const LogFields* fields, void* arg);
 
-void ts_add(TotalSize* total_size, size_t size);
+// Разбор блока целых строк, func вызывается для каждой распознанной строки.
+// Возвращает количество строк в блоке
+size_t parse_combined_block(const char* data, size_t size, LineFieldsFunc func, void* arg);
 
+// Разбор блока целых строк в stats
+void parse_combined_lines(LogStats* stats, const char* data, size_t size);
 
 // Функция для парсинга и записи в структуру для хранения
-void parse_combined_logline(TopNContainer* url_to_sz,
-                            TopNContainer* ref_to_ct,
-                            TotalSize*     total_sz,
-                            const char*    logline);
+void parse_combined_logline(LogStats*   stats,
+                            const char* logline,
+                            size_t      len);
@@ -0,0 +1,157 @@
+#include "str_intern.h"
+#include "hash.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define ARENA_BLOCK_SZ (256 << 10)
+#define MIN_CAPACITY 64
+
+typedef struct ArenaBlock {
+    struct ArenaBlock* next;
+    size_t used;
+    size_t size;
+    char data[];
+} ArenaBlock;
+
+typedef struct {
+    const gchar* ptr;
+    guint32 len;
+    guint64 hash;
+} StrEntry;
+
+struct StrInterner {
+    ArenaBlock* blocks;
+    size_t arena_bytes;
+
+    StrEntry* entries;
+    guint32 count;
+    guint32 entries_cap;
+
+    guint32* table;
+    size_t table_cap;
+};
+
+static gchar* arena_copy(StrInterner* interner, const gchar* str, size_t len) {
+    ArenaBlock* block = interner->blocks;
+    if (block == NULL || block->size - block->used < len + 1) {
+        const size_t size = len + 1 > ARENA_BLOCK_SZ ? len + 1 : ARENA_BLOCK_SZ;
+        block = (ArenaBlock*)malloc(sizeof(ArenaBlock) + size);
+        block->next = interner->blocks;
+        block->used = 0;
+        block->size = size;
+        interner->blocks = block;
+        interner->arena_bytes += sizeof(ArenaBlock) + size;
+    }
+
+    gchar* copy = block->data + block->used;
+    memcpy(copy, str, len);
+    copy[len] = '\0';
+    block->used += len + 1;
+    return copy;
+}
+
+StrInterner* intern_init(size_t capacity) {
+    StrInterner* interner = (StrInterner*)calloc(1, sizeof(StrInterner));
+    interner->table_cap = MIN_CAPACITY;
+    while (interner->table_cap < capacity)
+        interner->table_cap <<= 1;
+    interner->table = (guint32*)malloc(sizeof(guint32) * interner->table_cap);
+    memset(interner->table, 0xff, sizeof(guint32) * interner->table_cap);
+    return interner;
+}
+
+void intern_free(StrInterner* interner) {
+    ArenaBlock* block = interner->blocks;
+    while (block != NULL) {
+        ArenaBlock* next = block->next;
+        free(block);
+        block = next;
+    }
+    free(interner->entries);
+    free(interner->table);
+    free(interner);
+}
+
+static void intern_grow(StrInterner* interner) {
+    free(interner->table);
+    interner->table_cap *= 2;
+    interner->table = (guint32*)malloc(sizeof(guint32) * interner->table_cap);
+    memset(interner->table, 0xff, sizeof(guint32) * interner->table_cap);
+
+    const size_t mask = interner->table_cap - 1;
+    for (guint32 id = 0; id < interner->count; ++id) {
+        size_t pos = interner->entries[id].hash & mask;
+        while (interner->table[pos] != INTERN_NO_ID)
+            pos = (pos + 1) & mask;
+        interner->table[pos] = id;
+    }
+}
+
+// Поиск по готовому хешу; при insert новая строка добавляется
+static guint32 intern_lookup(StrInterner* interner, const gchar* str, size_t len, guint64 hash, gboolean insert) {
+    if (insert && ((size_t)interner->count + 1) * 4 > interner->table_cap * 3)
+        intern_grow(interner);
+
+    const size_t mask = interner->table_cap - 1;
+    size_t pos = hash & mask;
+    for (;;) {
+        const guint32 id = interner->table[pos];
+        if (id == INTERN_NO_ID)
+            break;
+        const StrEntry* entry = &interner->entries[id];
+        if (entry->hash == hash && entry->len == len && memcmp(entry->ptr, str, len) == 0)
+            return id;
+        pos = (pos + 1) & mask;
+    }
+
+    if (!insert)
+        return INTERN_NO_ID;
+
+    if (interner->count == interner->entries_cap) {
+        interner->entries_cap = interner->entries_cap ? interner->entries_cap * 2 : MIN_CAPACITY;
+        interner->entries = (StrEntry*)realloc(interner->entries, sizeof(StrEntry) * interner->entries_cap);
+    }
+
+    const guint32 id = interner->count++;
+    interner->entries[id].ptr = arena_copy(interner, str, len);
+    interner->entries[id].len = len;
+    interner->entries[id].hash = hash;
+    interner->table[pos] = id;
+    return id;
+}
+
+guint32 intern_id(StrInterner* interner, const gchar* str, size_t len) {
+    return intern_lookup(interner, str, len, fnv1a64(str, len), TRUE);
+}
+
+guint32 intern_find(StrInterner* interner, const gchar* str, size_t len) {
+    return intern_lookup(interner, str, len, fnv1a64(str, len), FALSE);
+}
+
+const gchar* intern_str(StrInterner* interner, guint32 id) {
+    return interner->entries[id].ptr;
+}
+
+size_t intern_len(StrInterner* interner, guint32 id) {
+    return interner->entries[id].len;
+}
+
+guint32 intern_count(StrInterner* interner) {
+    return interner->count;
+}
+
+guint32* intern_merge(StrInterner* dst, StrInterner* src) {
+    guint32* remap = g_new(guint32, src->count ? src->count : 1);
+    for (guint32 id = 0; id < src->count; ++id) {
+        const StrEntry* entry = &src->entries[id];
+        remap[id] = intern_lookup(dst, entry->ptr, entry->len, entry->hash, TRUE);
+    }
+    return remap;
+}
+
+size_t intern_memory(StrInterner* interner) {
+    return interner->arena_bytes
+         + sizeof(StrEntry) * interner->entries_cap
+         + sizeof(guint32) * interner->table_cap;
+}
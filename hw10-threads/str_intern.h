@@ -0,0 +1,35 @@
+#pragma once
+
+#include <glib.h>
+
+#define INTERN_NO_ID G_MAXUINT32
+
+// Таблица уникальных строк потока: каждая строка хранится один раз
+// в арене с выделением сдвигом указателя и получает 32-битный идентификатор.
+// Не потокобезопасна
+typedef struct StrInterner StrInterner;
+
+StrInterner* intern_init(size_t capacity);
+
+void intern_free(StrInterner* interner);
+
+// Идентификатор строки длины len, новая строка копируется в арену
+guint32 intern_id(StrInterner* interner, const gchar* str, size_t len);
+
+// Идентификатор строки или INTERN_NO_ID, если ее нет
+guint32 intern_find(StrInterner* interner, const gchar* str, size_t len);
+
+// Строка по идентификатору, завершена нулем и живет до intern_free
+const gchar* intern_str(StrInterner* interner, guint32 id);
+
+size_t intern_len(StrInterner* interner, guint32 id);
+
+guint32 intern_count(StrInterner* interner);
+
+// Таблица перевода идентификаторов src в идентификаторы dst, недостающие
+// строки добавляются в dst. Каждая строка src хешируется один раз.
+// Освобождается через g_free
+guint32* intern_merge(StrInterner* dst, StrInterner* src);
+
+// Байт, занятых строками и таблицами
+size_t intern_memory(StrInterner* interner);
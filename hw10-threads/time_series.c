@@ -0,0 +1,166 @@
+#include "time_series.h"
+#include "serialize.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+void series_init(TimeSeries* series) {
+    memset(series, 0, sizeof(TimeSeries));
+}
+
+void series_free(TimeSeries* series) {
+    free(series->buckets);
+    series_init(series);
+}
+
+// Расширение ряда до интервала [first, last]
+static gboolean series_reserve(TimeSeries* series, gint64 first, gint64 last) {
+    if (series->size == 0) {
+        series->base = first;
+    } else {
+        if (first > series->base)
+            first = series->base;
+        if (last < series->base + (gint64)series->size - 1)
+            last = series->base + (gint64)series->size - 1;
+    }
+
+    const gint64 span = last - first + 1;
+    if (span > SERIES_MAX_SPAN)
+        return FALSE;
+
+    const size_t shift = series->size ? (size_t)(series->base - first) : 0;
+    if ((size_t)span > series->capacity) {
+        size_t capacity = series->capacity ? series->capacity : 64;
+        while (capacity < (size_t)span)
+            capacity *= 2;
+        SeriesBucket* buckets = (SeriesBucket*)calloc(capacity, sizeof(SeriesBucket));
+        if (series->size)
+            memcpy(buckets + shift, series->buckets, sizeof(SeriesBucket) * series->size);
+        free(series->buckets);
+        series->buckets = buckets;
+        series->capacity = capacity;
+    } else if (shift > 0) {
+        memmove(series->buckets + shift, series->buckets, sizeof(SeriesBucket) * series->size);
+        memset(series->buckets, 0, sizeof(SeriesBucket) * shift);
+    }
+
+    series->base = first;
+    series->size = span;
+    return TRUE;
+}
+
+void series_add(TimeSeries* series, gint64 minute, guint64 requests, guint64 bytes) {
+    // Обычно логи упорядочены по времени и запись попадает в уже выделенный интервал
+    if (series->size == 0 || minute < series->base || minute >= series->base + (gint64)series->size) {
+        if (!series_reserve(series, minute, minute)) {
+            series->dropped += requests;
+            return;
+        }
+    }
+
+    SeriesBucket* bucket = &series->buckets[minute - series->base];
+    bucket->requests += requests;
+    bucket->bytes += bytes;
+}
+
+void series_merge(TimeSeries* dst, const TimeSeries* src) {
+    dst->dropped += src->dropped;
+    if (src->size == 0)
+        return;
+
+    if (!series_reserve(dst, src->base, src->base + src->size - 1)) {
+        // Общий интервал слишком широк, переносим по одной минуте
+        for (size_t i = 0; i < src->size; ++i) {
+            if (src->buckets[i].requests)
+                series_add(dst, src->base + i, src->buckets[i].requests, src->buckets[i].bytes);
+        }
+        return;
+    }
+
+    SeriesBucket* target = &dst->buckets[src->base - dst->base];
+    for (size_t i = 0; i < src->size; ++i) {
+        target[i].requests += src->buckets[i].requests;
+        target[i].bytes += src->buckets[i].bytes;
+    }
+}
+
+gboolean series_peak(const TimeSeries* series, gint64* minute, SeriesBucket* bucket) {
+    gboolean found = FALSE;
+    for (size_t i = 0; i < series->size; ++i) {
+        if (series->buckets[i].requests == 0)
+            continue;
+        if (!found || series->buckets[i].requests > bucket->requests) {
+            *minute = series->base + i;
+            *bucket = series->buckets[i];
+            found = TRUE;
+        }
+    }
+    return found;
+}
+
+static void series_format_minute(gint64 minute, char* buf, size_t size) {
+    const time_t seconds = (time_t)(minute * 60);
+    struct tm tm;
+    gmtime_r(&seconds, &tm);
+    strftime(buf, size, "%Y-%m-%d %H:%M", &tm);
+}
+
+void series_print(const TimeSeries* series, gboolean full) {
+    char buf[32];
+
+    if (full) {
+        for (size_t i = 0; i < series->size; ++i) {
+            const SeriesBucket* bucket = &series->buckets[i];
+            if (bucket->requests == 0)
+                continue;
+            series_format_minute(series->base + i, buf, sizeof(buf));
+            printf("%s => %" G_GUINT64_FORMAT " requests, %" G_GUINT64_FORMAT " bytes\n",
+                   buf, bucket->requests, bucket->bytes);
+        }
+    }
+
+    gint64 minute = 0;
+    SeriesBucket peak = { 0, 0 };
+    if (series_peak(series, &minute, &peak)) {
+        series_format_minute(series->base, buf, sizeof(buf));
+        printf("From %s UTC, %lu minutes\n", buf, series->size);
+        series_format_minute(minute, buf, sizeof(buf));
+        printf("Peak %s => %" G_GUINT64_FORMAT " requests, %" G_GUINT64_FORMAT " bytes\n",
+               buf, peak.requests, peak.bytes);
+    } else {
+        printf("No timestamps\n");
+    }
+
+    if (series->dropped)
+        printf("Out of range: %" G_GUINT64_FORMAT " requests\n", series->dropped);
+}
+
+int series_save(const TimeSeries* series, FILE* file) {
+    if (write_i64(file, series->base) != 0 || write_u64(file, series->size) != 0 ||
+        write_u64(file, series->dropped) != 0)
+        return -1;
+    return write_bytes(file, series->buckets, sizeof(SeriesBucket) * series->size);
+}
+
+int series_load(TimeSeries* series, FILE* file) {
+    TimeSeries loaded;
+    series_init(&loaded);
+
+    guint64 size;
+    if (read_i64(file, &loaded.base) != 0 || read_u64(file, &size) != 0 ||
+        read_u64(file, &loaded.dropped) != 0 || size > SERIES_MAX_SPAN)
+        return -1;
+
+    loaded.size = loaded.capacity = size;
+    loaded.buckets = (SeriesBucket*)malloc(sizeof(SeriesBucket) * (size ? size : 1));
+    if (read_bytes(file, loaded.buckets, sizeof(SeriesBucket) * size) != 0) {
+        series_free(&loaded);
+        return -1;
+    }
+
+    series_merge(series, &loaded);
+    series_free(&loaded);
+    return 0;
+}
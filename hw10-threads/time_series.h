@@ -0,0 +1,44 @@
+#pragma once
+
+#include <glib.h>
+#include <stdio.h>
+
+// Не более года поминутных интервалов в одном ряду
+#define SERIES_MAX_SPAN (366 * 24 * 60)
+
+typedef struct {
+    guint64 requests;
+    guint64 bytes;
+} SeriesBucket;
+
+// Поминутный ряд запросов и байт. Интервалы хранятся плотным массивом
+// от base, массив расширяется в обе стороны по мере необходимости
+typedef struct {
+    gint64 base;
+    size_t size;
+    size_t capacity;
+    SeriesBucket* buckets;
+    // Записи, не поместившиеся в SERIES_MAX_SPAN
+    guint64 dropped;
+} TimeSeries;
+
+void series_init(TimeSeries* series);
+
+void series_free(TimeSeries* series);
+
+// minute - количество минут от начала эпохи UTC
+void series_add(TimeSeries* series, gint64 minute, guint64 requests, guint64 bytes);
+
+void series_merge(TimeSeries* dst, const TimeSeries* src);
+
+// Минута с наибольшим количеством запросов, FALSE для пустого ряда
+gboolean series_peak(const TimeSeries* series, gint64* minute, SeriesBucket* bucket);
+
+// Вывод непустых минут, при full == FALSE - только сводка
+void series_print(const TimeSeries* series, gboolean full);
+
+// Запись ряда в file, возвращает 0 при успехе
+int series_save(const TimeSeries* series, FILE* file);
+
+// Добавление ряда, записанного series_save. Возвращает 0 при успехе
+int series_load(TimeSeries* series, FILE* file);
@@ -1,244 +1,501 @@
 #include "topn_container.h"
+#include "serialize.h"
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <assert.h>
 
+#define MIN_CAPACITY 16
+
+// Слот хеш-таблицы с открытой адресацией, id == INTERN_NO_ID - свободный слот
+typedef struct {
+    guint32 id;
+    gint64 value;
+} TopNSlot;
+
 struct TopNContainer {
-    GSList *list;
+    StrInterner *interner;
+    TopNSketch *sketch;
+    TopNSlot *slots;
     size_t capacity;
-    pthread_mutex_t mutex;
+    size_t size;
 };
 
-typedef struct {
-    gchar* key;
-    gint value;
-} ListItem;
+// Перемешивание битов идентификатора (финализатор murmur3)
+static inline size_t topn_hash(guint32 id) {
+    guint32 h = id;
+    h ^= h >> 16;
+    h *= 0x85ebca6bu;
+    h ^= h >> 13;
+    h *= 0xc2b2ae35u;
+    h ^= h >> 16;
+    return h;
+}
 
-ListItem* li_init(gchar* key, gint value) {
-    ListItem *item = (ListItem*)g_malloc(sizeof(ListItem));
-    item->key = g_strdup(key);
-    item->value = value;
-    return item;
+static size_t round_up_pow2(size_t value) {
+    size_t result = MIN_CAPACITY;
+    while (result < value)
+        result <<= 1;
+    return result;
 }
 
-void li_free(ListItem* item) {
-    g_free(item->key);
-    g_free(item);
+static TopNSlot* topn_alloc_slots(size_t capacity) {
+    TopNSlot *slots = (TopNSlot*)malloc(sizeof(TopNSlot) * capacity);
+    for (size_t i = 0; i < capacity; ++i)
+        slots[i].id = INTERN_NO_ID;
+    return slots;
 }
 
-TopNContainer* topn_cont_init(int capacity) {
+TopNContainer* topn_cont_init(StrInterner* interner, size_t capacity) {
     TopNContainer *cont = (TopNContainer*)malloc(sizeof(TopNContainer));
-    pthread_mutex_init(&cont->mutex, NULL);
-    cont->list = NULL;
-    cont->capacity = capacity;
+    cont->interner = interner;
+    cont->sketch = NULL;
+    cont->capacity = round_up_pow2(capacity);
+    cont->slots = topn_alloc_slots(cont->capacity);
+    cont->size = 0;
+    return cont;
+}
+
+TopNContainer* topn_cont_init_approx(size_t counters) {
+    TopNContainer *cont = (TopNContainer*)malloc(sizeof(TopNContainer));
+    cont->interner = NULL;
+    cont->sketch = sketch_init(counters);
+    cont->capacity = 0;
+    cont->slots = NULL;
+    cont->size = 0;
     return cont;
 }
 
+gboolean topn_cont_is_approx(TopNContainer* cont) {
+    return cont->sketch != NULL;
+}
+
 void topn_cont_free(TopNContainer* cont) {
+    if (cont->sketch)
+        sketch_free(cont->sketch);
+    free(cont->slots);
     cont->capacity = 0;
-    GSList *iter = NULL;
-    for (iter = cont->list; iter != NULL; iter = iter->next) {
-        ListItem *item = (ListItem*)iter->data;
-        li_free(item);
-    }
-    g_slist_free(cont->list);
-    pthread_mutex_destroy(&cont->mutex);
+    cont->size = 0;
     free(cont);
 }
 
-gint topn_value_compare(gconstpointer a, gconstpointer b) {
-    ListItem *item_a = (ListItem*)a;
-    ListItem *item_b = (ListItem*)b;
-
-    if (item_a->value < item_b->value) {
-        return 1;
-    } else if (item_a->value > item_b->value) {
-        return -1;
+static void topn_cont_grow(TopNContainer* cont) {
+    const size_t old_capacity = cont->capacity;
+    TopNSlot *old_slots = cont->slots;
+
+    cont->capacity = old_capacity * 2;
+    cont->slots = topn_alloc_slots(cont->capacity);
+
+    const size_t mask = cont->capacity - 1;
+    for (size_t i = 0; i < old_capacity; ++i) {
+        if (old_slots[i].id == INTERN_NO_ID)
+            continue;
+        size_t pos = topn_hash(old_slots[i].id) & mask;
+        while (cont->slots[pos].id != INTERN_NO_ID)
+            pos = (pos + 1) & mask;
+        cont->slots[pos] = old_slots[i];
     }
 
-    return 0;
+    free(old_slots);
 }
 
-void topn_cont_add_item(TopNContainer* cont, gchar* key, gint value) {
-    GSList *iter = NULL;
+void topn_cont_add_id(TopNContainer* cont, guint32 id, gint64 value) {
+    assert(cont->sketch == NULL);
 
-    if (cont->list != NULL) {
-        for (iter = cont->list; iter != NULL; iter = iter->next) {
-            ListItem *item = (ListItem*)iter->data;
-            if (g_strcmp0(item->key, key) == 0) {
-                item->value += value;
-                break;
-            }
+    // Коэффициент заполнения не выше 0.75
+    if ((cont->size + 1) * 4 > cont->capacity * 3)
+        topn_cont_grow(cont);
+
+    const size_t mask = cont->capacity - 1;
+    size_t pos = topn_hash(id) & mask;
+    for (;;) {
+        TopNSlot *slot = &cont->slots[pos];
+        if (slot->id == id) {
+            slot->value += value;
+            return;
         }
+        if (slot->id == INTERN_NO_ID) {
+            slot->id = id;
+            slot->value = value;
+            cont->size++;
+            return;
+        }
+        pos = (pos + 1) & mask;
     }
+}
 
-    if (iter == NULL) {
-        ListItem *item = li_init(key, value);
-        cont->list = g_slist_insert_sorted(cont->list, item, topn_value_compare);
-    } else {
-        cont->list = g_slist_sort(cont->list, topn_value_compare);
-    }
+void topn_cont_add(TopNContainer* cont, const gchar* key, gint64 value) {
+    topn_cont_add_len(cont, key, strlen(key), value);
 }
 
-void topn_cont_prep_capacity(TopNContainer* cont) {
-    while (g_slist_length(cont->list) > cont->capacity) {
-        gpointer last = g_slist_nth_data(cont->list, cont->capacity);
-        cont->list = g_slist_remove(cont->list, last);
-        ListItem *last_item = (ListItem*)last;
-        li_free(last_item);
+void topn_cont_add_len(TopNContainer* cont, const gchar* key, size_t len, gint64 value) {
+    if (cont->sketch) {
+        sketch_add(cont->sketch, key, len, value);
+        return;
     }
+    topn_cont_add_id(cont, intern_id(cont->interner, key, len), value);
 }
 
-void topn_cont_add(TopNContainer* cont, gchar* key, gint value) {
-    pthread_mutex_lock(&cont->mutex);
+size_t topn_cont_size(TopNContainer* cont) {
+    if (cont->sketch)
+        return sketch_size(cont->sketch);
+    return cont->size;
+}
 
-    topn_cont_add_item(cont, key, value);
+void topn_cont_merge(TopNContainer *dst, TopNContainer *src, const guint32* remap) {
+    assert((dst->sketch == NULL) == (src->sketch == NULL));
+    if (dst->sketch) {
+        sketch_merge(dst->sketch, src->sketch);
+        return;
+    }
 
-    topn_cont_prep_capacity(cont);
+    for (size_t i = 0; i < src->capacity; ++i) {
+        const TopNSlot *slot = &src->slots[i];
+        if (slot->id != INTERN_NO_ID)
+            topn_cont_add_id(dst, remap != NULL ? remap[slot->id] : slot->id, slot->value);
+    }
+}
 
-    pthread_mutex_unlock(&cont->mutex);
+// true, если a должен стоять в отчете выше b
+static int topn_item_before(const TopNItem *a, const TopNItem *b) {
+    if (a->value != b->value)
+        return a->value > b->value;
+    return strcmp(a->key, b->key) < 0;
 }
 
-void topn_cont_merge(TopNContainer *dst, TopNContainer *src) {
-    pthread_mutex_lock(&dst->mutex);
+// Просеивание вниз в куче, где на вершине худший из отобранных элементов
+static void topn_heap_down(TopNItem *heap, size_t size, size_t pos) {
+    for (;;) {
+        size_t worst = pos;
+        const size_t left = 2 * pos + 1;
+        const size_t right = left + 1;
+        if (left < size && topn_item_before(&heap[worst], &heap[left]))
+            worst = left;
+        if (right < size && topn_item_before(&heap[worst], &heap[right]))
+            worst = right;
+        if (worst == pos)
+            return;
+        TopNItem tmp = heap[pos];
+        heap[pos] = heap[worst];
+        heap[worst] = tmp;
+        pos = worst;
+    }
+}
 
-    GSList *src_copy = g_slist_copy(src->list);
+// Добавление кандидата в кучу из не более count лучших элементов
+static void topn_heap_offer(TopNItem *heap, size_t *size, size_t count, const TopNItem *item) {
+    if (*size < count) {
+        heap[(*size)++] = *item;
+        if (*size == count) {
+            for (size_t j = count / 2; j-- > 0;)
+                topn_heap_down(heap, *size, j);
+        }
+    } else if (topn_item_before(item, &heap[0])) {
+        heap[0] = *item;
+        topn_heap_down(heap, *size, 0);
+    }
+}
+
+size_t topn_cont_top(TopNContainer* cont, size_t count, TopNItem* out) {
+    size_t size = 0;
+
+    if (count == 0)
+        return 0;
 
-    size_t capacity = dst->capacity;
-    dst->capacity += src->capacity;
+    if (cont->sketch) {
+        const size_t counters = sketch_size(cont->sketch);
+        for (size_t i = 0; i < counters; ++i) {
+            TopNItem item;
+            item.key = sketch_counter(cont->sketch, i, &item.value, &item.error);
+            topn_heap_offer(out, &size, count, &item);
+        }
+    } else {
+        for (size_t i = 0; i < cont->capacity; ++i) {
+            const TopNSlot *slot = &cont->slots[i];
+            if (slot->id == INTERN_NO_ID)
+                continue;
 
-    GSList *iter;
-    for (iter = src_copy; iter != NULL; iter = iter->next) {
-        ListItem *item = (ListItem*)iter->data;
-        topn_cont_add_item(dst, item->key, item->value);
+            TopNItem item = { intern_str(cont->interner, slot->id), slot->value, 0 };
+            topn_heap_offer(out, &size, count, &item);
+        }
     }
 
-    dst->capacity = capacity;
+    if (size < count) {
+        for (size_t j = size / 2; j-- > 0;)
+            topn_heap_down(out, size, j);
+    }
 
-    topn_cont_prep_capacity(dst);
+    // Извлечение худшего в конец дает порядок по убыванию
+    for (size_t end = size; end > 1; --end) {
+        TopNItem tmp = out[0];
+        out[0] = out[end - 1];
+        out[end - 1] = tmp;
+        topn_heap_down(out, end - 1, 0);
+    }
 
-    pthread_mutex_unlock(&dst->mutex);
+    return size;
 }
 
 void topn_cont_print(TopNContainer* cont, size_t count) {
-    if (count > cont->capacity)
-        count = cont->capacity;
+    TopNItem *items = (TopNItem*)malloc(sizeof(TopNItem) * (count ? count : 1));
+
+    const size_t size = topn_cont_top(cont, count, items);
+    for (size_t i = 0; i < size; ++i) {
+        if (cont->sketch)
+            printf("%s => %" G_GINT64_FORMAT " (+-%" G_GINT64_FORMAT ")\n",
+                   items[i].key, items[i].value, items[i].error);
+        else
+            printf("%s => %" G_GINT64_FORMAT "\n", items[i].key, items[i].value);
+    }
 
-    size_t length = g_slist_length(cont->list);
-    if (count > length)
-        count = length;
+    if (cont->sketch) {
+        // Ключ с истинным значением выше границы гарантированно попадает в сводку
+        printf("Approximate: %lu counters, total %" G_GINT64_FORMAT ", error bound %" G_GINT64_FORMAT "\n",
+               sketch_size(cont->sketch), sketch_total(cont->sketch),
+               sketch_error_bound(cont->sketch));
+    }
+
+    free(items);
+}
+
+int topn_cont_save(TopNContainer* cont, FILE* file) {
+    if (cont->sketch)
+        return sketch_save(cont->sketch, file);
+
+    if (write_u64(file, cont->size) != 0)
+        return -1;
+    for (size_t i = 0; i < cont->capacity; ++i) {
+        const TopNSlot *slot = &cont->slots[i];
+        if (slot->id == INTERN_NO_ID)
+            continue;
+        if (write_str(file, intern_str(cont->interner, slot->id), intern_len(cont->interner, slot->id)) != 0 ||
+            write_i64(file, slot->value) != 0)
+            return -1;
+    }
+    return 0;
+}
+
+int topn_cont_load(TopNContainer* cont, FILE* file) {
+    if (cont->sketch)
+        return sketch_load(cont->sketch, file);
 
-    pthread_mutex_lock(&cont->mutex);
+    guint64 count;
+    if (read_u64(file, &count) != 0)
+        return -1;
 
-    size_t i = 0;
-    GSList *iter;
-    for (iter = cont->list; iter != NULL; iter = iter->next) {
-        ListItem *item = (ListItem*)iter->data;
-        printf("%s => %d\n", item->key, item->value);
-        if (i++ == count) {
+    gchar *key = NULL;
+    size_t cap = 0, len;
+    int result = 0;
+    for (guint64 i = 0; i < count; ++i) {
+        gint64 value;
+        if (read_str(file, &key, &cap, &len) != 0 || read_i64(file, &value) != 0) {
+            result = -1;
             break;
         }
+        topn_cont_add_len(cont, key, len, value);
     }
-
-    pthread_mutex_unlock(&cont->mutex);
+    g_free(key);
+    return result;
 }
 
 void topn_test() {
+    StrInterner *interner = intern_init(0);
+
     {   // sorting test
-        TopNContainer *cont = topn_cont_init(5);
+        TopNContainer *cont = topn_cont_init(interner, 5);
         topn_cont_add(cont, "n0", 1);
         topn_cont_add(cont, "n1", 2);
         topn_cont_add(cont, "n2", 3);
         topn_cont_add(cont, "n3", 4);
         topn_cont_add(cont, "n4", 5);
         topn_cont_add(cont, "n5", 6);
-        assert(g_slist_length(cont->list) == 5);
-
-        ListItem *item = NULL;
-        item = (ListItem*)g_slist_nth(cont->list, 0)->data;
-        assert(g_strcmp0(item->key, "n5") == 0);
-        item = (ListItem*)g_slist_nth(cont->list, 1)->data;
-        assert(g_strcmp0(item->key, "n4") == 0);
-        item = (ListItem*)g_slist_nth(cont->list, 2)->data;
-        assert(g_strcmp0(item->key, "n3") == 0);
-        item = (ListItem*)g_slist_nth(cont->list, 3)->data;
-        assert(g_strcmp0(item->key, "n2") == 0);
-        item = (ListItem*)g_slist_nth(cont->list, 4)->data;
-        assert(g_strcmp0(item->key, "n1") == 0);
+        assert(topn_cont_size(cont) == 6);
+
+        TopNItem items[5];
+        G_GNUC_UNUSED const size_t top_count = topn_cont_top(cont, 5, items);
+        assert(top_count == 5);
+        assert(g_strcmp0(items[0].key, "n5") == 0);
+        assert(g_strcmp0(items[1].key, "n4") == 0);
+        assert(g_strcmp0(items[2].key, "n3") == 0);
+        assert(g_strcmp0(items[3].key, "n2") == 0);
+        assert(g_strcmp0(items[4].key, "n1") == 0);
 
         printf("sorting test passed\n");
         topn_cont_free(cont);
     }
 
     {   // equal values test
-        TopNContainer *cont = topn_cont_init(5);
+        TopNContainer *cont = topn_cont_init(interner, 5);
         topn_cont_add(cont, "n0", 1);
         topn_cont_add(cont, "n1", 1);
         topn_cont_add(cont, "n2", 1);
         topn_cont_add(cont, "n3", 6);
         topn_cont_add(cont, "n4", 6);
         topn_cont_add(cont, "n5", 6);
-        assert(g_slist_length(cont->list) == 5);
-
-        ListItem *item = NULL;
-        item = (ListItem*)g_slist_nth(cont->list, 0)->data;
-        assert(g_strcmp0(item->key, "n5") == 0);
-        item = (ListItem*)g_slist_nth(cont->list, 1)->data;
-        assert(g_strcmp0(item->key, "n4") == 0);
-        item = (ListItem*)g_slist_nth(cont->list, 2)->data;
-        assert(g_strcmp0(item->key, "n3") == 0);
-        item = (ListItem*)g_slist_nth(cont->list, 3)->data;
-        assert(g_strcmp0(item->key, "n2") == 0);
-        item = (ListItem*)g_slist_nth(cont->list, 4)->data;
-        assert(g_strcmp0(item->key, "n1") == 0);
+        assert(topn_cont_size(cont) == 6);
+
+        TopNItem items[5];
+        G_GNUC_UNUSED const size_t top_count = topn_cont_top(cont, 5, items);
+        assert(top_count == 5);
+        assert(g_strcmp0(items[0].key, "n3") == 0);
+        assert(g_strcmp0(items[1].key, "n4") == 0);
+        assert(g_strcmp0(items[2].key, "n5") == 0);
+        assert(g_strcmp0(items[3].key, "n0") == 0);
+        assert(g_strcmp0(items[4].key, "n1") == 0);
 
         printf("equal values test passed\n");
         topn_cont_free(cont);
     }
 
     {   // merge test
-        TopNContainer *dst = topn_cont_init(3);
+        TopNContainer *dst = topn_cont_init(interner, 3);
         topn_cont_add(dst, "n0", 2);
         topn_cont_add(dst, "n1", 3);
         topn_cont_add(dst, "n2", 4);
 
-        TopNContainer *src = topn_cont_init(4);
+        TopNContainer *src = topn_cont_init(interner, 4);
         topn_cont_add(src, "n0", 4);
         topn_cont_add(src, "n1", 3);
         topn_cont_add(src, "n2", 2);
         topn_cont_add(src, "n3", 7);
 
-        topn_cont_merge(dst, src);
+        topn_cont_merge(dst, src, NULL);
 
-        assert(g_slist_length(dst->list) == 3);
-        ListItem *item = NULL;
-        item = (ListItem*)g_slist_nth(dst->list, 0)->data;
-        assert(g_strcmp0(item->key, "n3") == 0);
-        item = (ListItem*)g_slist_nth(dst->list, 1)->data;
-        assert(g_strcmp0(item->key, "n0") == 0);
-        item = (ListItem*)g_slist_nth(dst->list, 2)->data;
-        assert(g_strcmp0(item->key, "n1") == 0);
+        assert(topn_cont_size(dst) == 4);
+        TopNItem items[3];
+        G_GNUC_UNUSED const size_t top_count = topn_cont_top(dst, 3, items);
+        assert(top_count == 3);
+        assert(g_strcmp0(items[0].key, "n3") == 0);
+        assert(g_strcmp0(items[1].key, "n0") == 0);
+        assert(g_strcmp0(items[2].key, "n1") == 0);
 
         printf("merge test passed\n");
         topn_cont_free(dst);
         topn_cont_free(src);
     }
 
-    {   // memory test
-        TopNContainer *cont = topn_cont_init(20);
+    {   // merge with separate string tables test
+        StrInterner *src_interner = intern_init(0);
+        TopNContainer *dst = topn_cont_init(interner, 3);
+        topn_cont_add(dst, "m0", 5);
+        topn_cont_add(dst, "m1", 1);
+
+        TopNContainer *src = topn_cont_init(src_interner, 3);
+        topn_cont_add(src, "m2", 3);
+        topn_cont_add(src, "m1", 7);
+
+        guint32 *remap = intern_merge(interner, src_interner);
+        topn_cont_merge(dst, src, remap);
+        g_free(remap);
+
+        assert(topn_cont_size(dst) == 3);
+        TopNItem items[3];
+        G_GNUC_UNUSED const size_t top_count = topn_cont_top(dst, 3, items);
+        assert(top_count == 3);
+        assert(g_strcmp0(items[0].key, "m1") == 0 && items[0].value == 8);
+        assert(g_strcmp0(items[1].key, "m0") == 0 && items[1].value == 5);
+        assert(g_strcmp0(items[2].key, "m2") == 0 && items[2].value == 3);
+
+        printf("remap merge test passed\n");
+        topn_cont_free(dst);
+        topn_cont_free(src);
+        intern_free(src_interner);
+    }
 
-        for (size_t i = 0; i < 10000000; ++i) {
-            char *key = malloc(2048);
-            memset(key, g_random_int_range('a', 'z'), 2048);
-            topn_cont_add(cont, key, g_random_int_range(0, 999999));
-            free(key);
+    {   // exact totals test
+        TopNContainer *cont = topn_cont_init(interner, 4);
+        char key[32];
+        gint64 total = 0;
+
+        for (int i = 0; i < 100000; ++i) {
+            snprintf(key, sizeof(key), "k%d", i % 5000);
+            topn_cont_add(cont, key, i);
+            total += i;
+        }
+        assert(topn_cont_size(cont) == 5000);
+
+        TopNItem *items = (TopNItem*)malloc(sizeof(TopNItem) * 5000);
+        G_GNUC_UNUSED const size_t top_count = topn_cont_top(cont, 5000, items);
+        assert(top_count == 5000);
+        gint64 sum = 0;
+        for (size_t i = 0; i < 5000; ++i) {
+            sum += items[i].value;
+            if (i > 0)
+                assert(items[i - 1].value >= items[i].value);
         }
+        assert(sum == total);
+        assert(g_strcmp0(items[0].key, "k4999") == 0);
+        free(items);
 
-        assert(g_slist_length(cont->list) == 20);
+        printf("exact totals test passed\n");
+        topn_cont_free(cont);
+    }
+
+    {   // approximate mode test
+        TopNContainer *dst = topn_cont_init_approx(8);
+        TopNContainer *src = topn_cont_init_approx(8);
+        char key[32];
+
+        // Тяжелые ключи h0..h2 и много редких ключей
+        for (int i = 0; i < 20000; ++i) {
+            TopNContainer *cont = (i % 2) ? src : dst;
+            if (i % 10 < 3) {
+                snprintf(key, sizeof(key), "h%d", i % 10);
+                topn_cont_add(cont, key, 10);
+            } else {
+                snprintf(key, sizeof(key), "r%d", i);
+                topn_cont_add(cont, key, 1);
+            }
+        }
+        topn_cont_merge(dst, src, NULL);
+        assert(topn_cont_size(dst) <= 8);
+
+        TopNItem items[3];
+        G_GNUC_UNUSED const size_t top_count = topn_cont_top(dst, 3, items);
+        assert(top_count == 3);
+        for (size_t i = 0; i < 3; ++i) {
+            // Истинное значение каждого тяжелого ключа 20000
+            assert(items[i].key[0] == 'h');
+            assert(items[i].value >= 20000 && items[i].value - items[i].error <= 20000);
+        }
+
+        printf("approximate mode test passed\n");
+        topn_cont_free(dst);
+        topn_cont_free(src);
+    }
 
-        printf("memory test passed\n");
+    {   // memory test: повторяющиеся ключи хранятся один раз
+        StrInterner *strings = intern_init(0);
+        TopNContainer *cont = topn_cont_init(strings, 20);
+        char keys[25][2048];
+        for (size_t k = 0; k < 25; ++k)
+            memset(keys[k], 'a' + k, sizeof(keys[k]));
+
+        for (size_t i = 0; i < 1000000; ++i)
+            topn_cont_add_len(cont, keys[i % 25], sizeof(keys[0]), i % 1000);
+
+        assert(topn_cont_size(cont) == 25);
+        // Один блок арены и таблицы, независимо от количества добавлений
+        assert(intern_memory(strings) < (1 << 20));
+
+        printf("memory test passed: %lu bytes for %lu keys\n", intern_memory(strings), topn_cont_size(cont));
         topn_cont_free(cont);
+        intern_free(strings);
     }
+
+    {   // approximate memory test: память ограничена числом счетчиков
+        TopNContainer *cont = topn_cont_init_approx(64);
+        char key[32];
+        for (int i = 0; i < 1000000; ++i) {
+            snprintf(key, sizeof(key), "u%d", i);
+            topn_cont_add(cont, key, 1);
+        }
+        assert(topn_cont_size(cont) == 64);
+
+        printf("approximate memory test passed\n");
+        topn_cont_free(cont);
+    }
+
+    intern_free(interner);
 }
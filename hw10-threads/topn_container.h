@@ -1,25 +1,68 @@
 #pragma once
 
-#include <glib.h>
-#include <pthread.h>
+#include "str_intern.h"
+#include "topn_sketch.h"
 
-// Контейнер для хранения топ-N элементов
+// Контейнер для хранения топ-N элементов.
+// Не потокобезопасен: каждый поток работает со своим экземпляром
 typedef struct TopNContainer TopNContainer;
 
-// Инициализация контейнера для хранения топ-N элементов
-TopNContainer* topn_cont_init(int capacity);
+// Элемент отчета, key принадлежит таблице строк контейнера.
+// error - максимальное завышение value, в точном режиме всегда 0
+typedef struct {
+    const gchar* key;
+    gint64 value;
+    gint64 error;
+} TopNItem;
+
+// Инициализация контейнера, capacity - начальный размер хеш-таблицы.
+// Ключи хранятся в interner как идентификаторы, несколько контейнеров
+// одного потока могут использовать общую таблицу строк.
+// Контейнер хранит все ключи точно и растет по мере необходимости
+TopNContainer* topn_cont_init(StrInterner* interner, size_t capacity);
+
+// Инициализация приближенного контейнера с памятью на counters ключей.
+// Ключи копируются в сводку Space-Saving, таблица строк не используется,
+// значение любого ключа завышено не более чем на сумму значений / counters
+TopNContainer* topn_cont_init_approx(size_t counters);
+
+// TRUE для контейнера, созданного topn_cont_init_approx
+gboolean topn_cont_is_approx(TopNContainer* cont);
 
 // Освобождение контейнера для хранения топ-N элементов
 void topn_cont_free(TopNContainer* cont);
 
 // Добавляет элемент в контейнер для хранения топ-N элементов
-void topn_cont_add(TopNContainer* cont, gchar* key, gint value);
+void topn_cont_add(TopNContainer* cont, const gchar* key, gint64 value);
+
+// Добавляет элемент по ключу длины len, не завершенному нулем
+void topn_cont_add_len(TopNContainer* cont, const gchar* key, size_t len, gint64 value);
+
+// Добавляет значение по идентификатору строки из таблицы контейнера
+void topn_cont_add_id(TopNContainer* cont, guint32 id, gint64 value);
 
-// Вывод топ-N элементов контейнера
+// Количество различных ключей (в приближенном режиме - отслеживаемых)
+size_t topn_cont_size(TopNContainer* cont);
+
+// Запись count наибольших элементов в out по убыванию значения,
+// возвращает количество записанных элементов
+size_t topn_cont_top(TopNContainer* cont, size_t count, TopNItem* out);
+
+// Вывод топ-N элементов контейнера, в приближенном режиме с погрешностями
 void topn_cont_print(TopNContainer* cont, size_t count);
 
-// Объединение двух контейнеров топ-N для хранения топ-N элементов
-void topn_cont_merge(TopNContainer* dst, TopNContainer* src);
+// Объединение двух контейнеров топ-N для хранения топ-N элементов.
+// remap переводит идентификаторы src в идентификаторы dst (см. intern_merge),
+// NULL - контейнеры используют одну таблицу строк.
+// Контейнеры должны быть одного режима, для приближенных remap не используется
+void topn_cont_merge(TopNContainer* dst, TopNContainer* src, const guint32* remap);
+
+// Запись ключей и значений контейнера в file, возвращает 0 при успехе
+int topn_cont_save(TopNContainer* cont, FILE* file);
+
+// Добавление в контейнер ключей, записанных topn_cont_save.
+// Приближенный контейнер должен быть пуст. Возвращает 0 при успехе
+int topn_cont_load(TopNContainer* cont, FILE* file);
 
 // Функция для тестирования контейнера для хранения топ-N элементов
 void topn_test();
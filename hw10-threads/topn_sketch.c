@@ -0,0 +1,308 @@
+#include "topn_sketch.h"
+#include "hash.h"
+#include "serialize.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define NO_COUNTER G_MAXUINT32
+
+typedef struct {
+    gchar* key;
+    size_t len;
+    guint64 hash;
+    gint64 value;
+    gint64 error;
+    size_t heap_pos;
+} SketchCounter;
+
+struct TopNSketch {
+    SketchCounter* counters;
+    size_t capacity;
+    size_t size;
+    gint64 total;
+
+    // Куча индексов счетчиков с минимальным значением на вершине
+    guint32* heap;
+
+    // Индекс ключа -> счетчик, линейное пробирование с удалением сдвигом
+    guint32* table;
+    size_t table_mask;
+};
+
+TopNSketch* sketch_init(size_t counters) {
+    if (counters == 0)
+        counters = 1;
+
+    TopNSketch* sketch = (TopNSketch*)calloc(1, sizeof(TopNSketch));
+    sketch->capacity = counters;
+    sketch->counters = (SketchCounter*)calloc(counters, sizeof(SketchCounter));
+    sketch->heap = (guint32*)malloc(sizeof(guint32) * counters);
+
+    size_t table_size = 16;
+    while (table_size < counters * 2)
+        table_size <<= 1;
+    sketch->table = (guint32*)malloc(sizeof(guint32) * table_size);
+    memset(sketch->table, 0xff, sizeof(guint32) * table_size);
+    sketch->table_mask = table_size - 1;
+    return sketch;
+}
+
+void sketch_free(TopNSketch* sketch) {
+    for (size_t i = 0; i < sketch->size; ++i)
+        g_free(sketch->counters[i].key);
+    free(sketch->counters);
+    free(sketch->heap);
+    free(sketch->table);
+    free(sketch);
+}
+
+static size_t table_find(TopNSketch* sketch, const gchar* key, size_t len, guint64 hash) {
+    size_t pos = hash & sketch->table_mask;
+    for (;;) {
+        const guint32 index = sketch->table[pos];
+        if (index == NO_COUNTER)
+            return pos;
+        const SketchCounter* counter = &sketch->counters[index];
+        if (counter->hash == hash && counter->len == len && memcmp(counter->key, key, len) == 0)
+            return pos;
+        pos = (pos + 1) & sketch->table_mask;
+    }
+}
+
+static void table_remove(TopNSketch* sketch, size_t pos) {
+    // Сдвиг следующих элементов цепочки на освободившееся место
+    size_t hole = pos;
+    size_t next = (pos + 1) & sketch->table_mask;
+    while (sketch->table[next] != NO_COUNTER) {
+        const size_t home = sketch->counters[sketch->table[next]].hash & sketch->table_mask;
+        if (((next - home) & sketch->table_mask) >= ((next - hole) & sketch->table_mask)) {
+            sketch->table[hole] = sketch->table[next];
+            hole = next;
+        }
+        next = (next + 1) & sketch->table_mask;
+    }
+    sketch->table[hole] = NO_COUNTER;
+}
+
+static inline gint64 heap_value(TopNSketch* sketch, size_t pos) {
+    return sketch->counters[sketch->heap[pos]].value;
+}
+
+static void heap_swap(TopNSketch* sketch, size_t a, size_t b) {
+    guint32 tmp = sketch->heap[a];
+    sketch->heap[a] = sketch->heap[b];
+    sketch->heap[b] = tmp;
+    sketch->counters[sketch->heap[a]].heap_pos = a;
+    sketch->counters[sketch->heap[b]].heap_pos = b;
+}
+
+static void heap_up(TopNSketch* sketch, size_t pos) {
+    while (pos > 0) {
+        const size_t parent = (pos - 1) / 2;
+        if (heap_value(sketch, parent) <= heap_value(sketch, pos))
+            return;
+        heap_swap(sketch, parent, pos);
+        pos = parent;
+    }
+}
+
+static void heap_down(TopNSketch* sketch, size_t pos) {
+    for (;;) {
+        size_t min = pos;
+        const size_t left = 2 * pos + 1;
+        const size_t right = left + 1;
+        if (left < sketch->size && heap_value(sketch, left) < heap_value(sketch, min))
+            min = left;
+        if (right < sketch->size && heap_value(sketch, right) < heap_value(sketch, min))
+            min = right;
+        if (min == pos)
+            return;
+        heap_swap(sketch, pos, min);
+        pos = min;
+    }
+}
+
+static void sketch_insert(TopNSketch* sketch, size_t pos, const gchar* key, size_t len,
+                          guint64 hash, gint64 value, gint64 error) {
+    const size_t index = sketch->size++;
+    SketchCounter* counter = &sketch->counters[index];
+    counter->key = g_strndup(key, len);
+    counter->len = len;
+    counter->hash = hash;
+    counter->value = value;
+    counter->error = error;
+    counter->heap_pos = index;
+    sketch->heap[index] = index;
+    sketch->table[pos] = index;
+    heap_up(sketch, index);
+}
+
+void sketch_add(TopNSketch* sketch, const gchar* key, size_t len, gint64 value) {
+    const guint64 hash = fnv1a64(key, len);
+    sketch->total += value;
+
+    size_t pos = table_find(sketch, key, len, hash);
+    const guint32 index = sketch->table[pos];
+    if (index != NO_COUNTER) {
+        SketchCounter* counter = &sketch->counters[index];
+        counter->value += value;
+        heap_down(sketch, counter->heap_pos);
+        return;
+    }
+
+    if (sketch->size < sketch->capacity) {
+        sketch_insert(sketch, pos, key, len, hash, value, 0);
+        return;
+    }
+
+    // Вытеснение минимального счетчика: новый ключ наследует его значение как погрешность
+    const guint32 min_index = sketch->heap[0];
+    SketchCounter* min = &sketch->counters[min_index];
+    table_remove(sketch, table_find(sketch, min->key, min->len, min->hash));
+    g_free(min->key);
+
+    min->key = g_strndup(key, len);
+    min->len = len;
+    min->hash = hash;
+    min->error = min->value;
+    min->value += value;
+    sketch->table[table_find(sketch, key, len, hash)] = min_index;
+    heap_down(sketch, 0);
+}
+
+static gint64 sketch_min(TopNSketch* sketch) {
+    // Пока сводка не заполнена, отсутствующие ключи точно не встречались
+    if (sketch->size < sketch->capacity)
+        return 0;
+    return heap_value(sketch, 0);
+}
+
+static int counter_compare(const void* a, const void* b) {
+    const SketchCounter* ca = (const SketchCounter*)a;
+    const SketchCounter* cb = (const SketchCounter*)b;
+    if (ca->value != cb->value)
+        return ca->value < cb->value ? 1 : -1;
+    return 0;
+}
+
+void sketch_merge(TopNSketch* dst, TopNSketch* src) {
+    const gint64 dst_min = sketch_min(dst);
+    const gint64 src_min = sketch_min(src);
+    const size_t max = dst->size + src->size;
+    SketchCounter* merged = (SketchCounter*)malloc(sizeof(SketchCounter) * (max ? max : 1));
+    size_t count = 0;
+
+    for (size_t i = 0; i < dst->size; ++i) {
+        SketchCounter counter = dst->counters[i];
+        const guint32 other = src->table[table_find(src, counter.key, counter.len, counter.hash)];
+        if (other != NO_COUNTER) {
+            counter.value += src->counters[other].value;
+            counter.error += src->counters[other].error;
+        } else {
+            counter.value += src_min;
+            counter.error += src_min;
+        }
+        merged[count++] = counter;
+    }
+
+    for (size_t i = 0; i < src->size; ++i) {
+        const SketchCounter* counter = &src->counters[i];
+        if (dst->table[table_find(dst, counter->key, counter->len, counter->hash)] != NO_COUNTER)
+            continue;
+        merged[count] = *counter;
+        merged[count].key = g_strndup(counter->key, counter->len);
+        merged[count].value += dst_min;
+        merged[count].error += dst_min;
+        count++;
+    }
+
+    qsort(merged, count, sizeof(SketchCounter), counter_compare);
+
+    for (size_t i = dst->capacity; i < count; ++i)
+        g_free(merged[i].key);
+    if (count > dst->capacity)
+        count = dst->capacity;
+
+    // Пересборка dst из лучших capacity счетчиков
+    memset(dst->table, 0xff, sizeof(guint32) * (dst->table_mask + 1));
+    dst->size = 0;
+    dst->total += src->total;
+    for (size_t i = 0; i < count; ++i) {
+        const size_t pos = table_find(dst, merged[i].key, merged[i].len, merged[i].hash);
+        const size_t index = dst->size++;
+        dst->counters[index] = merged[i];
+        dst->counters[index].heap_pos = index;
+        dst->heap[index] = index;
+        dst->table[pos] = index;
+    }
+    for (size_t j = dst->size / 2; j-- > 0;)
+        heap_down(dst, j);
+
+    free(merged);
+}
+
+size_t sketch_size(TopNSketch* sketch) {
+    return sketch->size;
+}
+
+const gchar* sketch_counter(TopNSketch* sketch, size_t index, gint64* value, gint64* error) {
+    const SketchCounter* counter = &sketch->counters[index];
+    *value = counter->value;
+    *error = counter->error;
+    return counter->key;
+}
+
+gint64 sketch_total(TopNSketch* sketch) {
+    return sketch->total;
+}
+
+gint64 sketch_error_bound(TopNSketch* sketch) {
+    // Минимальный счетчик заполненной сводки не больше total / capacity
+    return sketch_min(sketch);
+}
+
+int sketch_save(TopNSketch* sketch, FILE* file) {
+    if (write_i64(file, sketch->total) != 0 || write_u64(file, sketch->size) != 0)
+        return -1;
+    for (size_t i = 0; i < sketch->size; ++i) {
+        const SketchCounter* counter = &sketch->counters[i];
+        if (write_str(file, counter->key, counter->len) != 0 ||
+            write_i64(file, counter->value) != 0 ||
+            write_i64(file, counter->error) != 0)
+            return -1;
+    }
+    return 0;
+}
+
+int sketch_load(TopNSketch* sketch, FILE* file) {
+    gint64 total;
+    guint64 count;
+    if (read_i64(file, &total) != 0 || read_u64(file, &count) != 0)
+        return -1;
+    if (sketch->size != 0 || count > sketch->capacity)
+        return -1;
+
+    gchar* key = NULL;
+    size_t cap = 0, len;
+    int result = 0;
+    for (guint64 i = 0; i < count; ++i) {
+        gint64 value, error;
+        if (read_str(file, &key, &cap, &len) != 0 ||
+            read_i64(file, &value) != 0 || read_i64(file, &error) != 0) {
+            result = -1;
+            break;
+        }
+        const guint64 hash = fnv1a64(key, len);
+        const size_t pos = table_find(sketch, key, len, hash);
+        if (sketch->table[pos] != NO_COUNTER) {
+            result = -1;
+            break;
+        }
+        sketch_insert(sketch, pos, key, len, hash, value, error);
+    }
+    g_free(key);
+
+    sketch->total = total;
+    return result;
+}
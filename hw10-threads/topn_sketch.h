@@ -0,0 +1,40 @@
+#pragma once
+
+#include <glib.h>
+#include <stdio.h>
+
+// Приближенный подсчет тяжелых элементов алгоритмом Space-Saving
+// с весами. Хранит не более counters ключей, значение каждого ключа
+// завышено не более чем на error, а error не превышает total / counters.
+// Не потокобезопасен
+typedef struct TopNSketch TopNSketch;
+
+TopNSketch* sketch_init(size_t counters);
+
+void sketch_free(TopNSketch* sketch);
+
+void sketch_add(TopNSketch* sketch, const gchar* key, size_t len, gint64 value);
+
+// Объединение двух сводок с сохранением гарантий точности (Cafaro et al.):
+// ключ, отсутствующий в одной из сводок, получает ее минимальный счетчик
+// и как оценку, и как погрешность
+void sketch_merge(TopNSketch* dst, TopNSketch* src);
+
+// Количество отслеживаемых ключей
+size_t sketch_size(TopNSketch* sketch);
+
+// Ключ, оценка и погрешность счетчика index < sketch_size()
+const gchar* sketch_counter(TopNSketch* sketch, size_t index, gint64* value, gint64* error);
+
+// Сумма всех добавленных значений
+gint64 sketch_total(TopNSketch* sketch);
+
+// Верхняя граница погрешности для любого ключа
+gint64 sketch_error_bound(TopNSketch* sketch);
+
+// Запись сводки в file, возвращает 0 при успехе
+int sketch_save(TopNSketch* sketch, FILE* file);
+
+// Чтение сводки, записанной sketch_save, в пустую сводку.
+// Возвращает -1 при ошибке или если счетчиков больше, чем помещается
+int sketch_load(TopNSketch* sketch, FILE* file);
@@ -0,0 +1,140 @@
+#define _GNU_SOURCE
+
+#include "access_log.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+
+// Самая длинная строка: строка запроса, Referer и User-Agent вместе
+// не длиннее буфера запроса, экранирование удлиняет байт до четырех
+#define ACCESS_LINE_MAX (4 * BUF_SZ + 256)
+
+int access_log_open(access_log_t *log, const char *path) {
+    log->fd = -1;
+    log->buf = NULL;
+    log->len = 0;
+    log->date_sec = 0;
+    if (path == NULL) {
+        return 0;
+    }
+
+    log->buf = malloc(ACCESS_LOG_BUF);
+    if (log->buf == NULL) {
+        fprintf(stderr, "Out of memory for access log\n");
+        return -1;
+    }
+    log->fd = open(path, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if (log->fd < 0) {
+        perror(path);
+        free(log->buf);
+        log->buf = NULL;
+        return -1;
+    }
+    return 0;
+}
+
+// Время в формате [10/Oct/2000:13:55:36 -0700], CLOCK_REALTIME_COARSE без системного вызова
+static const char *log_date(access_log_t *log) {
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME_COARSE, &ts);
+    if (ts.tv_sec != log->date_sec) {
+        struct tm tm;
+        localtime_r(&ts.tv_sec, &tm);
+        strftime(log->date, sizeof(log->date), "%d/%b/%Y:%H:%M:%S %z", &tm);
+        log->date_sec = ts.tv_sec;
+    }
+    return log->date;
+}
+
+static void put(access_log_t *log, const char *str) {
+    const size_t len = strlen(str);
+    memcpy(log->buf + log->len, str, len);
+    log->len += len;
+}
+
+// Кавычки, обратная косая черта и управляющие байты из запроса записываются как \xHH
+static void put_escaped(access_log_t *log, const char *str, size_t len) {
+    static const char hex[] = "0123456789ABCDEF";
+    for (size_t i = 0; i < len; i++) {
+        const unsigned char c = str[i];
+        if (c < 0x20 || c >= 0x7f || c == '"' || c == '\\') {
+            log->buf[log->len++] = '\\';
+            log->buf[log->len++] = 'x';
+            log->buf[log->len++] = hex[c >> 4];
+            log->buf[log->len++] = hex[c & 0xf];
+        } else {
+            log->buf[log->len++] = c;
+        }
+    }
+}
+
+static void put_header(access_log_t *log, const conn_t *conn, const char *name) {
+    const slice_t *value = conn->parser.length != 0 ? http_header(&conn->parser, name) : NULL;
+    put(log, "\"");
+    if (value != NULL) {
+        put_escaped(log, value->ptr, value->len);
+    } else {
+        put(log, "-");
+    }
+    put(log, "\"");
+}
+
+// host - - [date] "request" status bytes "referer" "user-agent".
+// Для запроса, который не удалось разобрать, вместо строки запроса "-"
+void access_log_write(access_log_t *log, const conn_t *conn) {
+    if (log->fd < 0) {
+        return;
+    }
+    if (ACCESS_LOG_BUF - log->len < ACCESS_LINE_MAX) {
+        access_log_flush(log);
+    }
+
+    char addr[INET_ADDRSTRLEN];
+    inet_ntop(AF_INET, &conn->peer_addr, addr, sizeof(addr));
+    log->len += snprintf(log->buf + log->len, ACCESS_LOG_BUF - log->len, "%s - - [%s] \"", addr, log_date(log));
+
+    const http_parser_t *parser = &conn->parser;
+    if (parser->length != 0) {
+        put(log, parser->method == HTTP_HEAD ? "HEAD " : "GET ");
+        // Путь вместе со строкой запроса, как его прислал клиент
+        const char *target_end = parser->query.ptr + parser->query.len;
+        put_escaped(log, parser->path.ptr, target_end - parser->path.ptr);
+        log->len += snprintf(log->buf + log->len, ACCESS_LOG_BUF - log->len, " HTTP/1.%d",
+                             parser->minor_version);
+    } else {
+        put(log, "-");
+    }
+
+    if (conn->body_size != 0) {
+        log->len += snprintf(log->buf + log->len, ACCESS_LOG_BUF - log->len, "\" %d %lld ", conn->status,
+                             (long long)conn->body_size);
+    } else {
+        log->len += snprintf(log->buf + log->len, ACCESS_LOG_BUF - log->len, "\" %d - ", conn->status);
+    }
+    put_header(log, conn, "Referer");
+    put(log, " ");
+    put_header(log, conn, "User-Agent");
+    put(log, "\n");
+}
+
+void access_log_flush(access_log_t *log) {
+    size_t done = 0;
+    while (done < log->len) {
+        ssize_t res = write(log->fd, log->buf + done, log->len - done);
+        if (res < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            // Строки при ошибке записи теряются, буфер не растет бесконечно
+            perror("access log");
+            break;
+        }
+        done += res;
+    }
+    log->len = 0;
+}
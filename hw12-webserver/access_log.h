@@ -0,0 +1,32 @@
+#pragma once
+
+#include <stddef.h>
+#include <time.h>
+
+#include "conn.h"
+
+// Буфер журнала рабочего потока
+#define ACCESS_LOG_BUF (64 * 1024)
+
+// Журнал запросов в Combined Log Format. Строки копятся в буфере потока
+// и пишутся в файл одним write, когда буфер заполнен или по таймеру раз
+// в секунду, поэтому на запрос системных вызовов не добавляется. Каждый
+// поток открывает файл с O_APPEND: записи потоков из целых строк не смешиваются
+typedef struct {
+    int    fd;
+    char  *buf;
+    size_t len;
+    // Дата последней строки, форматируется не чаще раза в секунду
+    time_t date_sec;
+    char   date[32];
+} access_log_t;
+
+// Открытие журнала path на дозапись. Без path журнал выключен.
+// Возвращает -1 при ошибке
+int access_log_open(access_log_t *log, const char *path);
+
+// Строка для отправленного ответа conn. Запрос в буфере соединения еще не удален
+void access_log_write(access_log_t *log, const conn_t *conn);
+
+// Запись накопленных строк в файл
+void access_log_flush(access_log_t *log);
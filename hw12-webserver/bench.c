@@ -0,0 +1,563 @@
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+
+// Нагрузочный тест сервера: потоки держат N соединений (с keep-alive
+// или новое соединение на каждый запрос), запросы идут по кругу по списку
+// URL из аргументов или файла. Каждое соединение ждет ответа перед
+// следующим запросом. Задержка запроса - от начала соединения или отправки
+// запроса до последнего байта ответа, копится в гистограмме с точностью
+// около 3%. Итог выводится JSON-строкой, с -v еще и распределение задержек
+
+#define DEFAULT_CONNS 64
+#define DEFAULT_THREADS 1
+#define DEFAULT_SECONDS 10
+#define EVENTS_MAX 256
+#define REQ_SZ 1024
+#define HEADERS_SZ 8192
+#define READ_SZ 65536
+#define MAX_URL_LEN 900
+
+// Гистограмма задержек в микросекундах: первые HIST_LINEAR значений точно,
+// дальше по HIST_LINEAR / 2 интервалов на каждую степень двойки
+#define HIST_LINEAR 64
+#define HIST_SIZE 1024
+
+typedef struct {
+    uint64_t counts[HIST_SIZE];
+    uint64_t total;
+    uint64_t max;
+} histogram_t;
+
+typedef enum {
+    BENCH_CONNECTING = 0,
+    BENCH_SENDING,
+    BENCH_HEADERS,
+    BENCH_BODY
+} bench_state_t;
+
+typedef struct {
+    int           sock;
+    bench_state_t state;
+    size_t        url;
+    uint64_t      start_us;
+    char          req[REQ_SZ];
+    size_t        req_len;
+    size_t        req_sent;
+    char          headers[HEADERS_SZ];
+    size_t        headers_len;
+    int           status;
+    long long     body_left;  // -1: до закрытия соединения
+    int           close_after;
+} bench_conn_t;
+
+typedef struct {
+    int           id;
+    size_t        conn_count;
+    pthread_t     thread;
+    histogram_t   hist;
+    uint64_t      requests;
+    uint64_t      bytes;
+    uint64_t      errors;
+    uint64_t      status[6];
+} bench_thread_t;
+
+static struct sockaddr_in server_addr;
+static const char *host = "127.0.0.1";
+static char **urls;
+static size_t url_count;
+static int keep_alive = 0;
+static int compressed = 0;
+static uint64_t deadline_us;
+
+static uint64_t now_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static size_t hist_index(uint64_t value) {
+    if (value < HIST_LINEAR) {
+        return value;
+    }
+    // value >> shift попадает в [HIST_LINEAR / 2, HIST_LINEAR)
+    const int shift = 63 - __builtin_clzll(value) - 5;
+    const size_t index = (size_t)shift * (HIST_LINEAR / 2) + (value >> shift);
+    return index < HIST_SIZE ? index : HIST_SIZE - 1;
+}
+
+// Верхняя граница значений интервала index
+static uint64_t hist_value(size_t index) {
+    if (index < HIST_LINEAR) {
+        return index;
+    }
+    const int shift = index / (HIST_LINEAR / 2) - 1;
+    const uint64_t sub = index % (HIST_LINEAR / 2) + HIST_LINEAR / 2;
+    return ((sub + 1) << shift) - 1;
+}
+
+static void hist_add(histogram_t *hist, uint64_t value) {
+    hist->counts[hist_index(value)]++;
+    hist->total++;
+    if (value > hist->max) {
+        hist->max = value;
+    }
+}
+
+static void hist_merge(histogram_t *dst, const histogram_t *src) {
+    for (size_t i = 0; i < HIST_SIZE; i++) {
+        dst->counts[i] += src->counts[i];
+    }
+    dst->total += src->total;
+    if (src->max > dst->max) {
+        dst->max = src->max;
+    }
+}
+
+static uint64_t hist_percentile(const histogram_t *hist, double percentile) {
+    if (hist->total == 0) {
+        return 0;
+    }
+    uint64_t rank = (uint64_t)(hist->total * percentile / 100.0 + 0.5);
+    if (rank == 0) {
+        rank = 1;
+    }
+    uint64_t seen = 0;
+    for (size_t i = 0; i < HIST_SIZE; i++) {
+        seen += hist->counts[i];
+        if (seen >= rank) {
+            const uint64_t value = hist_value(i);
+            return value < hist->max ? value : hist->max;
+        }
+    }
+    return hist->max;
+}
+
+static void set_request(bench_conn_t *conn) {
+    const char *url = urls[conn->url];
+    conn->url = (conn->url + 1) % url_count;
+    conn->req_len = snprintf(conn->req, REQ_SZ, "GET %s HTTP/1.1\r\nHost: %s\r\n%s%s\r\n", url, host,
+                             keep_alive ? "" : "Connection: close\r\n",
+                             compressed ? "Accept-Encoding: gzip, br\r\n" : "");
+    conn->req_sent = 0;
+    conn->headers_len = 0;
+    conn->state = BENCH_SENDING;
+}
+
+static int open_conn(int epoll, bench_conn_t *conn) {
+    conn->sock = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (conn->sock < 0) {
+        perror("socket");
+        return -1;
+    }
+    int one = 1;
+    setsockopt(conn->sock, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    conn->start_us = now_us();
+    conn->state = BENCH_CONNECTING;
+    if (connect(conn->sock, (struct sockaddr*)&server_addr, sizeof(server_addr)) < 0 && errno != EINPROGRESS) {
+        close(conn->sock);
+        conn->sock = -1;
+        return -1;
+    }
+
+    struct epoll_event ev;
+    ev.events = EPOLLIN | EPOLLOUT | EPOLLET | EPOLLRDHUP;
+    ev.data.ptr = conn;
+    if (epoll_ctl(epoll, EPOLL_CTL_ADD, conn->sock, &ev) < 0) {
+        perror("epoll_ctl");
+        close(conn->sock);
+        conn->sock = -1;
+        return -1;
+    }
+    return 0;
+}
+
+static void close_conn(bench_conn_t *conn) {
+    if (conn->sock >= 0) {
+        close(conn->sock);
+        conn->sock = -1;
+    }
+}
+
+// Заголовки ответа: код, длина тела и закрытие соединения сервером
+static int parse_headers(bench_conn_t *conn, size_t end) {
+    conn->headers[end] = '\0';
+    if (sscanf(conn->headers, "HTTP/1.%*d %d", &conn->status) != 1) {
+        return -1;
+    }
+    conn->body_left = -1;
+    conn->close_after = !keep_alive;
+    for (char *line = strstr(conn->headers, "\r\n"); line != NULL && line + 2 < conn->headers + end;
+         line = strstr(line + 2, "\r\n")) {
+        const char *name = line + 2;
+        if (strncasecmp(name, "Content-Length:", 15) == 0) {
+            conn->body_left = strtoll(name + 15, NULL, 10);
+        } else if (strncasecmp(name, "Connection:", 11) == 0 && strncasecmp(name + 11, " close", 6) == 0) {
+            conn->close_after = 1;
+        }
+    }
+    if (conn->status == 304 || conn->status == 204 || conn->status < 200) {
+        conn->body_left = 0;
+    }
+    if (conn->body_left < 0) {
+        conn->close_after = 1;
+    }
+    return 0;
+}
+
+static void finish_request(bench_thread_t *thread, bench_conn_t *conn) {
+    const uint64_t now = now_us();
+    if (now < deadline_us) {
+        hist_add(&thread->hist, now - conn->start_us);
+        thread->requests++;
+        thread->status[conn->status / 100 < 6 ? conn->status / 100 : 0]++;
+    }
+}
+
+// Продвижение соединения, пока операции не упрутся в EAGAIN.
+// Возвращает 0 в ожидании событий, 1, если соединение закрывается после
+// ответа, -1 при ошибке. В обоих последних случаях его нужно открыть заново
+static int drive_conn(bench_thread_t *thread, bench_conn_t *conn) {
+    char buf[READ_SZ];
+    for (;;) {
+        switch (conn->state) {
+        case BENCH_CONNECTING: {
+            int err = 0;
+            socklen_t len = sizeof(err);
+            getsockopt(conn->sock, SOL_SOCKET, SO_ERROR, &err, &len);
+            if (err == EINPROGRESS || err == EALREADY) {
+                return 0;
+            }
+            if (err != 0) {
+                return -1;
+            }
+            const uint64_t start = conn->start_us;
+            set_request(conn);
+            conn->start_us = start;
+            break;
+        }
+
+        case BENCH_SENDING: {
+            ssize_t res = send(conn->sock, conn->req + conn->req_sent, conn->req_len - conn->req_sent, MSG_NOSIGNAL);
+            if (res < 0) {
+                if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                    return 0;
+                }
+                // Соединение еще не установлено
+                if (errno == ENOTCONN) {
+                    conn->state = BENCH_CONNECTING;
+                    return 0;
+                }
+                return -1;
+            }
+            conn->req_sent += res;
+            if (conn->req_sent == conn->req_len) {
+                conn->state = BENCH_HEADERS;
+            }
+            break;
+        }
+
+        case BENCH_HEADERS:
+        case BENCH_BODY: {
+            ssize_t res = recv(conn->sock, buf, sizeof(buf), 0);
+            if (res < 0) {
+                return errno == EAGAIN || errno == EWOULDBLOCK ? 0 : -1;
+            }
+            if (res == 0) {
+                if (conn->state == BENCH_BODY && conn->body_left < 0) {
+                    finish_request(thread, conn);
+                    return 1;
+                }
+                return -1;
+            }
+            thread->bytes += res;
+
+            size_t used = 0;
+            if (conn->state == BENCH_HEADERS) {
+                used = HEADERS_SZ - 1 - conn->headers_len;
+                used = (size_t)res < used ? (size_t)res : used;
+                memcpy(conn->headers + conn->headers_len, buf, used);
+                const size_t old_len = conn->headers_len;
+                conn->headers_len += used;
+                conn->headers[conn->headers_len] = '\0';
+                const char *end = strstr(conn->headers, "\r\n\r\n");
+                if (end == NULL) {
+                    if (conn->headers_len == HEADERS_SZ - 1) {
+                        return -1;
+                    }
+                    break;
+                }
+                const size_t headers_end = end - conn->headers + 4;
+                if (parse_headers(conn, headers_end) < 0) {
+                    return -1;
+                }
+                used = headers_end - old_len;
+                conn->state = BENCH_BODY;
+            }
+
+            if (conn->body_left >= 0) {
+                conn->body_left -= res - used;
+                if (conn->body_left < 0) {
+                    // Ответ без запроса: данных больше, чем заявлено
+                    return -1;
+                }
+                if (conn->body_left == 0) {
+                    finish_request(thread, conn);
+                    if (conn->close_after) {
+                        return 1;
+                    }
+                    set_request(conn);
+                    conn->start_us = now_us();
+                }
+            }
+            break;
+        }
+        }
+    }
+}
+
+static int step_conn(bench_thread_t *thread, bench_conn_t *conn) {
+    int res = drive_conn(thread, conn);
+    if (res != 0) {
+        // 1 - сервер закрывает соединение после ответа, -1 - ошибка
+        thread->errors += res < 0;
+        close_conn(conn);
+    }
+    return res;
+}
+
+static void *thread_run(void *arg) {
+    bench_thread_t *thread = arg;
+    int epoll = epoll_create1(EPOLL_CLOEXEC);
+    if (epoll < 0) {
+        perror("epoll_create1");
+        return NULL;
+    }
+
+    bench_conn_t *conns = calloc(thread->conn_count, sizeof(bench_conn_t));
+    for (size_t i = 0; i < thread->conn_count; i++) {
+        // Соединения начинают с разных URL, чтобы смесь была равномерной
+        conns[i].url = (thread->id * thread->conn_count + i) % url_count;
+        if (open_conn(epoll, &conns[i]) < 0) {
+            thread->errors++;
+        }
+    }
+
+    struct epoll_event events[EVENTS_MAX];
+    while (now_us() < deadline_us) {
+        int count = epoll_wait(epoll, events, EVENTS_MAX, 100);
+        if (count < 0 && errno != EINTR) {
+            perror("epoll_wait");
+            break;
+        }
+        for (int i = 0; i < count; i++) {
+            step_conn(thread, events[i].data.ptr);
+        }
+        // Закрытые соединения открываются заново. Ответ может прийти
+        // сразу, тогда соединение открывается еще раз, не дожидаясь epoll_wait
+        for (size_t i = 0; i < thread->conn_count; i++) {
+            while (conns[i].sock < 0 && now_us() < deadline_us) {
+                if (open_conn(epoll, &conns[i]) < 0) {
+                    thread->errors++;
+                    break;
+                }
+                if (step_conn(thread, &conns[i]) < 0) {
+                    break;
+                }
+            }
+        }
+    }
+
+    for (size_t i = 0; i < thread->conn_count; i++) {
+        close_conn(&conns[i]);
+    }
+    free(conns);
+    close(epoll);
+    return NULL;
+}
+
+// URL по одному в строке, пустые строки и строки с # пропускаются.
+// Повтор URL в файле увеличивает его долю в смеси
+static int load_urls(const char *path) {
+    FILE *file = fopen(path, "r");
+    if (file == NULL) {
+        perror(path);
+        return -1;
+    }
+    char line[MAX_URL_LEN + 2];
+    while (fgets(line, sizeof(line), file) != NULL) {
+        line[strcspn(line, "\r\n")] = '\0';
+        if (line[0] == '\0' || line[0] == '#') {
+            continue;
+        }
+        urls = realloc(urls, sizeof(char*) * (url_count + 1));
+        urls[url_count++] = strdup(line);
+    }
+    fclose(file);
+    return 0;
+}
+
+static void print_histogram(const histogram_t *hist) {
+    static const double percentiles[] = { 50, 75, 90, 99, 99.9, 99.99, 100 };
+    fprintf(stderr, "Latency distribution (us):\n");
+    for (size_t i = 0; i < sizeof(percentiles) / sizeof(percentiles[0]); i++) {
+        fprintf(stderr, "  p%-6g %10lu\n", percentiles[i], (unsigned long)hist_percentile(hist, percentiles[i]));
+    }
+}
+
+static void usage(const char *name) {
+    fprintf(stderr,
+            "Usage: %s [-c connections] [-t threads] [-d seconds] [-k] [-z] [-f url_file] [-v] "
+            "[addr] [port] [url...]\n"
+            "  -c  concurrent connections, %d by default\n"
+            "  -t  client threads, %d by default\n"
+            "  -d  test duration in seconds, %d by default\n"
+            "  -k  keep-alive, otherwise a new connection per request\n"
+            "  -z  send Accept-Encoding: gzip, br\n"
+            "  -f  file with URLs, one per line\n"
+            "  -v  print latency distribution\n",
+            name, DEFAULT_CONNS, DEFAULT_THREADS, DEFAULT_SECONDS);
+}
+
+int main(int argc, char *argv[]) {
+    size_t conn_count = DEFAULT_CONNS;
+    size_t thread_count = DEFAULT_THREADS;
+    long seconds = DEFAULT_SECONDS;
+    int verbose = 0;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "c:t:d:kzf:v")) != -1) {
+        switch (opt) {
+        case 'c':
+            conn_count = strtoul(optarg, NULL, 10);
+            break;
+        case 't':
+            thread_count = strtoul(optarg, NULL, 10);
+            break;
+        case 'd':
+            seconds = strtol(optarg, NULL, 10);
+            break;
+        case 'k':
+            keep_alive = 1;
+            break;
+        case 'z':
+            compressed = 1;
+            break;
+        case 'f':
+            if (load_urls(optarg) < 0) {
+                return EXIT_FAILURE;
+            }
+            break;
+        case 'v':
+            verbose = 1;
+            break;
+        default:
+            usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    int port = 30020;
+    if (optind < argc) {
+        host = argv[optind++];
+    }
+    if (optind < argc) {
+        port = atoi(argv[optind++]);
+    }
+    for (; optind < argc; optind++) {
+        urls = realloc(urls, sizeof(char*) * (url_count + 1));
+        urls[url_count++] = strdup(argv[optind]);
+    }
+    if (url_count == 0) {
+        urls = malloc(sizeof(char*));
+        urls[url_count++] = strdup("/");
+    }
+    for (size_t i = 0; i < url_count; i++) {
+        if (urls[i][0] != '/' || strlen(urls[i]) > MAX_URL_LEN) {
+            fprintf(stderr, "Invalid URL: %s\n", urls[i]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    if (conn_count == 0 || thread_count == 0 || seconds <= 0 || port <= 0) {
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+    if (thread_count > conn_count) {
+        thread_count = conn_count;
+    }
+
+    server_addr.sin_family = AF_INET;
+    server_addr.sin_port = htons(port);
+    if (inet_pton(AF_INET, host, &server_addr.sin_addr) != 1) {
+        fprintf(stderr, "Invalid address: %s\n", host);
+        return EXIT_FAILURE;
+    }
+
+    struct rlimit limit;
+    if (getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur < limit.rlim_max) {
+        limit.rlim_cur = limit.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &limit);
+    }
+
+    const uint64_t start = now_us();
+    deadline_us = start + (uint64_t)seconds * 1000000;
+    bench_thread_t *threads = calloc(thread_count, sizeof(bench_thread_t));
+    for (size_t i = 0; i < thread_count; i++) {
+        threads[i].id = i;
+        threads[i].conn_count = conn_count / thread_count + (i < conn_count % thread_count);
+        int err = pthread_create(&threads[i].thread, NULL, thread_run, &threads[i]);
+        if (err != 0) {
+            fprintf(stderr, "Error creating thread %zu: %s\n", i, strerror(err));
+            return EXIT_FAILURE;
+        }
+    }
+
+    histogram_t hist = { { 0 }, 0, 0 };
+    uint64_t requests = 0, bytes = 0, errors = 0, status[6] = { 0 };
+    for (size_t i = 0; i < thread_count; i++) {
+        pthread_join(threads[i].thread, NULL);
+        hist_merge(&hist, &threads[i].hist);
+        requests += threads[i].requests;
+        bytes += threads[i].bytes;
+        errors += threads[i].errors;
+        for (int j = 0; j < 6; j++) {
+            status[j] += threads[i].status[j];
+        }
+    }
+    const double elapsed = (deadline_us - start) / 1e6;
+
+    printf("{\"connections\":%zu,\"threads\":%zu,\"keep_alive\":%s,\"urls\":%zu,\"seconds\":%.3f,"
+           "\"requests\":%lu,\"req_per_sec\":%.0f,\"mb_per_sec\":%.1f,\"errors\":%lu,"
+           "\"status_2xx\":%lu,\"status_3xx\":%lu,\"status_4xx\":%lu,\"status_5xx\":%lu,"
+           "\"p50_us\":%lu,\"p99_us\":%lu,\"p999_us\":%lu,\"max_us\":%lu}\n",
+           conn_count, thread_count, keep_alive ? "true" : "false", url_count, elapsed,
+           (unsigned long)requests, requests / elapsed, bytes / elapsed / (1 << 20), (unsigned long)errors,
+           (unsigned long)status[2], (unsigned long)status[3], (unsigned long)status[4], (unsigned long)status[5],
+           (unsigned long)hist_percentile(&hist, 50), (unsigned long)hist_percentile(&hist, 99),
+           (unsigned long)hist_percentile(&hist, 99.9), (unsigned long)hist.max);
+    if (verbose) {
+        print_histogram(&hist);
+    }
+
+    for (size_t i = 0; i < url_count; i++) {
+        free(urls[i]);
+    }
+    free(urls);
+    free(threads);
+    return 0;
+}
@@ -0,0 +1,67 @@
+#include "compress.h"
+
+#include <stdlib.h>
+#include <zlib.h>
+
+#ifdef HAVE_BROTLI
+#include <brotli/encode.h>
+#endif
+
+// Сжатие идет в рабочем потоке при промахе кеша и задерживает все его
+// соединения, поэтому уровни средние: gzip 6 и brotli 5 сжимают текст
+// почти как максимальные, но в несколько раз быстрее
+#define GZIP_LEVEL 6
+#define BROTLI_QUALITY 5
+
+int compress_gzip(const char *data, size_t size, char **out, size_t *out_size) {
+    z_stream stream = { 0 };
+    // 16 к размеру окна - формат gzip вместо zlib
+    if (deflateInit2(&stream, GZIP_LEVEL, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+        return -1;
+    }
+
+    const size_t bound = deflateBound(&stream, size);
+    char *buf = malloc(bound);
+    if (buf == NULL) {
+        deflateEnd(&stream);
+        return -1;
+    }
+    stream.next_in = (Bytef*)data;
+    stream.avail_in = size;
+    stream.next_out = (Bytef*)buf;
+    stream.avail_out = bound;
+    if (deflate(&stream, Z_FINISH) != Z_STREAM_END) {
+        deflateEnd(&stream);
+        free(buf);
+        return -1;
+    }
+
+    *out = buf;
+    *out_size = stream.total_out;
+    deflateEnd(&stream);
+    return 0;
+}
+
+int compress_brotli(const char *data, size_t size, char **out, size_t *out_size) {
+#ifdef HAVE_BROTLI
+    size_t bound = BrotliEncoderMaxCompressedSize(size);
+    char *buf = bound ? malloc(bound) : NULL;
+    if (buf == NULL) {
+        return -1;
+    }
+    if (!BrotliEncoderCompress(BROTLI_QUALITY, BROTLI_DEFAULT_WINDOW, BROTLI_MODE_TEXT, size,
+                               (const uint8_t*)data, &bound, (uint8_t*)buf)) {
+        free(buf);
+        return -1;
+    }
+    *out = buf;
+    *out_size = bound;
+    return 0;
+#else
+    (void)data;
+    (void)size;
+    (void)out;
+    (void)out_size;
+    return -1;
+#endif
+}
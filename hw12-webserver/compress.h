@@ -0,0 +1,9 @@
+#pragma once
+
+#include <stddef.h>
+
+// Сжатие size байт data в новый буфер *out длины *out_size.
+// Возвращает 0 при успехе, -1 при ошибке или без поддержки формата
+int compress_gzip(const char *data, size_t size, char **out, size_t *out_size);
+
+int compress_brotli(const char *data, size_t size, char **out, size_t *out_size);
@@ -0,0 +1,157 @@
+#include "conn.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define CONN_NONE UINT32_MAX
+
+void conn_pool_init(conn_pool_t *pool) {
+    memset(pool, 0, sizeof(*pool));
+    pool->free_head = CONN_NONE;
+}
+
+void conn_pool_free(conn_pool_t *pool) {
+    for (size_t i = 0; i < pool->slab_count; i++) {
+        free(pool->slabs[i]);
+    }
+    free(pool->slabs);
+    conn_pool_init(pool);
+}
+
+static conn_t *conn_at(conn_pool_t *pool, uint32_t index) {
+    return &pool->slabs[index / CONN_SLAB][index % CONN_SLAB];
+}
+
+// Новый блок, все его элементы попадают в список свободных
+static int conn_pool_grow(conn_pool_t *pool) {
+    if ((pool->slab_count + 1) * CONN_SLAB >= CONN_NONE) {
+        return -1;
+    }
+    conn_t **slabs = realloc(pool->slabs, sizeof(conn_t*) * (pool->slab_count + 1));
+    if (slabs == NULL) {
+        return -1;
+    }
+    pool->slabs = slabs;
+
+    conn_t *slab = malloc(sizeof(conn_t) * CONN_SLAB);
+    if (slab == NULL) {
+        return -1;
+    }
+    pool->slabs[pool->slab_count] = slab;
+
+    const uint32_t base = pool->slab_count * CONN_SLAB;
+    for (uint32_t i = CONN_SLAB; i-- > 0;) {
+        slab[i].sock = -1;
+        slab[i].index = base + i;
+        slab[i].gen = 0;
+        slab[i].next_free = pool->free_head;
+        pool->free_head = base + i;
+    }
+    pool->slab_count++;
+    return 0;
+}
+
+static void idle_unlink(conn_pool_t *pool, conn_t *conn) {
+    if (conn->idle_prev) {
+        conn->idle_prev->idle_next = conn->idle_next;
+    } else {
+        pool->idle_head = conn->idle_next;
+    }
+    if (conn->idle_next) {
+        conn->idle_next->idle_prev = conn->idle_prev;
+    } else {
+        pool->idle_tail = conn->idle_prev;
+    }
+    conn->idle_prev = conn->idle_next = NULL;
+}
+
+static void idle_append(conn_pool_t *pool, conn_t *conn) {
+    conn->idle_prev = pool->idle_tail;
+    conn->idle_next = NULL;
+    if (pool->idle_tail) {
+        pool->idle_tail->idle_next = conn;
+    } else {
+        pool->idle_head = conn;
+    }
+    pool->idle_tail = conn;
+}
+
+conn_t *conn_alloc(conn_pool_t *pool, int sock, time_t now) {
+    if (pool->free_head == CONN_NONE && conn_pool_grow(pool) < 0) {
+        return NULL;
+    }
+
+    conn_t *conn = conn_at(pool, pool->free_head);
+    pool->free_head = conn->next_free;
+    pool->active++;
+
+    conn->sock = sock;
+    conn->peer_addr = 0;
+    conn->next_free = CONN_NONE;
+    conn->req_size = 0;
+    http_parser_init(&conn->parser);
+    conn->res_size = 0;
+    conn->res_sent = 0;
+    conn->file = NULL;
+    conn->body = NULL;
+    conn->body_buf = NULL;
+    conn->url_len = 0;
+    conn->url[0] = '\0';
+    conn->status = 0;
+    conn->body_size = 0;
+    conn->requests = 0;
+    conn->keep_alive = 0;
+    conn->last_active = now;
+    conn->uring_pending = 0;
+    conn->uring_state = 0;
+    conn->pipe[0] = conn->pipe[1] = -1;
+    conn->pipe_data = 0;
+    idle_append(pool, conn);
+    return conn;
+}
+
+void conn_release(conn_pool_t *pool, conn_t *conn) {
+    idle_unlink(pool, conn);
+    conn->sock = -1;
+    conn->gen++;
+    conn->next_free = pool->free_head;
+    pool->free_head = conn->index;
+    pool->active--;
+}
+
+void conn_touch(conn_pool_t *pool, conn_t *conn, time_t now) {
+    conn->last_active = now;
+    if (pool->idle_tail != conn) {
+        idle_unlink(pool, conn);
+        idle_append(pool, conn);
+    }
+}
+
+conn_t *conn_idle_oldest(conn_pool_t *pool) {
+    return pool->idle_head;
+}
+
+void conn_next_request(conn_t *conn, size_t len) {
+    conn->req_size -= len;
+    memmove(conn->req_buf, conn->req_buf + len, conn->req_size);
+    http_parser_init(&conn->parser);
+    conn->res_size = 0;
+    conn->res_sent = 0;
+    conn->url_len = 0;
+}
+
+uint64_t conn_handle(const conn_t *conn) {
+    return (uint64_t)conn->gen << 32 | conn->index;
+}
+
+conn_t *conn_lookup(conn_pool_t *pool, uint64_t handle) {
+    const uint32_t index = (uint32_t)handle;
+    if (index / CONN_SLAB >= pool->slab_count) {
+        return NULL;
+    }
+    conn_t *conn = conn_at(pool, index);
+    if (conn->sock < 0 || conn->gen != (uint32_t)(handle >> 32)) {
+        return NULL;
+    }
+    return conn;
+}
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+#include <time.h>
+
+#include "http_parser.h"
+
+#define BUF_SZ 2048
+#define STR_LEN 256
+// Соединений в одном блоке пула
+#define CONN_SLAB 256
+
+// Состояние одного соединения
+typedef struct conn_s {
+    int      sock;
+    // Адрес клиента для журнала, в сетевом порядке байт
+    uint32_t peer_addr;
+    uint32_t index;
+    uint32_t gen;
+    uint32_t next_free;
+    // Список соединений по времени последней активности
+    struct conn_s *idle_prev;
+    struct conn_s *idle_next;
+    time_t   last_active;
+    uint32_t requests;
+    int      keep_alive;
+    char     req_buf[BUF_SZ];
+    size_t   req_size;
+    http_parser_t parser;
+    // Ответ: заголовки (или весь ответ) в res_buf, тело из файла кеша
+    // с file_offset до file_end: из памяти body, если файл в ней, иначе
+    // из дескриптора. Тело, собранное для ответа (/__stats), отправляется
+    // так же через body, выделено в body_buf и освобождается с ответом.
+    // res_size != 0 - ответ еще отправляется
+    char     res_buf[BUF_SZ];
+    size_t   res_size;
+    size_t   res_sent;
+    struct file_entry_s *file;
+    const char *body;
+    char    *body_buf;
+    off_t    file_offset;
+    off_t    file_end;
+    char     url[STR_LEN];
+    size_t   url_len;
+    // Код ответа и размер тела для счетчиков и журнала
+    int      status;
+    off_t    body_size;
+    // Для io_uring: операций в полете, флаги состояния, канал для splice
+    // файла в сокет и байт, ожидающих в нем отправки
+    uint32_t uring_pending;
+    uint32_t uring_state;
+    int      pipe[2];
+    size_t   pipe_data;
+} conn_t;
+
+// Пул соединений: блоки по CONN_SLAB элементов, которые не перемещаются
+// и не освобождаются до conn_pool_free, свободные элементы в списке.
+// Количество соединений ограничено только памятью и лимитом дескрипторов
+typedef struct {
+    conn_t **slabs;
+    size_t   slab_count;
+    uint32_t free_head;
+    size_t   active;
+    conn_t  *idle_head;
+    conn_t  *idle_tail;
+} conn_pool_t;
+
+void conn_pool_init(conn_pool_t *pool);
+
+void conn_pool_free(conn_pool_t *pool);
+
+// Новое соединение для sock, активное в момент now. NULL при нехватке памяти
+conn_t *conn_alloc(conn_pool_t *pool, int sock, time_t now);
+
+// Возврат соединения в пул, его прежний handle перестает находиться
+void conn_release(conn_pool_t *pool, conn_t *conn);
+
+// Отметка активности: соединение переходит в конец списка простоя
+void conn_touch(conn_pool_t *pool, conn_t *conn, time_t now);
+
+// Соединение с самой давней активностью, NULL для пустого пула
+conn_t *conn_idle_oldest(conn_pool_t *pool);
+
+// Подготовка к следующему запросу: разобранный запрос длины len
+// удаляется из буфера, уже прочитанные следующие запросы сохраняются
+void conn_next_request(conn_t *conn, size_t len);
+
+// Идентификатор для epoll: номер в пуле и поколение элемента
+uint64_t conn_handle(const conn_t *conn);
+
+// Соединение по handle, NULL для уже закрытого соединения
+conn_t *conn_lookup(conn_pool_t *pool, uint64_t handle);
@@ -0,0 +1,456 @@
+#define _GNU_SOURCE
+
+#include "file_cache.h"
+#include "compress.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+
+#define WATCH_MASK (IN_MODIFY | IN_ATTRIB | IN_CLOSE_WRITE | IN_CREATE | IN_DELETE | \
+                    IN_MOVED_FROM | IN_MOVED_TO | IN_DELETE_SELF | IN_MOVE_SELF | IN_ONLYDIR)
+
+// Сжатые варианты хранятся, только если они меньше исходного хотя бы на 1/8
+#define MIN_SAVING 8
+
+typedef struct {
+    const char *ext;
+    const char *type;
+    int         compressible;
+} mime_type_t;
+
+// Прежде все файлы отдавались как text/html, для неизвестных расширений так и осталось
+static const mime_type_t default_type = { "", "text/html", 1 };
+
+static const mime_type_t mime_types[] = {
+    { "html", "text/html", 1 },
+    { "htm",  "text/html", 1 },
+    { "css",  "text/css", 1 },
+    { "js",   "application/javascript", 1 },
+    { "json", "application/json", 1 },
+    { "txt",  "text/plain", 1 },
+    { "xml",  "application/xml", 1 },
+    { "svg",  "image/svg+xml", 1 },
+    { "wasm", "application/wasm", 1 },
+    { "png",  "image/png", 0 },
+    { "jpg",  "image/jpeg", 0 },
+    { "jpeg", "image/jpeg", 0 },
+    { "gif",  "image/gif", 0 },
+    { "ico",  "image/x-icon", 1 },
+    { "webp", "image/webp", 0 },
+    { "woff2", "font/woff2", 0 },
+    { "pdf",  "application/pdf", 0 },
+};
+
+static const mime_type_t *mime_type(const char *path) {
+    const char *dot = strrchr(path, '.');
+    if (dot == NULL || strchr(dot, '/') != NULL) {
+        return &default_type;
+    }
+    for (size_t i = 0; i < sizeof(mime_types) / sizeof(mime_types[0]); i++) {
+        if (strcasecmp(dot + 1, mime_types[i].ext) == 0) {
+            return &mime_types[i];
+        }
+    }
+    return &default_type;
+}
+
+static size_t hash_path(const char *path) {
+    size_t hash = 14695981039346656037ull;
+    for (; *path; path++) {
+        hash = (hash ^ (unsigned char)*path) * 1099511628211ull;
+    }
+    return hash;
+}
+
+void file_cache_init(file_cache_t *cache, size_t capacity, size_t small_max, size_t memory_limit) {
+    memset(cache, 0, sizeof(*cache));
+    cache->inotify = -1;
+    if (capacity == 0) {
+        return;
+    }
+
+    cache->inotify = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (cache->inotify < 0) {
+        perror("inotify_init1, file cache disabled");
+        return;
+    }
+    cache->capacity = capacity;
+    cache->small_max = small_max;
+    cache->memory_limit = memory_limit;
+    cache->bucket_count = 16;
+    while (cache->bucket_count < capacity * 2) {
+        cache->bucket_count *= 2;
+    }
+    cache->buckets = calloc(cache->bucket_count, sizeof(file_entry_t*));
+}
+
+static void entry_free(file_entry_t *entry) {
+    if (entry->fd >= 0) {
+        close(entry->fd);
+    }
+    for (int i = 0; i < FILE_ENCODINGS; i++) {
+        if (entry->bodies[i] != NULL) {
+            free(entry->bodies[i]->data);
+            free(entry->bodies[i]);
+        }
+    }
+    free(entry->path);
+    free(entry);
+}
+
+static size_t entry_memory(const file_entry_t *entry) {
+    size_t size = 0;
+    for (int i = 0; i < FILE_ENCODINGS; i++) {
+        if (entry->bodies[i] != NULL) {
+            size += entry->bodies[i]->size;
+        }
+    }
+    return size;
+}
+
+// Каталог path со ссылкой на его наблюдение, -1 если наблюдать нельзя
+static int watch_acquire(file_cache_t *cache, const char *path) {
+    const char *slash = strrchr(path, '/');
+    char *dir = slash ? strndup(path, slash - path) : strdup(".");
+
+    size_t free_slot = cache->watch_count;
+    for (size_t i = 0; i < cache->watch_count; i++) {
+        if (cache->watches[i].dir == NULL) {
+            free_slot = i;
+        } else if (strcmp(cache->watches[i].dir, dir) == 0) {
+            free(dir);
+            cache->watches[i].entries++;
+            return i;
+        }
+    }
+
+    int wd = inotify_add_watch(cache->inotify, dir, WATCH_MASK);
+    for (size_t i = 0; wd >= 0 && i < cache->watch_count; i++) {
+        // Тот же каталог под другим именем: события пришли бы только одному из них
+        if (cache->watches[i].dir != NULL && cache->watches[i].wd == wd) {
+            wd = -1;
+        }
+    }
+    if (wd < 0) {
+        free(dir);
+        return -1;
+    }
+
+    if (free_slot == cache->watch_count) {
+        cache->watches = realloc(cache->watches, sizeof(file_watch_t) * (cache->watch_count + 1));
+        cache->watch_count++;
+    }
+    cache->watches[free_slot].wd = wd;
+    cache->watches[free_slot].dir = dir;
+    cache->watches[free_slot].entries = 1;
+    return free_slot;
+}
+
+static void watch_put(file_cache_t *cache, int index) {
+    file_watch_t *watch = &cache->watches[index];
+    if (--watch->entries == 0) {
+        inotify_rm_watch(cache->inotify, watch->wd);
+        free(watch->dir);
+        watch->dir = NULL;
+    }
+}
+
+static file_entry_t *entry_lookup(file_cache_t *cache, const char *path) {
+    file_entry_t *entry = cache->buckets[hash_path(path) & (cache->bucket_count - 1)];
+    while (entry != NULL && strcmp(entry->path, path) != 0) {
+        entry = entry->hash_next;
+    }
+    return entry;
+}
+
+static void lru_unlink(file_cache_t *cache, file_entry_t *entry) {
+    if (entry->lru_prev) {
+        entry->lru_prev->lru_next = entry->lru_next;
+    } else {
+        cache->lru_head = entry->lru_next;
+    }
+    if (entry->lru_next) {
+        entry->lru_next->lru_prev = entry->lru_prev;
+    } else {
+        cache->lru_tail = entry->lru_prev;
+    }
+}
+
+static void lru_push_front(file_cache_t *cache, file_entry_t *entry) {
+    entry->lru_prev = NULL;
+    entry->lru_next = cache->lru_head;
+    if (cache->lru_head) {
+        cache->lru_head->lru_prev = entry;
+    } else {
+        cache->lru_tail = entry;
+    }
+    cache->lru_head = entry;
+}
+
+// Удаление из кеша. Запись, на которую ссылаются соединения,
+// освобождается при последнем file_cache_release
+static void entry_remove(file_cache_t *cache, file_entry_t *entry) {
+    file_entry_t **link = &cache->buckets[hash_path(entry->path) & (cache->bucket_count - 1)];
+    while (*link != entry) {
+        link = &(*link)->hash_next;
+    }
+    *link = entry->hash_next;
+    lru_unlink(cache, entry);
+    cache->count--;
+    cache->memory_used -= entry_memory(entry);
+    entry->cached = 0;
+    watch_put(cache, entry->watch);
+    if (entry->refs == 0) {
+        entry_free(entry);
+    }
+}
+
+static void remove_all(file_cache_t *cache, int watch) {
+    file_entry_t *entry = cache->lru_head;
+    while (entry != NULL) {
+        file_entry_t *next = entry->lru_next;
+        if (watch < 0 || entry->watch == watch) {
+            entry_remove(cache, entry);
+        }
+        entry = next;
+    }
+}
+
+void file_cache_free(file_cache_t *cache) {
+    if (cache->buckets) {
+        remove_all(cache, -1);
+    }
+    if (cache->inotify >= 0) {
+        close(cache->inotify);
+    }
+    free(cache->buckets);
+    free(cache->watches);
+    memset(cache, 0, sizeof(*cache));
+    cache->inotify = -1;
+}
+
+int file_cache_fd(const file_cache_t *cache) {
+    return cache->capacity > 0 ? cache->inotify : -1;
+}
+
+// Vary ставится для всех сжимаемых типов: отдан ли файл из памяти,
+// зависит от кеша конкретного потока
+static void render_headers(file_entry_t *entry, const mime_type_t *type, const struct stat *st) {
+    struct tm tm;
+    gmtime_r(&st->st_mtime, &tm);
+    strftime(entry->last_modified, FILE_DATE_SZ, "%a, %d %b %Y %H:%M:%S GMT", &tm);
+    snprintf(entry->etag, FILE_ETAG_SZ, "\"%lx.%lx-%lx\"",
+             (unsigned long)st->st_mtim.tv_sec, (unsigned long)st->st_mtim.tv_nsec, (unsigned long)st->st_size);
+    entry->headers_len = snprintf(entry->headers, FILE_HEADERS_SZ,
+                                  "Content-Type: %s\r\nLast-Modified: %s\r\n%s",
+                                  type->type, entry->last_modified,
+                                  type->compressible ? "Vary: Accept-Encoding\r\n" : "");
+}
+
+static file_body_t *body_new(char *data, size_t size, const char *etag, const char *suffix) {
+    file_body_t *body = calloc(1, sizeof(file_body_t));
+    body->data = data;
+    body->size = size;
+    // У сжатого варианта свой ETag: "mtime-size" -> "mtime-size-gzip"
+    snprintf(body->etag, FILE_ETAG_SZ, "%.*s%s\"", (int)strlen(etag) - 1, etag, suffix);
+    return body;
+}
+
+static int read_all(int fd, char *buf, size_t size) {
+    size_t done = 0;
+    while (done < size) {
+        ssize_t res = pread(fd, buf + done, size - done, done);
+        if (res < 0 && errno == EINTR) {
+            continue;
+        }
+        if (res <= 0) {
+            return -1;
+        }
+        done += res;
+    }
+    return 0;
+}
+
+// Место под size байт в памяти: вытесняются давно не использованные файлы в памяти
+static int reserve_memory(file_cache_t *cache, size_t size) {
+    if (size > cache->memory_limit) {
+        return -1;
+    }
+    file_entry_t *entry = cache->lru_tail;
+    while (cache->memory_used + size > cache->memory_limit && entry != NULL) {
+        file_entry_t *prev = entry->lru_prev;
+        if (entry->bodies[FILE_IDENTITY] != NULL) {
+            entry_remove(cache, entry);
+        }
+        entry = prev;
+    }
+    return 0;
+}
+
+// Чтение небольшого файла в память и сжатие. При ошибке файл
+// остается отдаваться из дескриптора
+static void load_bodies(file_cache_t *cache, file_entry_t *entry, const mime_type_t *type) {
+    const size_t size = entry->size;
+    char *data = malloc(size ? size : 1);
+    if (data == NULL || read_all(entry->fd, data, size) < 0) {
+        free(data);
+        return;
+    }
+
+    char *gzip = NULL, *br = NULL;
+    size_t gzip_size = 0, br_size = 0;
+    const size_t max_size = size - size / MIN_SAVING;
+    if (type->compressible && size > 0) {
+        if (compress_gzip(data, size, &gzip, &gzip_size) == 0 && gzip_size >= max_size) {
+            free(gzip);
+            gzip = NULL;
+        }
+        if (compress_brotli(data, size, &br, &br_size) == 0 && br_size >= max_size) {
+            free(br);
+            br = NULL;
+        }
+    }
+
+    const size_t total = size + (gzip ? gzip_size : 0) + (br ? br_size : 0);
+    if (reserve_memory(cache, total) < 0) {
+        free(data);
+        free(gzip);
+        free(br);
+        return;
+    }
+    cache->memory_used += total;
+    entry->bodies[FILE_IDENTITY] = body_new(data, size, entry->etag, "");
+    if (gzip) {
+        entry->bodies[FILE_GZIP] = body_new(gzip, gzip_size, entry->etag, "-gzip");
+    }
+    if (br) {
+        entry->bodies[FILE_BR] = body_new(br, br_size, entry->etag, "-br");
+    }
+    close(entry->fd);
+    entry->fd = -1;
+}
+
+file_entry_t *file_cache_open(file_cache_t *cache, const char *path) {
+    if (cache->capacity > 0) {
+        file_entry_t *entry = entry_lookup(cache, path);
+        if (entry != NULL) {
+            lru_unlink(cache, entry);
+            lru_push_front(cache, entry);
+            entry->refs++;
+            return entry;
+        }
+    }
+
+    // Наблюдение ставится до open, чтобы не пропустить изменение между ними
+    int watch = cache->capacity > 0 ? watch_acquire(cache, path) : -1;
+
+    struct stat st;
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    int err = errno;
+    if (fd >= 0 && (fstat(fd, &st) < 0 || !S_ISREG(st.st_mode))) {
+        close(fd);
+        fd = -1;
+        err = ENOENT;
+    }
+    if (fd < 0) {
+        if (watch >= 0) {
+            watch_put(cache, watch);
+        }
+        errno = err;
+        return NULL;
+    }
+
+    file_entry_t *entry = calloc(1, sizeof(file_entry_t));
+    entry->path = strdup(path);
+    entry->fd = fd;
+    entry->size = st.st_size;
+    entry->refs = 1;
+    entry->watch = watch;
+    const mime_type_t *type = mime_type(path);
+    render_headers(entry, type, &st);
+    if (watch < 0) {
+        return entry;
+    }
+
+    if (cache->count == cache->capacity) {
+        entry_remove(cache, cache->lru_tail);
+    }
+    if ((size_t)st.st_size <= cache->small_max) {
+        load_bodies(cache, entry, type);
+    }
+    file_entry_t **bucket = &cache->buckets[hash_path(path) & (cache->bucket_count - 1)];
+    entry->hash_next = *bucket;
+    *bucket = entry;
+    lru_push_front(cache, entry);
+    entry->cached = 1;
+    cache->count++;
+    return entry;
+}
+
+void file_cache_release(file_cache_t *cache, file_entry_t *entry) {
+    (void)cache;
+    if (--entry->refs == 0 && !entry->cached) {
+        entry_free(entry);
+    }
+}
+
+static int watch_find(file_cache_t *cache, int wd) {
+    for (size_t i = 0; i < cache->watch_count; i++) {
+        if (cache->watches[i].dir != NULL && cache->watches[i].wd == wd) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+void file_cache_process_events(file_cache_t *cache) {
+    char buf[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+    char path[PATH_MAX];
+
+    for (;;) {
+        ssize_t len = read(cache->inotify, buf, sizeof(buf));
+        if (len <= 0) {
+            return;
+        }
+
+        for (char *p = buf; p < buf + len;) {
+            const struct inotify_event *event = (const struct inotify_event*)p;
+            p += sizeof(struct inotify_event) + event->len;
+
+            if (event->mask & IN_Q_OVERFLOW) {
+                remove_all(cache, -1);
+                continue;
+            }
+            int watch = watch_find(cache, event->wd);
+            if (watch < 0) {
+                continue;
+            }
+            // Каталог удален или переименован: пути его записей больше не верны
+            if (event->mask & (IN_DELETE_SELF | IN_MOVE_SELF | IN_IGNORED)) {
+                remove_all(cache, watch);
+                continue;
+            }
+            if (event->len == 0) {
+                continue;
+            }
+
+            const char *dir = cache->watches[watch].dir;
+            if (strcmp(dir, ".") == 0) {
+                snprintf(path, sizeof(path), "%s", event->name);
+            } else {
+                snprintf(path, sizeof(path), "%s/%s", dir, event->name);
+            }
+            file_entry_t *entry = entry_lookup(cache, path);
+            if (entry != NULL) {
+                entry_remove(cache, entry);
+            }
+        }
+    }
+}
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <stddef.h>
+#include <sys/types.h>
+#include <time.h>
+
+#define FILE_HEADERS_SZ 256
+#define FILE_RESPONSE_SZ 512
+#define FILE_ETAG_SZ 48
+#define FILE_DATE_SZ 32
+
+typedef enum {
+    FILE_IDENTITY = 0,
+    FILE_GZIP,
+    FILE_BR,
+    FILE_ENCODINGS
+} file_encoding_t;
+
+// Содержимое небольшого файла в памяти в одном из кодирований.
+// Заголовки ответа заполняет сервер при первой отдаче, response_len == 0 - еще нет
+typedef struct {
+    char  *data;
+    size_t size;
+    char   etag[FILE_ETAG_SZ];
+    char   response[FILE_RESPONSE_SZ];
+    size_t response_len;
+} file_body_t;
+
+// Открытый файл с метаданными и заранее подготовленными заголовками ответа.
+// Небольшие файлы читаются в память целиком вместе со сжатыми вариантами,
+// их дескриптор закрывается сразу (fd == -1)
+typedef struct file_entry_s {
+    char  *path;
+    int    fd;
+    off_t  size;
+    // Content-Type, Last-Modified и Vary, каждый со своим \r\n
+    char   headers[FILE_HEADERS_SZ];
+    size_t headers_len;
+    char   etag[FILE_ETAG_SZ];
+    char   last_modified[FILE_DATE_SZ];
+    // bodies[FILE_IDENTITY] != NULL - файл в памяти, сжатые варианты
+    // есть, только если они заметно меньше исходного
+    file_body_t *bodies[FILE_ENCODINGS];
+    int    refs;
+    int    cached;
+    int    watch;
+    struct file_entry_s *hash_next;
+    struct file_entry_s *lru_prev;
+    struct file_entry_s *lru_next;
+} file_entry_t;
+
+typedef struct {
+    int    wd;
+    char  *dir;
+    size_t entries;
+} file_watch_t;
+
+// LRU-кеш открытых файлов одного рабочего потока. Изменения файлов
+// отслеживаются inotify по каталогам, в которых лежат записи кеша.
+// Не потокобезопасен
+typedef struct {
+    file_entry_t **buckets;
+    size_t         bucket_count;
+    file_entry_t  *lru_head;
+    file_entry_t  *lru_tail;
+    size_t         count;
+    size_t         capacity;
+    // Файлы не больше small_max байт хранятся в памяти, всего до memory_limit байт
+    size_t         small_max;
+    size_t         memory_used;
+    size_t         memory_limit;
+    int            inotify;
+    file_watch_t  *watches;
+    size_t         watch_count;
+} file_cache_t;
+
+// capacity == 0 или ошибка inotify - файлы открываются на каждый запрос.
+// small_max == 0 - все файлы отдаются из дескриптора
+void file_cache_init(file_cache_t *cache, size_t capacity, size_t small_max, size_t memory_limit);
+
+void file_cache_free(file_cache_t *cache);
+
+// Дескриптор inotify для epoll, -1 если кеш выключен
+int file_cache_fd(const file_cache_t *cache);
+
+// Файл path (относительно рабочего каталога) со ссылкой для вызывающего.
+// Возвращает NULL с errno при ошибке, ENOENT и для не обычного файла
+file_entry_t *file_cache_open(file_cache_t *cache, const char *path);
+
+// Освобождение ссылки, полученной file_cache_open
+void file_cache_release(file_cache_t *cache, file_entry_t *entry);
+
+// Чтение событий inotify и удаление записей измененных файлов
+void file_cache_process_events(file_cache_t *cache);
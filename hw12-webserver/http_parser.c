@@ -0,0 +1,403 @@
+#include "http_parser.h"
+
+#include <limits.h>
+#include <string.h>
+#include <strings.h>
+
+enum {
+    S_START = 0,
+    S_METHOD,
+    S_PATH,
+    S_VERSION,
+    S_LINE_LF,
+    S_HEADER_START,
+    S_HEADER_NAME,
+    S_HEADER_SPACE,
+    S_HEADER_VALUE,
+    S_HEADER_LF,
+    S_END_LF
+};
+
+// Символы token из RFC 9110
+static int is_token(unsigned char c) {
+    if (c >= '0' && c <= '9') {
+        return 1;
+    }
+    if ((c | 0x20) >= 'a' && (c | 0x20) <= 'z') {
+        return 1;
+    }
+    return c != 0 && strchr("!#$%&'*+-.^_`|~", c) != NULL;
+}
+
+static int is_vchar(unsigned char c) {
+    return c > 0x20 && c != 0x7f;
+}
+
+void http_parser_init(http_parser_t *parser) {
+    memset(parser, 0, sizeof(*parser));
+    parser->state = S_START;
+}
+
+static http_parse_result_t parse_method(http_parser_t *parser, const char *token, size_t len) {
+    if (len == 3 && memcmp(token, "GET", 3) == 0) {
+        parser->method = HTTP_GET;
+    } else if (len == 4 && memcmp(token, "HEAD", 4) == 0) {
+        parser->method = HTTP_HEAD;
+    } else {
+        return HTTP_PARSE_BAD_METHOD;
+    }
+    return HTTP_PARSE_AGAIN;
+}
+
+static http_parse_result_t parse_version(http_parser_t *parser, const char *token, size_t len) {
+    if (len < 5 || memcmp(token, "HTTP/", 5) != 0) {
+        return HTTP_PARSE_BAD_REQUEST;
+    }
+    if (len != 8 || token[5] != '1' || token[6] != '.' || token[7] < '0' || token[7] > '9') {
+        return HTTP_PARSE_BAD_VERSION;
+    }
+    parser->minor_version = token[7] - '0';
+    return HTTP_PARSE_AGAIN;
+}
+
+static http_parse_result_t add_header(http_parser_t *parser, const char *buf, size_t end) {
+    if (parser->header_count == HTTP_MAX_HEADERS) {
+        return HTTP_PARSE_TOO_LARGE;
+    }
+    // Пробелы в конце значения не входят в него
+    while (end > parser->mark && (buf[end - 1] == ' ' || buf[end - 1] == '\t')) {
+        end--;
+    }
+    http_header_t *header = &parser->headers[parser->header_count++];
+    header->value.ptr = buf + parser->mark;
+    header->value.len = end - parser->mark;
+    return HTTP_PARSE_AGAIN;
+}
+
+// Тело запроса серверу статических файлов не нужно, запросы с ним отклоняются,
+// иначе следующий запрос в том же соединении был бы прочитан неверно
+static http_parse_result_t check_body(const http_parser_t *parser) {
+    if (http_header(parser, "Transfer-Encoding") != NULL) {
+        return HTTP_PARSE_BAD_REQUEST;
+    }
+    const slice_t *length = http_header(parser, "Content-Length");
+    if (length != NULL) {
+        for (size_t i = 0; i < length->len; i++) {
+            if (length->ptr[i] != '0') {
+                return HTTP_PARSE_BAD_REQUEST;
+            }
+        }
+    }
+    return HTTP_PARSE_DONE;
+}
+
+http_parse_result_t http_parse(http_parser_t *parser, const char *buf, size_t len) {
+    http_parse_result_t result = HTTP_PARSE_AGAIN;
+
+    for (size_t pos = parser->pos; pos < len; pos++) {
+        const unsigned char c = buf[pos];
+        switch (parser->state) {
+        case S_START:
+            // Пустые строки перед запросом допускаются
+            if (c == '\r' || c == '\n') {
+                break;
+            }
+            if (!is_token(c)) {
+                return HTTP_PARSE_BAD_REQUEST;
+            }
+            parser->mark = pos;
+            parser->state = S_METHOD;
+            break;
+
+        case S_METHOD:
+            if (c == ' ') {
+                result = parse_method(parser, buf + parser->mark, pos - parser->mark);
+                parser->mark = pos + 1;
+                parser->state = S_PATH;
+            } else if (!is_token(c)) {
+                return HTTP_PARSE_BAD_REQUEST;
+            }
+            break;
+
+        case S_PATH:
+            if (c == ' ') {
+                const char *start = buf + parser->mark;
+                const size_t path_len = pos - parser->mark;
+                if (path_len == 0 || start[0] != '/') {
+                    return HTTP_PARSE_BAD_REQUEST;
+                }
+                const char *query = memchr(start, '?', path_len);
+                parser->path.ptr = start;
+                parser->path.len = query ? (size_t)(query - start) : path_len;
+                parser->query.ptr = query ? query + 1 : start + path_len;
+                parser->query.len = query ? path_len - parser->path.len - 1 : 0;
+                parser->mark = pos + 1;
+                parser->state = S_VERSION;
+            } else if (!is_vchar(c)) {
+                return HTTP_PARSE_BAD_REQUEST;
+            }
+            break;
+
+        case S_VERSION:
+            if (c == '\r' || c == '\n') {
+                http_parse_result_t version = parse_version(parser, buf + parser->mark, pos - parser->mark);
+                if (version != HTTP_PARSE_AGAIN) {
+                    return version;
+                }
+                parser->state = c == '\r' ? S_LINE_LF : S_HEADER_START;
+            } else if (!is_vchar(c)) {
+                return HTTP_PARSE_BAD_REQUEST;
+            }
+            break;
+
+        case S_LINE_LF:
+        case S_HEADER_LF:
+            if (c != '\n') {
+                return HTTP_PARSE_BAD_REQUEST;
+            }
+            parser->state = S_HEADER_START;
+            break;
+
+        case S_HEADER_START:
+            if (c == '\r') {
+                parser->state = S_END_LF;
+                break;
+            }
+            if (c == '\n') {
+                parser->pos = parser->length = pos + 1;
+                return check_body(parser);
+            }
+            if (!is_token(c)) {
+                return HTTP_PARSE_BAD_REQUEST;
+            }
+            parser->mark = pos;
+            parser->state = S_HEADER_NAME;
+            break;
+
+        case S_HEADER_NAME:
+            if (c == ':') {
+                if (parser->header_count == HTTP_MAX_HEADERS) {
+                    return HTTP_PARSE_TOO_LARGE;
+                }
+                http_header_t *header = &parser->headers[parser->header_count];
+                header->name.ptr = buf + parser->mark;
+                header->name.len = pos - parser->mark;
+                parser->state = S_HEADER_SPACE;
+            } else if (!is_token(c)) {
+                return HTTP_PARSE_BAD_REQUEST;
+            }
+            break;
+
+        case S_HEADER_SPACE:
+            if (c == ' ' || c == '\t') {
+                break;
+            }
+            parser->mark = pos;
+            parser->state = S_HEADER_VALUE;
+            // fallthrough
+        case S_HEADER_VALUE:
+            if (c == '\r' || c == '\n') {
+                result = add_header(parser, buf, pos);
+                parser->state = c == '\r' ? S_HEADER_LF : S_HEADER_START;
+            } else if (c < 0x20 && c != '\t') {
+                return HTTP_PARSE_BAD_REQUEST;
+            }
+            break;
+
+        case S_END_LF:
+            if (c != '\n') {
+                return HTTP_PARSE_BAD_REQUEST;
+            }
+            parser->pos = parser->length = pos + 1;
+            return check_body(parser);
+        }
+
+        if (result != HTTP_PARSE_AGAIN) {
+            return result;
+        }
+    }
+
+    parser->pos = len;
+    return HTTP_PARSE_AGAIN;
+}
+
+const slice_t *http_header(const http_parser_t *parser, const char *name) {
+    const size_t len = strlen(name);
+    for (size_t i = 0; i < parser->header_count; i++) {
+        const http_header_t *header = &parser->headers[i];
+        if (header->name.len == len && strncasecmp(header->name.ptr, name, len) == 0) {
+            return &header->value;
+        }
+    }
+    return NULL;
+}
+
+int http_parse_status(http_parse_result_t result) {
+    switch (result) {
+    case HTTP_PARSE_TOO_LARGE:
+        return 431;
+    case HTTP_PARSE_BAD_METHOD:
+        return 501;
+    case HTTP_PARSE_BAD_VERSION:
+        return 505;
+    default:
+        return 400;
+    }
+}
+
+// Десятичное число из [*p, end), -1 если цифр нет или число слишком большое
+static long long parse_number(const char **p, const char *end) {
+    long long value = 0;
+    const char *start = *p;
+    while (*p < end && **p >= '0' && **p <= '9') {
+        if (value > (LLONG_MAX - 9) / 10) {
+            return -1;
+        }
+        value = value * 10 + (**p - '0');
+        (*p)++;
+    }
+    return *p == start ? -1 : value;
+}
+
+http_range_t http_parse_range(const slice_t *value, long long size, long long *start, long long *end) {
+    const char *p = value->ptr;
+    const char *limit = value->ptr + value->len;
+    if (value->len < 6 || strncasecmp(p, "bytes=", 6) != 0) {
+        return HTTP_RANGE_NONE;
+    }
+    p += 6;
+
+    long long first = -1, last = -1;
+    if (p < limit && *p != '-') {
+        first = parse_number(&p, limit);
+        if (first < 0) {
+            return HTTP_RANGE_NONE;
+        }
+    }
+    if (p == limit || *p++ != '-') {
+        return HTTP_RANGE_NONE;
+    }
+    if (p < limit) {
+        last = parse_number(&p, limit);
+        if (last < 0) {
+            return HTTP_RANGE_NONE;
+        }
+    }
+    // Несколько диапазонов не поддерживаются, отдается весь файл
+    if (p != limit || (first < 0 && last < 0) || (last >= 0 && first > last)) {
+        return HTTP_RANGE_NONE;
+    }
+
+    if (first < 0) {
+        // Последние last байт
+        if (last == 0) {
+            return HTTP_RANGE_UNSATISFIABLE;
+        }
+        first = last < size ? size - last : 0;
+        last = size - 1;
+    } else if (last < 0 || last >= size) {
+        last = size - 1;
+    }
+    if (first >= size) {
+        return HTTP_RANGE_UNSATISFIABLE;
+    }
+    *start = first;
+    *end = last + 1;
+    return HTTP_RANGE_OK;
+}
+
+// q=0, q=0.0 и т.п. запрещают кодирование, остальные значения разрешают
+static int zero_quality(const char *p, const char *end) {
+    while (p < end && (*p == ' ' || *p == '\t')) {
+        p++;
+    }
+    if (end - p < 2 || (p[0] | 0x20) != 'q' || p[1] != '=') {
+        return 0;
+    }
+    for (p += 2; p < end && *p != ' ' && *p != '\t'; p++) {
+        if (*p != '0' && *p != '.') {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+int http_accepts_encoding(const slice_t *value, const char *coding) {
+    const size_t coding_len = strlen(coding);
+    const char *p = value->ptr;
+    const char *limit = value->ptr + value->len;
+    int any = 0;
+
+    while (p < limit) {
+        const char *comma = memchr(p, ',', limit - p);
+        const char *item_end = comma ? comma : limit;
+        while (p < item_end && (*p == ' ' || *p == '\t')) {
+            p++;
+        }
+        const char *semicolon = memchr(p, ';', item_end - p);
+        const char *name_end = semicolon ? semicolon : item_end;
+        size_t name_len = name_end - p;
+        while (name_len > 0 && (p[name_len - 1] == ' ' || p[name_len - 1] == '\t')) {
+            name_len--;
+        }
+        const int allowed = !semicolon || !zero_quality(semicolon + 1, item_end);
+
+        // Явное упоминание важнее "*" в любом порядке
+        if (name_len == coding_len && strncasecmp(p, coding, coding_len) == 0) {
+            return allowed;
+        }
+        if (name_len == 1 && *p == '*') {
+            any = allowed;
+        }
+        p = comma ? comma + 1 : limit;
+    }
+    return any;
+}
+
+static int hex_value(char c) {
+    if (c >= '0' && c <= '9') {
+        return c - '0';
+    }
+    if ((c | 0x20) >= 'a' && (c | 0x20) <= 'f') {
+        return (c | 0x20) - 'a' + 10;
+    }
+    return -1;
+}
+
+int http_decode_path(const slice_t *path, char *out, size_t size) {
+    size_t i = 0, len = 0;
+    while (i < path->len && path->ptr[i] == '/') {
+        i++;
+    }
+
+    for (; i < path->len; i++) {
+        char c = path->ptr[i];
+        if (c == '%') {
+            int hi = i + 2 < path->len ? hex_value(path->ptr[i + 1]) : -1;
+            int lo = i + 2 < path->len ? hex_value(path->ptr[i + 2]) : -1;
+            if (hi < 0 || lo < 0 || (hi == 0 && lo == 0)) {
+                return -1;
+            }
+            c = (char)(hi << 4 | lo);
+            i += 2;
+        }
+        if (len + 1 >= size) {
+            return -1;
+        }
+        out[len++] = c;
+    }
+    out[len] = '\0';
+
+    // Сегменты ".." выводят за пределы каталога, пустые сегменты запрещены,
+    // чтобы после декодирования не получить абсолютный путь
+    for (size_t start = 0; start <= len;) {
+        const char *slash = memchr(out + start, '/', len - start);
+        const size_t end = slash ? (size_t)(slash - out) : len;
+        if ((end - start == 2 && out[start] == '.' && out[start + 1] == '.') ||
+            (slash != NULL && end == start)) {
+            return -1;
+        }
+        start = end + 1;
+    }
+    return len;
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <stddef.h>
+
+#define HTTP_MAX_HEADERS 32
+
+// Участок буфера запроса без копирования, не завершен нулем
+typedef struct {
+    const char *ptr;
+    size_t      len;
+} slice_t;
+
+typedef struct {
+    slice_t name;
+    slice_t value;
+} http_header_t;
+
+typedef enum {
+    HTTP_GET = 0,
+    HTTP_HEAD
+} http_method_t;
+
+typedef enum {
+    HTTP_PARSE_DONE = 0,    // запрос разобран, длина в parser->length
+    HTTP_PARSE_AGAIN,       // нужны следующие данные
+    HTTP_PARSE_BAD_REQUEST, // 400
+    HTTP_PARSE_TOO_LARGE,   // 431, буфер закончился раньше запроса
+    HTTP_PARSE_BAD_METHOD,  // 501
+    HTTP_PARSE_BAD_VERSION  // 505
+} http_parse_result_t;
+
+// Разбор запроса по частям: каждый вызов продолжает с места, где
+// остановился предыдущий. Все вызовы получают один и тот же буфер,
+// к концу которого дописываются новые данные, слайсы указывают в него
+typedef struct {
+    int           state;
+    size_t        pos;
+    size_t        mark;
+    http_method_t method;
+    slice_t       path;
+    slice_t       query;
+    int           minor_version;
+    http_header_t headers[HTTP_MAX_HEADERS];
+    size_t        header_count;
+    size_t        length;
+} http_parser_t;
+
+void http_parser_init(http_parser_t *parser);
+
+// Продолжение разбора buf длины len
+http_parse_result_t http_parse(http_parser_t *parser, const char *buf, size_t len);
+
+// Значение заголовка name без учета регистра, NULL если его нет
+const slice_t *http_header(const http_parser_t *parser, const char *name);
+
+// Код ответа для ошибки разбора
+int http_parse_status(http_parse_result_t result);
+
+typedef enum {
+    HTTP_RANGE_NONE = 0,     // заголовка нет или он не разобран: ответ целиком
+    HTTP_RANGE_OK,           // один диапазон [*start, *end) внутри файла
+    HTTP_RANGE_UNSATISFIABLE // 416, диапазон за концом файла
+} http_range_t;
+
+// Разбор значения заголовка Range для файла размера size.
+// Поддерживается один диапазон байт: "a-b", "a-" и "-n"
+http_range_t http_parse_range(const slice_t *value, long long size, long long *start, long long *end);
+
+// Разрешает ли значение заголовка Accept-Encoding кодирование coding:
+// оно перечислено явно или через "*" и не с q=0
+int http_accepts_encoding(const slice_t *value, const char *coding);
+
+// Путь запроса без начального '/' с декодированными %XX в out размера size.
+// Возвращает длину или -1 для пути вне каталога сервера или не влезающего в out
+int http_decode_path(const slice_t *path, char *out, size_t size);
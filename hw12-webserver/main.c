@@ -1,87 +1,45 @@
+#define _GNU_SOURCE
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <errno.h>
+#include <pthread.h>
+#include <sched.h>
 #include <fcntl.h>
 #include <signal.h>
 #include <unistd.h>
+#include <netinet/in.h>
 #include <arpa/inet.h>
 #include <sys/types.h>
 #include <sys/epoll.h>
-#include <sys/stat.h>
+#include <sys/resource.h>
 #include <sys/sendfile.h>
+#include <sys/uio.h>
+#include <sys/timerfd.h>
 
-#define BUF_SZ 2048
-#define STR_LEN 256
-#define EPOLL_MAX 128
-#define QUEUE 128
-
-#define FORBIDDEN_RESPONSE \
-"HTTP/1.1 403 Forbidden\r\n\
-Content-Length: %d\r\n\
-Connection: close\r\n\
-Content-Type: text/html\r\n\r\n\
-<html><head><title>403 Forbidden</title></head>\
-<body>\
-<h1>Forbidden</h1>\
-<p>You don't have permission to access /%s on this server!</p>\
-</body></html>\n"
-
-
-#define NOT_FOUND_RESPONSE \
-"HTTP/1.1 404 Not Found\r\n\
-Content-Length: 133\r\n\
-Connection: close\r\n\
-Content-Type: text/html\r\n\r\n\
-<html><head><title>404 Not Found</title></head><body><h1>Not Found</h1>The requested URL was not found on this server.</body></html>\n"
-
-
-#define OK_RESPONSE \
-"HTTP/1.1 200 OK\r\n\
-Server: chttp\r\n\
-Content-Length: %ld\r\n\
-Connection: close\r\n\
-Content-Type: text/html\r\n\r\n"
-
-
-static struct epoll_event events[EPOLL_MAX];
-
-typedef struct {
-    int    sock;
-    char   req_buf[BUF_SZ];
-    size_t req_size;
-    char   res_buf[BUF_SZ];
-    size_t res_size;
-    char   url[STR_LEN];
-    size_t url_len;
-} req_data_t;
+#include "conn.h"
+#include "file_cache.h"
+#include "response.h"
+#include "worker.h"
+#include "uring.h"
 
+#define QUEUE 1024
+// data.u64 слушающего сокета, таймера и inotify, с handle соединения не совпадают
+#define LISTEN_HANDLE UINT64_MAX
+#define TIMER_HANDLE (UINT64_MAX - 1)
+#define FILES_HANDLE (UINT64_MAX - 2)
+// Открытых файлов в кеше одного рабочего потока
+#define FILE_CACHE_SIZE 1024
+// Файлы до SMALL_FILE_MAX байт хранятся в памяти, до CACHE_MEMORY_MB на поток
+#define SMALL_FILE_MAX (64 * 1024)
+#define CACHE_MEMORY_MB 32
 
 char *default_dir_path = ".";
 char *default_addr = "127.0.0.1";
 int   default_port = 30020;
 
 
-int parse_url(char* line, char* url) {
-    char *token;
-    token = strtok(line, " ");
-    if (token == NULL) {
-        fprintf(stderr, "Failed to parse %s: %s\n", line, strerror(errno));
-        url[0] = '\0';
-        return 0;
-    }
-    token = strtok(NULL, " ");
-    if (token == NULL) {
-        fprintf(stderr, "Failed to parse %s: %s\n", line, strerror(errno));
-        url[0] = '\0';
-        return 0;
-    }
-    token++;
-    strncpy(url, token, STR_LEN - 1);
-    url[STR_LEN - 1] = '\0';
-    return strlen(url);
-}
-
 int set_nonblocking(int sock) {
     int opts;
     opts = fcntl(sock, F_GETFL);
@@ -97,61 +55,436 @@ int set_nonblocking(int sock) {
     return 0;
 }
 
-void read_req(req_data_t* req) {
-    int res = 0;
-    char *header = NULL;
-    while (header == NULL) {
-        if ((res = recv(req->sock, req->req_buf, BUF_SZ, 0)) < 0) {
+// Чтение доступных данных в конец буфера запроса.
+// Возвращает 1, если данные прочитаны, 0 при их отсутствии, -1 при закрытии
+int read_req(conn_t* req) {
+    for (;;) {
+        ssize_t res = recv(req->sock, req->req_buf + req->req_size, BUF_SZ - req->req_size, 0);
+        if (res < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                return 0;
+            }
             perror("read_req");
-            return;
+            return -1;
         }
-        header = strstr(req->req_buf, "\r\n\r\n");
+        if (res == 0) {
+            return -1;
+        }
+        req->req_size += res;
+        return 1;
     }
-    req->req_buf[res] = '\0';
-    req->req_size = res;
-    req->url_len = parse_url(req->req_buf, req->url);
 }
 
-void write_res(req_data_t* req) {
-    if (req->url_len != 0) {
-        if ((access(req->url, R_OK) != 0) && (errno == EACCES)) {
-            req->res_size = snprintf(req->res_buf, BUF_SZ - 1, FORBIDDEN_RESPONSE, (146 + (int)req->url_len), req->url);
-            req->res_buf[req->res_size] = '\0';
-            if (send(req->sock, req->res_buf, req->res_size, 0) < 0) {
-                perror("write_res");
-                return;
-            }
-            return;
+void finish_res(worker_t* worker, conn_t* conn) {
+    const off_t body = conn->file != NULL || conn->body != NULL ? conn->body_size : 0;
+    stats_response(worker->stats, conn->status, conn->res_size + body);
+    access_log_write(&worker->log, conn);
+    release_res(&worker->files, conn);
+}
+
+// Отправка подготовленного ответа с места, где остановилась предыдущая.
+// Заголовки уходят с MSG_MORE и объединяются с первыми байтами файла.
+// Возвращает 1, когда ответ отправлен, 0 при заполненном буфере сокета
+// (продолжение по EPOLLOUT), -1 при ошибке
+int flush_res(worker_t* worker, conn_t* req) {
+    // Тело из памяти уходит вместе с заголовками одним writev
+    while (req->body != NULL && (req->res_sent < req->res_size || req->file_offset < req->file_end)) {
+        struct iovec iov[2];
+        int iov_count = 0;
+        if (req->res_sent < req->res_size) {
+            iov[iov_count].iov_base = req->res_buf + req->res_sent;
+            iov[iov_count++].iov_len = req->res_size - req->res_sent;
+        }
+        if (req->file_offset < req->file_end) {
+            iov[iov_count].iov_base = (char*)req->body + req->file_offset;
+            iov[iov_count++].iov_len = req->file_end - req->file_offset;
         }
-        int fd;
-        if ((fd = open(req->url, O_RDONLY)) == -1) {
-            req->res_size = snprintf(req->res_buf, BUF_SZ - 1, NOT_FOUND_RESPONSE);
-            req->res_buf[req->res_size] = '\0';
-            if (send(req->sock, req->res_buf, req->res_size, 0) < 0) {
-                perror("write_res");
-                return;
+        ssize_t res = writev(req->sock, iov, iov_count);
+        if (res < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                return 0;
             }
-            return;
+            perror("write_res");
+            return -1;
+        }
+        const size_t head = req->res_size - req->res_sent;
+        if ((size_t)res <= head) {
+            req->res_sent += res;
         } else {
-            struct stat stat_buf;
-            fstat(fd, &stat_buf);
-            req->res_size = sprintf(req->res_buf, OK_RESPONSE, stat_buf.st_size);
-            req->res_buf[req->res_size] = '\0';
-            if (send(req->sock, req->res_buf, req->res_size, 0) < 0) {
-                perror("write_res");
+            req->res_sent = req->res_size;
+            req->file_offset += res - head;
+        }
+    }
+
+    while (req->res_sent < req->res_size) {
+        const int flags = req->file != NULL ? MSG_MORE : 0;
+        ssize_t res = send(req->sock, req->res_buf + req->res_sent, req->res_size - req->res_sent, flags);
+        if (res < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                return 0;
+            }
+            perror("write_res");
+            return -1;
+        }
+        req->res_sent += res;
+    }
+
+    while (req->file != NULL && req->body == NULL && req->file_offset < req->file_end) {
+        ssize_t res = sendfile(req->sock, req->file->fd, &req->file_offset, req->file_end - req->file_offset);
+        if (res < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                return 0;
+            }
+            perror("write_res");
+            return -1;
+        }
+        if (res == 0) {
+            // Файл укоротился после fstat, Content-Length уже не выполнить
+            return -1;
+        }
+    }
+
+    finish_res(worker, req);
+    return 1;
+}
+
+// Мягкий лимит открытых файлов поднимается до жесткого
+void raise_fd_limit(void) {
+    struct rlimit limit;
+    if (getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur < limit.rlim_max) {
+        limit.rlim_cur = limit.rlim_max;
+        if (setrlimit(RLIMIT_NOFILE, &limit) < 0) {
+            perror("setrlimit");
+        }
+    }
+}
+
+void close_conn(worker_t* worker, conn_t* conn) {
+    epoll_ctl(worker->epoll, EPOLL_CTL_DEL, conn->sock, NULL);
+    close(conn->sock);
+    release_res(&worker->files, conn);
+    conn_release(&worker->pool, conn);
+    stats_set(&worker->stats->active, worker->pool.active);
+}
+
+// Ответы на все полные запросы из буфера по порядку, затем чтение следующих.
+// Следующий запрос разбирается только после отправки ответа на текущий.
+// Возвращает 0 в ожидании данных или места в буфере сокета, -1, если
+// соединение нужно закрыть
+int serve_conn(worker_t* worker, conn_t* conn) {
+    for (;;) {
+        if (conn->res_size != 0) {
+            int res = flush_res(worker, conn);
+            if (res <= 0) {
+                return res;
+            }
+            if (!conn->keep_alive) {
+                return -1;
+            }
+            conn_next_request(conn, conn->parser.length);
+        }
+
+        if (prepare_res(&worker->files, conn) == 0) {
+            int res = read_req(conn);
+            if (res <= 0) {
+                return res;
+            }
+        }
+    }
+}
+
+time_t now_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC_COARSE, &ts);
+    return ts.tv_sec;
+}
+
+// Таймер раз в секунду для закрытия простаивающих соединений
+int create_idle_timer(int epoll) {
+    int timer = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (timer < 0) {
+        perror("timerfd_create");
+        return -1;
+    }
+    struct itimerspec spec = { { 1, 0 }, { 1, 0 } };
+    struct epoll_event timer_ev;
+    timer_ev.events = EPOLLIN;
+    timer_ev.data.u64 = TIMER_HANDLE;
+    if (timerfd_settime(timer, 0, &spec, NULL) < 0 || epoll_ctl(epoll, EPOLL_CTL_ADD, timer, &timer_ev) < 0) {
+        perror("idle timer");
+        close(timer);
+        return -1;
+    }
+    return timer;
+}
+
+// Соединения упорядочены по активности, проверка идет от самого старого.
+// Тот же таймер сбрасывает накопленный журнал
+void close_idle(worker_t* worker, time_t now) {
+    uint64_t ticks;
+    while (read(worker->timer, &ticks, sizeof(ticks)) > 0)
+        ;
+    access_log_flush(&worker->log);
+    conn_t *conn;
+    while ((conn = conn_idle_oldest(&worker->pool)) != NULL && now - conn->last_active >= IDLE_TIMEOUT) {
+        close_conn(worker, conn);
+    }
+}
+
+// Слушающий сокет в режиме EPOLLET: принимаются все ожидающие соединения
+void accept_conns(worker_t* worker, time_t now) {
+    conn_pool_t *pool = &worker->pool;
+    worker_stats_t *stats = worker->stats;
+    for (;;) {
+        struct sockaddr_in addr;
+        socklen_t addr_len = sizeof(addr);
+        int sock = accept4(worker->server, (struct sockaddr*)&addr, &addr_len, SOCK_NONBLOCK);
+        if (sock < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) {
+                continue;
+            }
+            if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                perror("accept");
+                stats_add(&stats->accept_errors, 1);
+            }
+            break;
+        }
+
+        conn_t *conn = conn_alloc(pool, sock, now);
+        if (conn == NULL) {
+            fprintf(stderr, "Out of memory for connection %d\n", sock);
+            close(sock);
+            stats_add(&stats->accept_errors, 1);
+            continue;
+        }
+        conn->peer_addr = addr.sin_addr.s_addr;
+
+        struct epoll_event conn_ev;
+        conn_ev.data.u64 = conn_handle(conn);
+        conn_ev.events = EPOLLIN | EPOLLOUT | EPOLLET | EPOLLRDHUP;
+        if (epoll_ctl(worker->epoll, EPOLL_CTL_ADD, sock, &conn_ev) < 0) {
+            perror("epoll_ctl");
+            close(sock);
+            conn_release(pool, conn);
+            stats_add(&stats->accept_errors, 1);
+            continue;
+        }
+        stats_add(&stats->accepted, 1);
+    }
+    stats_set(&stats->active, pool->active);
+}
+
+// Слушающий сокет одного рабочего потока. Ядро распределяет соединения
+// между сокетами группы SO_REUSEPORT, SO_INCOMING_CPU предпочитает сокет
+// потока, работающего на ядре, которое приняло пакеты соединения
+int create_listener(const char* addr, int port, int cpu) {
+    struct sockaddr_in server_addr = { 0 };
+    int server = socket(AF_INET, SOCK_STREAM, 0);
+    if (server < 0) {
+        perror("socket");
+        return -1;
+    }
+
+    int reuse = 1;
+    setsockopt(server, SOL_SOCKET, SO_REUSEADDR, (const char*)&reuse, sizeof(reuse));
+    setsockopt(server, SOL_SOCKET, SO_REUSEPORT, (const char*)&reuse, sizeof(reuse));
+#ifdef SO_INCOMING_CPU
+    if (cpu >= 0) {
+        setsockopt(server, SOL_SOCKET, SO_INCOMING_CPU, &cpu, sizeof(cpu));
+    }
+#endif
+
+    set_nonblocking(server);
+    server_addr.sin_family = AF_INET;
+    server_addr.sin_addr.s_addr = inet_addr(addr);
+    server_addr.sin_port = htons(port);
+
+    if (bind(server, (struct sockaddr *)&server_addr, sizeof(server_addr)) < 0) {
+        perror("bind");
+        close(server);
+        return -1;
+    }
+
+    if (listen(server, QUEUE) < 0) {
+        perror("listen");
+        close(server);
+        return -1;
+    }
+    return server;
+}
+
+int epoll_init(worker_t* worker) {
+    worker->epoll = epoll_create1(0);
+    if (worker->epoll < 0) {
+        perror("epoll_create1");
+        return -1;
+    }
+
+    struct epoll_event listen_ev;
+    listen_ev.events = EPOLLIN | EPOLLET;
+    listen_ev.data.u64 = LISTEN_HANDLE;
+    if (epoll_ctl(worker->epoll, EPOLL_CTL_ADD, worker->server, &listen_ev) < 0) {
+        perror("epoll_ctl");
+        return -1;
+    }
+
+    worker->timer = create_idle_timer(worker->epoll);
+
+    const int inotify = file_cache_fd(&worker->files);
+    if (inotify >= 0) {
+        struct epoll_event files_ev;
+        files_ev.events = EPOLLIN;
+        files_ev.data.u64 = FILES_HANDLE;
+        if (epoll_ctl(worker->epoll, EPOLL_CTL_ADD, inotify, &files_ev) < 0) {
+            perror("epoll_ctl");
+            return -1;
+        }
+    }
+    return 0;
+}
+
+// Без поддержки io_uring в ядре поток работает через epoll
+int worker_init(worker_t* worker, int id, int cpu, const char* addr, int port, size_t small_max, size_t memory_mb,
+                int use_uring, const char* log_path) {
+    worker->id = id;
+    worker->cpu = cpu;
+    conn_pool_init(&worker->pool);
+    if (access_log_open(&worker->log, log_path) < 0) {
+        return -1;
+    }
+
+    worker->server = create_listener(addr, port, cpu);
+    if (worker->server < 0) {
+        return -1;
+    }
+
+    file_cache_init(&worker->files, FILE_CACHE_SIZE, small_max, memory_mb * 1024 * 1024);
+    if (use_uring && uring_init(worker) == 0) {
+        return 0;
+    }
+    return epoll_init(worker);
+}
+
+void* worker_run(void* arg) {
+    worker_t *worker = (worker_t*)arg;
+    conn_pool_t *pool = &worker->pool;
+
+    if (worker->cpu >= 0) {
+        cpu_set_t cpus;
+        CPU_ZERO(&cpus);
+        CPU_SET(worker->cpu, &cpus);
+        int err = pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+        if (err != 0) {
+            fprintf(stderr, "Worker %d: can't pin to CPU %d: %s\n", worker->id, worker->cpu, strerror(err));
+        }
+    }
+
+    if (worker->uring != NULL) {
+        uring_run(worker);
+        return NULL;
+    }
+
+    for (;;) {
+        int clients = epoll_wait(worker->epoll, worker->events, EPOLL_MAX, -1);
+        if (clients < 0 && errno != EINTR) {
+            perror("epoll_wait");
+            break;
+        }
+        time_t now = now_sec();
+        for (int i = 0; i < clients; i++) {
+            const uint64_t handle = worker->events[i].data.u64;
+            if (handle == LISTEN_HANDLE) {
+                accept_conns(worker, now);
+                continue;
+            }
+            if (handle == TIMER_HANDLE) {
+                close_idle(worker, now);
+                continue;
+            }
+            if (handle == FILES_HANDLE) {
+                file_cache_process_events(&worker->files);
+                continue;
             }
-            if (sendfile(req->sock, fd, NULL, stat_buf.st_size) < 0) {
-                perror("write_res");
+
+            conn_t *conn = conn_lookup(pool, handle);
+            if (conn == NULL) {
+                continue;
+            }
+            conn_touch(pool, conn, now);
+            if (serve_conn(worker, conn) < 0) {
+                close_conn(worker, conn);
             }
         }
-        close(fd);
     }
+    return NULL;
 }
 
 int main(int argc, char* argv[]) {
     char *dir_path;
     char *addr;
     int   port;
+    int   worker_count;
+    long  small_max;
+    long  memory_mb;
+    int   use_uring = 0;
+    char *log_path = NULL;
+    const int cpu_count = sysconf(_SC_NPROCESSORS_ONLN);
+
+    if (argc >= 9) {
+        log_path = argv[8];
+    }
+
+    if (argc >= 8) {
+        if (strcmp(argv[7], "uring") == 0) {
+            use_uring = 1;
+        } else if (strcmp(argv[7], "epoll") != 0) {
+            fprintf(stderr, "Invalid backend: %s (epoll or uring)\n", argv[7]);
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    if (argc >= 7) {
+        memory_mb = atol(argv[6]);
+        if (memory_mb < 0) {
+            fprintf(stderr, "Invalid cache memory: %s\n", argv[6]);
+            exit(EXIT_FAILURE);
+        }
+    } else {
+        memory_mb = CACHE_MEMORY_MB;
+    }
+
+    if (argc >= 6) {
+        small_max = atol(argv[5]);
+        if (small_max < 0) {
+            fprintf(stderr, "Invalid small file size: %s\n", argv[5]);
+            exit(EXIT_FAILURE);
+        }
+    } else {
+        small_max = SMALL_FILE_MAX;
+    }
+
+    if (argc >= 5) {
+        worker_count = atoi(argv[4]);
+        if (worker_count <= 0) {
+            fprintf(stderr, "Invalid workers count: %s\n", argv[4]);
+            exit(EXIT_FAILURE);
+        }
+    } else {
+        worker_count = cpu_count > 0 ? cpu_count : 1;
+        printf("Workers count wasn't specified. Default(%d) used\n", worker_count);
+    }
 
     if (argc >= 4) {
         port = atoi(argv[3]);
@@ -186,97 +519,41 @@ int main(int argc, char* argv[]) {
         printf("Working DIR wasn't specified. Default(%s) used\n", dir_path);
     }
 
-    int epoll, server, clients, conn;
-    struct sockaddr_in server_addr = { 0 };
-    struct epoll_event listen_ev, conn_ev;
-    int ev_count;
-    req_data_t  req = {0};
-    req_data_t* req_ptr = &req;
-
     chdir(dir_path);
 
     signal(SIGPIPE, SIG_IGN);
+    raise_fd_limit();
 
-    epoll = epoll_create(EPOLL_MAX);
-    server = socket(AF_INET, SOCK_STREAM, 0);
-    if (server < 0) {
-        perror("socket");
-        exit(EXIT_FAILURE);
-    }
-
-    int reuse = 1;
-    setsockopt(server, SOL_SOCKET, SO_REUSEADDR, (const char*)&reuse, sizeof(reuse));
-    setsockopt(server, SOL_SOCKET, SO_REUSEPORT, (const char*)&reuse, sizeof(reuse));
-
-    set_nonblocking(server);
-    server_addr.sin_family = AF_INET;
-    server_addr.sin_addr.s_addr = inet_addr(addr);
-    server_addr.sin_port = htons(port);
-
-    if (bind(server, (struct sockaddr *)&server_addr, sizeof(server_addr)) < 0) {
-        perror("bind");
+    // Сокеты создаются до запуска потоков, чтобы ошибка bind завершала сервер сразу
+    worker_t *workers = calloc(worker_count, sizeof(worker_t));
+    worker_stats_t *stats = stats_create(worker_count);
+    if (workers == NULL || stats == NULL) {
+        fprintf(stderr, "Out of memory for workers\n");
         exit(EXIT_FAILURE);
     }
-
-    if (listen(server, QUEUE) < 0) {
-        perror("listen");
-        exit(EXIT_FAILURE);
+    for (int i = 0; i < worker_count; i++) {
+        const int cpu = cpu_count > 0 ? i % cpu_count : -1;
+        workers[i].stats = &stats[i];
+        if (worker_init(&workers[i], i, cpu, addr, port, small_max, memory_mb, use_uring, log_path) < 0) {
+            exit(EXIT_FAILURE);
+        }
     }
 
-    printf("Server(%s:%d) started. Working DIR: %s\n", addr, port, dir_path);
+    printf("Server(%s:%d) started with %d %s workers. Working DIR: %s\n", addr, port, worker_count,
+           use_uring ? "io_uring" : "epoll", dir_path);
     free(addr);
     free(dir_path);
 
-    listen_ev.events = EPOLLIN | EPOLLET;
-    listen_ev.data.fd = server;
-    if (epoll_ctl(epoll, EPOLL_CTL_ADD, server, &listen_ev) < 0) {
-        perror("epoll_ctl");
-        exit(EXIT_FAILURE);
-    }
-
-    ev_count = 1;
-    for (;;) {
-        clients = epoll_wait(epoll, events, EPOLL_MAX, -1);
-        for (int i = 0; i < clients; i++) {
-            if (events[i].data.fd == server) {
-                conn = accept(server, NULL, NULL);
-                if (conn < 0) {
-                    perror("accept");
-                    continue;
-                }
-                if (ev_count == EPOLL_MAX - 1) {
-                    close(conn);
-                    continue;
-                }
-                set_nonblocking(conn);
-                conn_ev.data.ptr = &req;
-                req.sock = conn;
-                conn_ev.events = EPOLLIN | EPOLLOUT | EPOLLET | EPOLLRDHUP;
-                if (epoll_ctl(epoll, EPOLL_CTL_ADD, conn, &conn_ev) < 0) {
-                    perror("epoll_ctl");
-                    close(conn);
-                    continue;
-                }
-                ev_count++;
-            } else {
-                req_ptr = (req_data_t*)events[i].data.ptr;
-                if (events[i].events & EPOLLIN) {
-                    read_req(req_ptr);
-                }
-                if (events[i].events & EPOLLOUT) {
-                    write_res(req_ptr);
-                }
-                if (events[i].events & EPOLLRDHUP) {
-                    fprintf(stderr, "fd %d error!\n", req_ptr->sock);
-                }
-                if (req_ptr->res_size != 0) {
-                    epoll_ctl(epoll, EPOLL_CTL_DEL, req_ptr->sock, &conn_ev);
-                    close(req_ptr->sock);
-                    memset(&req, 0, sizeof(req));
-                    ev_count--;
-                }
-            }
+    for (int i = 0; i < worker_count; i++) {
+        int err = pthread_create(&workers[i].thread, NULL, worker_run, &workers[i]);
+        if (err != 0) {
+            fprintf(stderr, "Error creating worker %d: %s\n", i, strerror(err));
+            exit(EXIT_FAILURE);
         }
     }
+    for (int i = 0; i < worker_count; i++) {
+        pthread_join(workers[i].thread, NULL);
+    }
+    free(workers);
     exit(EXIT_SUCCESS);
 }
@@ -0,0 +1,336 @@
+#define _GNU_SOURCE
+
+#include "response.h"
+#include "stats.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <errno.h>
+
+#define FORBIDDEN_RESPONSE \
+"HTTP/1.1 403 Forbidden\r\n\
+Content-Length: %d\r\n\
+Connection: %s\r\n\
+Content-Type: text/html\r\n\r\n\
+<html><head><title>403 Forbidden</title></head>\
+<body>\
+<h1>Forbidden</h1>\
+<p>You don't have permission to access /%s on this server!</p>\
+</body></html>\n"
+
+
+#define NOT_FOUND_RESPONSE \
+"HTTP/1.1 404 Not Found\r\n\
+Content-Length: 133\r\n\
+Connection: %s\r\n\
+Content-Type: text/html\r\n\r\n\
+<html><head><title>404 Not Found</title></head><body><h1>Not Found</h1>The requested URL was not found on this server.</body></html>\n"
+
+
+#define ERROR_RESPONSE \
+"HTTP/1.1 %d %s\r\n\
+Content-Length: %d\r\n\
+Connection: close\r\n\
+Content-Type: text/html\r\n\r\n%s"
+
+#define ERROR_BODY \
+"<html><head><title>%d %s</title></head><body><h1>%s</h1></body></html>\n"
+
+
+// Connection идет последним: заголовки файла в памяти готовятся заранее,
+// к ним дописывается только CONNECTION_HEADER
+#define OK_HEADERS \
+"HTTP/1.1 200 OK\r\n\
+Server: chttp\r\n\
+Content-Length: %ld\r\n\
+Accept-Ranges: bytes\r\n\
+ETag: %s\r\n\
+%s%s"
+
+#define CONNECTION_HEADER "Connection: %s\r\n\r\n"
+
+#define OK_RESPONSE OK_HEADERS CONNECTION_HEADER
+
+
+#define PARTIAL_RESPONSE \
+"HTTP/1.1 206 Partial Content\r\n\
+Server: chttp\r\n\
+Content-Range: bytes %ld-%ld/%ld\r\n\
+Content-Length: %ld\r\n\
+Connection: %s\r\n\
+ETag: %s\r\n\
+%s\r\n"
+
+
+#define NOT_MODIFIED_RESPONSE \
+"HTTP/1.1 304 Not Modified\r\n\
+Server: chttp\r\n\
+Connection: %s\r\n\
+ETag: %s\r\n\
+%s\r\n"
+
+
+#define STATS_RESPONSE \
+"HTTP/1.1 200 OK\r\n\
+Server: chttp\r\n\
+Content-Length: %zu\r\n\
+Content-Type: application/json\r\n\
+Cache-Control: no-store\r\n\
+Connection: %s\r\n\r\n"
+
+#define STATS_PATH "/__stats"
+
+
+#define RANGE_ERROR_RESPONSE \
+"HTTP/1.1 416 Range Not Satisfiable\r\n\
+Content-Range: bytes */%ld\r\n\
+Content-Length: 0\r\n\
+Connection: %s\r\n\r\n"
+
+
+
+static const char *encoding_header[FILE_ENCODINGS] = {
+    [FILE_IDENTITY] = "",
+    [FILE_GZIP] = "Content-Encoding: gzip\r\n",
+    [FILE_BR] = "Content-Encoding: br\r\n",
+};
+
+
+static const char *status_reason(int status) {
+    switch (status) {
+    case 400: return "Bad Request";
+    case 403: return "Forbidden";
+    case 404: return "Not Found";
+    case 431: return "Request Header Fields Too Large";
+    case 501: return "Not Implemented";
+    case 505: return "HTTP Version Not Supported";
+    default:  return "Internal Server Error";
+    }
+}
+
+// HTTP/1.1 держит соединение по умолчанию, HTTP/1.0 - только по запросу клиента
+static int want_keep_alive(conn_t* req) {
+    const slice_t *connection = http_header(&req->parser, "Connection");
+    if (connection != NULL && connection->len == 5 && strncasecmp(connection->ptr, "close", 5) == 0) {
+        return 0;
+    }
+    if (req->parser.minor_version == 0) {
+        return connection != NULL && connection->len == 10 &&
+               strncasecmp(connection->ptr, "keep-alive", 10) == 0;
+    }
+    return 1;
+}
+
+static const char *conn_header(conn_t* req) {
+    return req->keep_alive ? "keep-alive" : "close";
+}
+
+// Путь файла из разобранного запроса, "/" соответствует index.html
+static int set_url(conn_t* req) {
+    int len = http_decode_path(&req->parser.path, req->url, STR_LEN);
+    if (len < 0) {
+        return -1;
+    }
+    if (len == 0) {
+        strcpy(req->url, "index.html");
+        len = strlen(req->url);
+    }
+    req->url_len = len;
+    return 0;
+}
+
+static void write_error(conn_t* req, int status) {
+    req->keep_alive = 0;
+    req->status = status;
+    const char *reason = status_reason(status);
+    char body[STR_LEN];
+    int body_len = snprintf(body, sizeof(body), ERROR_BODY, status, reason, reason);
+    req->res_size = snprintf(req->res_buf, BUF_SZ, ERROR_RESPONSE, status, reason, body_len, body);
+}
+
+// ETag из If-None-Match: "*" или один из перечисленных через запятую
+static int etag_matches(const slice_t* value, const char* etag) {
+    if (value->len == 1 && value->ptr[0] == '*') {
+        return 1;
+    }
+    return memmem(value->ptr, value->len, etag, strlen(etag)) != NULL;
+}
+
+// Условный запрос, для которого у клиента уже есть актуальная версия файла.
+// If-Modified-Since сравнивается с Last-Modified как строка
+static int not_modified(conn_t* req, const file_entry_t* file, const char* etag) {
+    const slice_t *none_match = http_header(&req->parser, "If-None-Match");
+    if (none_match != NULL) {
+        return etag_matches(none_match, etag);
+    }
+    const slice_t *modified_since = http_header(&req->parser, "If-Modified-Since");
+    return modified_since != NULL && modified_since->len == strlen(file->last_modified) &&
+           memcmp(modified_since->ptr, file->last_modified, modified_since->len) == 0;
+}
+
+// Сжатый вариант файла в памяти, если клиент его принимает. Диапазоны
+// отдаются только из несжатого файла
+static file_encoding_t choose_encoding(conn_t* req, const file_entry_t* file) {
+    const slice_t *accept = http_header(&req->parser, "Accept-Encoding");
+    if (accept == NULL || http_header(&req->parser, "Range") != NULL) {
+        return FILE_IDENTITY;
+    }
+    if (file->bodies[FILE_BR] != NULL && http_accepts_encoding(accept, "br")) {
+        return FILE_BR;
+    }
+    if (file->bodies[FILE_GZIP] != NULL && http_accepts_encoding(accept, "gzip")) {
+        return FILE_GZIP;
+    }
+    return FILE_IDENTITY;
+}
+
+// Заголовки ответа 200 для файла в памяти готовятся при первой отдаче,
+// для запроса они копируются и дописывается Connection
+static void write_body_headers(conn_t* req, const file_entry_t* file, file_body_t* body, file_encoding_t encoding) {
+    if (body->response_len == 0) {
+        body->response_len = snprintf(body->response, FILE_RESPONSE_SZ, OK_HEADERS, (long)body->size,
+                                      body->etag, file->headers, encoding_header[encoding]);
+    }
+    memcpy(req->res_buf, body->response, body->response_len);
+    req->res_size = body->response_len;
+    req->res_size += snprintf(req->res_buf + req->res_size, BUF_SZ - req->res_size, CONNECTION_HEADER,
+                              conn_header(req));
+}
+
+// Подготовка ответа на запрос файла: заголовки в res_buf, тело
+// отправляется в flush_res из памяти или из файла. Файл и его заголовки
+// берутся из кеша потока, для повторного запроса системных вызовов до отправки нет
+static void write_res(file_cache_t* files, conn_t* req) {
+    file_entry_t *file = file_cache_open(files, req->url);
+    if (file == NULL && errno == EACCES) {
+        req->status = 403;
+        req->res_size = snprintf(req->res_buf, BUF_SZ, FORBIDDEN_RESPONSE, (146 + (int)req->url_len),
+                                 conn_header(req), req->url);
+        return;
+    }
+    if (file == NULL) {
+        req->status = 404;
+        req->res_size = snprintf(req->res_buf, BUF_SZ, NOT_FOUND_RESPONSE, conn_header(req));
+        return;
+    }
+
+    const file_encoding_t encoding = choose_encoding(req, file);
+    file_body_t *body = file->bodies[encoding];
+    const char *etag = body ? body->etag : file->etag;
+    if (not_modified(req, file, etag)) {
+        req->status = 304;
+        req->res_size = snprintf(req->res_buf, BUF_SZ, NOT_MODIFIED_RESPONSE, conn_header(req), etag,
+                                 file->headers);
+        file_cache_release(files, file);
+        return;
+    }
+
+    const long size = body ? (long)body->size : file->size;
+    long long start = 0, end = size;
+    const slice_t *range = http_header(&req->parser, "Range");
+    switch (range ? http_parse_range(range, size, &start, &end) : HTTP_RANGE_NONE) {
+    case HTTP_RANGE_OK:
+        req->status = 206;
+        req->res_size = snprintf(req->res_buf, BUF_SZ, PARTIAL_RESPONSE, (long)start, (long)end - 1, size,
+                                 (long)(end - start), conn_header(req), etag, file->headers);
+        break;
+    case HTTP_RANGE_UNSATISFIABLE:
+        req->status = 416;
+        req->res_size = snprintf(req->res_buf, BUF_SZ, RANGE_ERROR_RESPONSE, size, conn_header(req));
+        file_cache_release(files, file);
+        return;
+    default:
+        req->status = 200;
+        if (body != NULL) {
+            write_body_headers(req, file, body, encoding);
+        } else {
+            req->res_size = snprintf(req->res_buf, BUF_SZ, OK_RESPONSE, size, etag, file->headers, "",
+                                     conn_header(req));
+        }
+        break;
+    }
+
+    if (req->parser.method == HTTP_HEAD || start == end) {
+        file_cache_release(files, file);
+        return;
+    }
+    req->file = file;
+    req->body = body ? body->data : NULL;
+    req->file_offset = start;
+    req->file_end = end;
+}
+
+// Служебный путь со счетчиками всех потоков, не файл каталога сервера
+static int is_stats_path(const slice_t* path) {
+    return path->len == strlen(STATS_PATH) && memcmp(path->ptr, STATS_PATH, path->len) == 0;
+}
+
+// Тело растет с числом потоков, поэтому собирается в куче и уходит
+// через body, как файл из памяти
+static void write_stats(conn_t* req) {
+    size_t body_len;
+    char *body = stats_render(&body_len);
+    if (body == NULL) {
+        write_error(req, 500);
+        return;
+    }
+    req->status = 200;
+    req->res_size = snprintf(req->res_buf, BUF_SZ, STATS_RESPONSE, body_len, conn_header(req));
+    if (req->parser.method == HTTP_HEAD) {
+        free(body);
+        return;
+    }
+    req->body_buf = body;
+    req->body = body;
+    req->file_offset = 0;
+    req->file_end = body_len;
+}
+
+// Размер тела для журнала: из файла или памяти, иначе после заголовков в res_buf
+static off_t res_body_size(const conn_t* conn) {
+    if (conn->body != NULL || conn->file != NULL) {
+        return conn->file_end - conn->file_offset;
+    }
+    const char *end = memmem(conn->res_buf, conn->res_size, "\r\n\r\n", 4);
+    return end != NULL ? (off_t)(conn->res_buf + conn->res_size - end - 4) : 0;
+}
+
+int prepare_res(file_cache_t* files, conn_t* conn) {
+    http_parse_result_t result = http_parse(&conn->parser, conn->req_buf, conn->req_size);
+    if (result == HTTP_PARSE_AGAIN) {
+        if (conn->req_size < BUF_SZ) {
+            return 0;
+        }
+        result = HTTP_PARSE_TOO_LARGE;
+    }
+
+    if (result != HTTP_PARSE_DONE) {
+        write_error(conn, http_parse_status(result));
+        conn->body_size = res_body_size(conn);
+        return 1;
+    }
+
+    conn->requests++;
+    conn->keep_alive = conn->requests < KEEPALIVE_MAX && want_keep_alive(conn);
+    if (is_stats_path(&conn->parser.path)) {
+        write_stats(conn);
+    } else if (set_url(conn) == 0) {
+        write_res(files, conn);
+    } else {
+        write_error(conn, 403);
+    }
+    conn->body_size = res_body_size(conn);
+    return 1;
+}
+
+void release_res(file_cache_t* files, conn_t* conn) {
+    if (conn->file != NULL) {
+        file_cache_release(files, conn->file);
+        conn->file = NULL;
+    }
+    free(conn->body_buf);
+    conn->body_buf = NULL;
+    conn->body = NULL;
+}
@@ -0,0 +1,18 @@
+#pragma once
+
+#include "conn.h"
+#include "file_cache.h"
+
+// Запросов в одном постоянном соединении
+#define KEEPALIVE_MAX 1000
+
+// Разбор очередного запроса из буфера соединения и подготовка ответа на него:
+// заголовки в res_buf, тело в file/body с file_offset до file_end.
+// Возвращает 1, если ответ подготовлен (в том числе ответ с ошибкой),
+// 0, если для разбора нужны следующие данные. Общая для всех способов ввода-вывода.
+// Код ответа и размер тела для журнала остаются в status и body_size,
+// путь /__stats отвечает счетчиками потоков
+int prepare_res(file_cache_t* files, conn_t* conn);
+
+// Освобождение файла отправленного или прерванного ответа
+void release_res(file_cache_t* files, conn_t* conn);
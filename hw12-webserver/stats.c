@@ -0,0 +1,119 @@
+#include "stats.h"
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Наибольший объект счетчиков: пять полей и коды ответа по 20 цифр
+#define STATS_OBJECT_MAX 512
+
+static const int status_codes[STATS_STATUS_CODES] = {
+    200, 206, 304, 400, 403, 404, 416, 431, 500, 501, 505
+};
+
+// Потоки создаются один раз при запуске, их счетчики живут до конца работы
+static worker_stats_t *all_stats;
+static size_t          all_count;
+
+worker_stats_t *stats_create(size_t count) {
+    void *stats;
+    if (posix_memalign(&stats, 64, count * sizeof(worker_stats_t)) != 0) {
+        return NULL;
+    }
+    memset(stats, 0, count * sizeof(worker_stats_t));
+    all_stats = stats;
+    all_count = count;
+    return stats;
+}
+
+void stats_response(worker_stats_t *stats, int status, uint64_t bytes) {
+    int i = 0;
+    while (i < STATS_STATUS_CODES && status_codes[i] != status) {
+        i++;
+    }
+    stats_add(&stats->requests, 1);
+    stats_add(&stats->bytes, bytes);
+    stats_add(&stats->status[i], 1);
+}
+
+static uint64_t load(const uint64_t *counter) {
+    return __atomic_load_n(counter, __ATOMIC_RELAXED);
+}
+
+// snprintf с продолжением с позиции *len, при нехватке места *len не меняется
+static int append(char *buf, size_t size, size_t *len, const char *fmt, ...)
+    __attribute__((format(printf, 4, 5)));
+
+static int append(char *buf, size_t size, size_t *len, const char *fmt, ...) {
+    va_list args;
+    va_start(args, fmt);
+    int res = vsnprintf(buf + *len, size - *len, fmt, args);
+    va_end(args);
+    if (res < 0 || (size_t)res >= size - *len) {
+        buf[*len] = '\0';
+        return -1;
+    }
+    *len += res;
+    return 0;
+}
+
+// Поля счетчиков без закрывающей скобки, объект потока и сумма одинаковые
+static void render_counters(char *buf, size_t size, size_t *len, const worker_stats_t *stats) {
+    append(buf, size, len,
+           "{\"requests\":%llu,\"bytes\":%llu,\"active\":%llu,\"accepted\":%llu,\"accept_errors\":%llu,\"status\":{",
+           (unsigned long long)stats->requests, (unsigned long long)stats->bytes,
+           (unsigned long long)stats->active, (unsigned long long)stats->accepted,
+           (unsigned long long)stats->accept_errors);
+    for (int code = 0; code < STATS_STATUS_CODES; code++) {
+        append(buf, size, len, "\"%d\":%llu,", status_codes[code], (unsigned long long)stats->status[code]);
+    }
+    append(buf, size, len, "\"other\":%llu}", (unsigned long long)stats->status[STATS_STATUS_CODES]);
+}
+
+char *stats_render(size_t *len) {
+    // Снимок всех потоков, чтобы сумма совпадала с объектами потоков
+    void *snapshot_buf;
+    if (posix_memalign(&snapshot_buf, 64, all_count * sizeof(worker_stats_t)) != 0) {
+        return NULL;
+    }
+    worker_stats_t *snapshot = snapshot_buf;
+    const size_t size = (all_count + 1) * STATS_OBJECT_MAX + 32;
+    char *buf = malloc(size);
+    if (buf == NULL) {
+        free(snapshot);
+        return NULL;
+    }
+
+    worker_stats_t total = { 0 };
+    for (size_t i = 0; i < all_count; i++) {
+        const worker_stats_t *stats = &all_stats[i];
+        worker_stats_t *copy = &snapshot[i];
+        copy->requests = load(&stats->requests);
+        copy->bytes = load(&stats->bytes);
+        copy->accepted = load(&stats->accepted);
+        copy->accept_errors = load(&stats->accept_errors);
+        copy->active = load(&stats->active);
+        total.requests += copy->requests;
+        total.bytes += copy->bytes;
+        total.accepted += copy->accepted;
+        total.accept_errors += copy->accept_errors;
+        total.active += copy->active;
+        for (int code = 0; code <= STATS_STATUS_CODES; code++) {
+            copy->status[code] = load(&stats->status[code]);
+            total.status[code] += copy->status[code];
+        }
+    }
+
+    *len = 0;
+    render_counters(buf, size, len, &total);
+    append(buf, size, len, ",\"workers\":[");
+    for (size_t i = 0; i < all_count; i++) {
+        append(buf, size, len, "%s", i ? "," : "");
+        render_counters(buf, size, len, &snapshot[i]);
+        append(buf, size, len, "}");
+    }
+    append(buf, size, len, "]}\n");
+    free(snapshot);
+    return buf;
+}
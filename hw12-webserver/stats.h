@@ -0,0 +1,38 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Коды ответа со своим счетчиком, остальные считаются в последнем
+#define STATS_STATUS_CODES 11
+
+// Счетчики рабочего потока. Пишет их только сам поток, читает /__stats
+// из любого потока: обновление - обычная запись без блокировки шины,
+// чтение и запись атомарные, чтобы не увидеть половину значения.
+// Выравнивание по строке кеша: счетчики соседних потоков не делят строку
+typedef struct {
+    uint64_t requests;
+    uint64_t bytes;
+    uint64_t accepted;
+    uint64_t accept_errors;
+    uint64_t active;
+    uint64_t status[STATS_STATUS_CODES + 1];
+} __attribute__((aligned(64))) worker_stats_t;
+
+static inline void stats_add(uint64_t *counter, uint64_t value) {
+    __atomic_store_n(counter, *counter + value, __ATOMIC_RELAXED);
+}
+
+static inline void stats_set(uint64_t *counter, uint64_t value) {
+    __atomic_store_n(counter, value, __ATOMIC_RELAXED);
+}
+
+// Счетчики для count рабочих потоков, обнуленные. NULL при нехватке памяти
+worker_stats_t *stats_create(size_t count);
+
+// Учет отправленного ответа с кодом status размера bytes вместе с заголовками
+void stats_response(worker_stats_t *stats, int status, uint64_t bytes);
+
+// Сумма счетчиков всех потоков и сами потоки в JSON длины *len
+// в выделенном буфере, его освобождает вызывающий. NULL при нехватке памяти
+char *stats_render(size_t *len);
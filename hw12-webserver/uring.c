@@ -0,0 +1,662 @@
+#define _GNU_SOURCE
+
+#include "uring.h"
+#include "response.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <netinet/in.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+
+#define URING_ENTRIES 4096
+// Буферы для recv, которые ядро выбирает само: память занята только
+// на время от приема данных до их копирования в буфер запроса
+#define RECV_BUFS 1024
+#define RECV_GROUP 0
+// Байт файла за одну пару splice, не больше емкости канала по умолчанию
+#define SPLICE_CHUNK (64 * 1024)
+// Операций в одной цепочке ответа: заголовки, две части splice, close
+#define CHAIN_MAX 4
+
+// user_data: указатель на соединение и вид операции в младших битах.
+// Служебные операции - малые числа, указателями они быть не могут
+enum {
+    OP_RECV = 0,
+    OP_SEND_HEAD,
+    OP_SEND_BODY,
+    OP_SPLICE_IN,
+    OP_SPLICE_OUT,
+    OP_CLOSE,
+    OP_MASK = 7
+};
+
+#define ACCEPT_DATA 1
+#define TIMER_DATA 2
+#define FILES_DATA 3
+
+// conn->uring_state
+#define CONN_CLOSING 1  // close в очереди
+#define CONN_CLOSED  2  // сокет закрыт, соединение освобождается
+#define CONN_FAILED  4  // ошибка или клиент ушел, соединение закрывается
+
+typedef struct uring_s {
+    int       fd;
+    void     *sq_ptr;
+    size_t    sq_len;
+    void     *cq_ptr;
+    size_t    cq_len;
+    unsigned *sq_head;
+    unsigned *sq_tail;
+    unsigned *sq_mask;
+    unsigned *sq_array;
+    unsigned  sq_entries;
+    struct io_uring_sqe *sqes;
+    size_t    sqes_len;
+    unsigned *cq_head;
+    unsigned *cq_tail;
+    unsigned *cq_mask;
+    struct io_uring_cqe *cqes;
+    // Завершения, снятые с кольца, пока для операций не было места,
+    // разбираются раньше оставшихся в кольце
+    struct io_uring_cqe *backlog;
+    size_t    backlog_head;
+    size_t    backlog_len;
+    size_t    backlog_cap;
+    unsigned  to_submit;
+    struct io_uring_buf_ring *buf_ring;
+    char     *bufs;
+    unsigned  buf_tail;
+    struct __kernel_timespec tick;
+} uring_t;
+
+static int sys_setup(unsigned entries, struct io_uring_params *params) {
+    return syscall(__NR_io_uring_setup, entries, params);
+}
+
+static int sys_enter(int fd, unsigned to_submit, unsigned min_complete, unsigned flags) {
+    return syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, NULL, 0);
+}
+
+static int sys_register(int fd, unsigned opcode, void *arg, unsigned nr_args) {
+    return syscall(__NR_io_uring_register, fd, opcode, arg, nr_args);
+}
+
+// Отправка накопленных операций и ожидание хотя бы wait завершений
+static int uring_enter(uring_t *ring, unsigned wait) {
+    for (;;) {
+        int res = sys_enter(ring->fd, ring->to_submit, wait, wait ? IORING_ENTER_GETEVENTS : 0);
+        if (res >= 0) {
+            ring->to_submit -= res;
+            return 0;
+        }
+        if (errno == EINTR) {
+            continue;
+        }
+        // Очередь завершений переполнена: сначала нужно разобрать ее
+        if (errno == EBUSY || errno == EAGAIN) {
+            return 0;
+        }
+        perror("io_uring_enter");
+        return -1;
+    }
+}
+
+// Перенос всех завершений из кольца в backlog. Возвращает их количество
+static unsigned uring_stash(uring_t *ring) {
+    unsigned head = *ring->cq_head;
+    const unsigned tail = __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE);
+    const unsigned count = tail - head;
+    if (ring->backlog_len + count > ring->backlog_cap) {
+        size_t cap = ring->backlog_cap ? ring->backlog_cap : 64;
+        while (cap < ring->backlog_len + count) {
+            cap *= 2;
+        }
+        struct io_uring_cqe *backlog = realloc(ring->backlog, cap * sizeof(struct io_uring_cqe));
+        if (backlog == NULL) {
+            fprintf(stderr, "Out of memory for io_uring completions\n");
+            exit(EXIT_FAILURE);
+        }
+        ring->backlog = backlog;
+        ring->backlog_cap = cap;
+    }
+    for (; head != tail; head++) {
+        ring->backlog[ring->backlog_len++] = ring->cqes[head & *ring->cq_mask];
+    }
+    __atomic_store_n(ring->cq_head, head, __ATOMIC_RELEASE);
+    return count;
+}
+
+// Место под count операций подряд, чтобы цепочка не разделилась при отправке.
+// Ядро не принимает операции, пока очередь завершений переполнена (EBUSY):
+// тогда завершения переносятся в backlog, а без них ожидается хотя бы одно
+static void uring_reserve(uring_t *ring, unsigned count) {
+    while (*ring->sq_tail - __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE) + count > ring->sq_entries) {
+        const unsigned to_submit = ring->to_submit;
+        if (uring_enter(ring, 0) < 0) {
+            exit(EXIT_FAILURE);
+        }
+        if (ring->to_submit != to_submit || uring_stash(ring) != 0) {
+            continue;
+        }
+        if (sys_enter(ring->fd, 0, 1, IORING_ENTER_GETEVENTS) < 0 && errno != EINTR) {
+            perror("io_uring_enter");
+            exit(EXIT_FAILURE);
+        }
+    }
+}
+
+// Следующее завершение: сначала отложенные в backlog, затем из кольца
+static int uring_next_cqe(uring_t *ring, struct io_uring_cqe *cqe) {
+    if (ring->backlog_head < ring->backlog_len) {
+        *cqe = ring->backlog[ring->backlog_head++];
+        if (ring->backlog_head == ring->backlog_len) {
+            ring->backlog_head = ring->backlog_len = 0;
+        }
+        return 1;
+    }
+    const unsigned head = *ring->cq_head;
+    if (head == __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE)) {
+        return 0;
+    }
+    *cqe = ring->cqes[head & *ring->cq_mask];
+    __atomic_store_n(ring->cq_head, head + 1, __ATOMIC_RELEASE);
+    return 1;
+}
+
+static struct io_uring_sqe *uring_sqe(uring_t *ring, int opcode, int fd, uint64_t user_data) {
+    uring_reserve(ring, 1);
+    const unsigned tail = *ring->sq_tail;
+    const unsigned index = tail & *ring->sq_mask;
+    struct io_uring_sqe *sqe = &ring->sqes[index];
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->opcode = opcode;
+    sqe->fd = fd;
+    sqe->user_data = user_data;
+    ring->sq_array[index] = index;
+    __atomic_store_n(ring->sq_tail, tail + 1, __ATOMIC_RELEASE);
+    ring->to_submit++;
+    return sqe;
+}
+
+static void buf_recycle(uring_t *ring, unsigned bid) {
+    // Поля resv первого элемента заняты хвостом кольца, они не трогаются
+    struct io_uring_buf *buf = &ring->buf_ring->bufs[ring->buf_tail & (RECV_BUFS - 1)];
+    buf->addr = (uintptr_t)(ring->bufs + (size_t)bid * BUF_SZ);
+    buf->len = BUF_SZ;
+    buf->bid = bid;
+    ring->buf_tail++;
+    __atomic_store_n(&ring->buf_ring->tail, ring->buf_tail, __ATOMIC_RELEASE);
+}
+
+static void uring_free(uring_t *ring) {
+    if (ring->buf_ring != NULL) {
+        munmap(ring->buf_ring, RECV_BUFS * sizeof(struct io_uring_buf));
+    }
+    free(ring->bufs);
+    free(ring->backlog);
+    if (ring->sqes != NULL) {
+        munmap(ring->sqes, ring->sqes_len);
+    }
+    if (ring->cq_ptr != NULL && ring->cq_ptr != ring->sq_ptr) {
+        munmap(ring->cq_ptr, ring->cq_len);
+    }
+    if (ring->sq_ptr != NULL) {
+        munmap(ring->sq_ptr, ring->sq_len);
+    }
+    if (ring->fd >= 0) {
+        close(ring->fd);
+    }
+    free(ring);
+}
+
+// Все используемые операции должны поддерживаться ядром
+static int uring_probe(uring_t *ring) {
+    static const int ops[] = {
+        IORING_OP_ACCEPT, IORING_OP_RECV, IORING_OP_SEND, IORING_OP_SPLICE,
+        IORING_OP_CLOSE, IORING_OP_TIMEOUT, IORING_OP_POLL_ADD
+    };
+    const size_t size = sizeof(struct io_uring_probe) + IORING_OP_LAST * sizeof(struct io_uring_probe_op);
+    struct io_uring_probe *probe = calloc(1, size);
+    if (sys_register(ring->fd, IORING_REGISTER_PROBE, probe, IORING_OP_LAST) < 0) {
+        free(probe);
+        return -1;
+    }
+    for (size_t i = 0; i < sizeof(ops) / sizeof(ops[0]); i++) {
+        if (ops[i] > probe->last_op || !(probe->ops[ops[i]].flags & IO_URING_OP_SUPPORTED)) {
+            free(probe);
+            errno = EOPNOTSUPP;
+            return -1;
+        }
+    }
+    free(probe);
+    return 0;
+}
+
+static int uring_setup(uring_t *ring) {
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    params.flags = IORING_SETUP_SUBMIT_ALL | IORING_SETUP_COOP_TASKRUN;
+    ring->fd = sys_setup(URING_ENTRIES, &params);
+    if (ring->fd < 0 && errno == EINVAL) {
+        memset(&params, 0, sizeof(params));
+        ring->fd = sys_setup(URING_ENTRIES, &params);
+    }
+    if (ring->fd < 0) {
+        return -1;
+    }
+
+    ring->sq_len = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    ring->cq_len = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    if (params.features & IORING_FEAT_SINGLE_MMAP) {
+        ring->sq_len = ring->cq_len = ring->sq_len > ring->cq_len ? ring->sq_len : ring->cq_len;
+    }
+    ring->sq_ptr = mmap(NULL, ring->sq_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                        ring->fd, IORING_OFF_SQ_RING);
+    if (ring->sq_ptr == MAP_FAILED) {
+        ring->sq_ptr = NULL;
+        return -1;
+    }
+    if (params.features & IORING_FEAT_SINGLE_MMAP) {
+        ring->cq_ptr = ring->sq_ptr;
+    } else {
+        ring->cq_ptr = mmap(NULL, ring->cq_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                            ring->fd, IORING_OFF_CQ_RING);
+        if (ring->cq_ptr == MAP_FAILED) {
+            ring->cq_ptr = NULL;
+            return -1;
+        }
+    }
+    ring->sqes_len = params.sq_entries * sizeof(struct io_uring_sqe);
+    ring->sqes = mmap(NULL, ring->sqes_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                      ring->fd, IORING_OFF_SQES);
+    if (ring->sqes == MAP_FAILED) {
+        ring->sqes = NULL;
+        return -1;
+    }
+
+    char *sq = ring->sq_ptr;
+    char *cq = ring->cq_ptr;
+    ring->sq_head = (unsigned*)(sq + params.sq_off.head);
+    ring->sq_tail = (unsigned*)(sq + params.sq_off.tail);
+    ring->sq_mask = (unsigned*)(sq + params.sq_off.ring_mask);
+    ring->sq_array = (unsigned*)(sq + params.sq_off.array);
+    ring->sq_entries = params.sq_entries;
+    ring->cq_head = (unsigned*)(cq + params.cq_off.head);
+    ring->cq_tail = (unsigned*)(cq + params.cq_off.tail);
+    ring->cq_mask = (unsigned*)(cq + params.cq_off.ring_mask);
+    ring->cqes = (struct io_uring_cqe*)(cq + params.cq_off.cqes);
+
+    if (uring_probe(ring) < 0) {
+        return -1;
+    }
+
+    // Кольцо буферов для recv (ядро 5.19+, там же и многоразовый accept)
+    ring->buf_ring = mmap(NULL, RECV_BUFS * sizeof(struct io_uring_buf), PROT_READ | PROT_WRITE,
+                          MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (ring->buf_ring == MAP_FAILED) {
+        ring->buf_ring = NULL;
+        return -1;
+    }
+    struct io_uring_buf_reg reg;
+    memset(&reg, 0, sizeof(reg));
+    reg.ring_addr = (uintptr_t)ring->buf_ring;
+    reg.ring_entries = RECV_BUFS;
+    reg.bgid = RECV_GROUP;
+    if (sys_register(ring->fd, IORING_REGISTER_PBUF_RING, &reg, 1) < 0) {
+        return -1;
+    }
+    ring->bufs = malloc((size_t)RECV_BUFS * BUF_SZ);
+    if (ring->bufs == NULL) {
+        return -1;
+    }
+    for (unsigned bid = 0; bid < RECV_BUFS; bid++) {
+        buf_recycle(ring, bid);
+    }
+    return 0;
+}
+
+int uring_init(worker_t *worker) {
+    uring_t *ring = calloc(1, sizeof(uring_t));
+    ring->fd = -1;
+    if (uring_setup(ring) < 0) {
+        fprintf(stderr, "Worker %d: io_uring unavailable (%s), using epoll\n", worker->id, strerror(errno));
+        uring_free(ring);
+        return -1;
+    }
+
+    // Операции кольца сами ждут готовности сокета, O_NONBLOCK им не нужен
+    int opts = fcntl(worker->server, F_GETFL);
+    if (opts >= 0) {
+        fcntl(worker->server, F_SETFL, opts & ~O_NONBLOCK);
+    }
+    ring->tick.tv_sec = 1;
+    worker->uring = ring;
+    return 0;
+}
+
+static void submit_accept(worker_t *worker) {
+    struct io_uring_sqe *sqe = uring_sqe(worker->uring, IORING_OP_ACCEPT, worker->server, ACCEPT_DATA);
+    sqe->accept_flags = SOCK_CLOEXEC;
+    sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+}
+
+static void submit_timer(worker_t *worker) {
+    struct io_uring_sqe *sqe = uring_sqe(worker->uring, IORING_OP_TIMEOUT, -1, TIMER_DATA);
+    sqe->addr = (uintptr_t)&worker->uring->tick;
+    sqe->len = 1;
+}
+
+static void submit_files(worker_t *worker) {
+    const int inotify = file_cache_fd(&worker->files);
+    if (inotify >= 0) {
+        struct io_uring_sqe *sqe = uring_sqe(worker->uring, IORING_OP_POLL_ADD, inotify, FILES_DATA);
+        sqe->poll32_events = POLLIN;
+        sqe->len = IORING_POLL_ADD_MULTI;
+    }
+}
+
+static struct io_uring_sqe *conn_sqe(uring_t *ring, conn_t *conn, int opcode, int fd, int op) {
+    conn->uring_pending++;
+    return uring_sqe(ring, opcode, fd, (uintptr_t)conn | op);
+}
+
+static void submit_recv(uring_t *ring, conn_t *conn) {
+    struct io_uring_sqe *sqe = conn_sqe(ring, conn, IORING_OP_RECV, conn->sock, OP_RECV);
+    sqe->len = BUF_SZ - conn->req_size;
+    sqe->flags = IOSQE_BUFFER_SELECT;
+    sqe->buf_group = RECV_GROUP;
+}
+
+// Связь prev со следующей операцией. Короткий send без MSG_WAITALL
+// считается успешным и цепочку не прерывает: следующая операция ушла бы
+// раньше неотправленного остатка, поэтому send перед связью ждет отправки
+// всех данных, а при ошибке завершается коротким и прерывает цепочку
+static void link_sqe(struct io_uring_sqe *prev) {
+    if (prev == NULL) {
+        return;
+    }
+    prev->flags |= IOSQE_IO_LINK;
+    if (prev->opcode == IORING_OP_SEND) {
+        prev->msg_flags |= MSG_WAITALL;
+    }
+}
+
+static void submit_close(uring_t *ring, conn_t *conn, struct io_uring_sqe *prev) {
+    link_sqe(prev);
+    conn_sqe(ring, conn, IORING_OP_CLOSE, conn->sock, OP_CLOSE);
+    conn->uring_state |= CONN_CLOSING;
+}
+
+static struct io_uring_sqe *submit_splice(uring_t *ring, conn_t *conn, int op, int fd_in, int64_t off_in,
+                                          int fd_out, size_t len, unsigned flags) {
+    struct io_uring_sqe *sqe = conn_sqe(ring, conn, IORING_OP_SPLICE, fd_out, op);
+    sqe->splice_fd_in = fd_in;
+    sqe->splice_off_in = off_in;
+    sqe->off = (uint64_t)-1;
+    sqe->len = len;
+    sqe->splice_flags = flags;
+    return sqe;
+}
+
+// Отправка оставшейся части ответа одной цепочкой связанных операций:
+// заголовки, тело из памяти или пара splice файл -> канал -> сокет,
+// для последнего ответа соединения - close. Короткий splice прерывает
+// цепочку сам, send - только с MSG_WAITALL (link_sqe). Остаток после
+// прерванной цепочки отправляет следующая
+static int submit_res(uring_t *ring, conn_t *conn) {
+    struct io_uring_sqe *prev = NULL;
+    const off_t left = conn->file_end - conn->file_offset;
+    int complete = 1;
+
+    uring_reserve(ring, CHAIN_MAX);
+    if (conn->res_sent < conn->res_size) {
+        prev = conn_sqe(ring, conn, IORING_OP_SEND, conn->sock, OP_SEND_HEAD);
+        prev->addr = (uintptr_t)(conn->res_buf + conn->res_sent);
+        prev->len = conn->res_size - conn->res_sent;
+        prev->msg_flags = MSG_NOSIGNAL | (conn->file != NULL || conn->body != NULL ? MSG_MORE : 0);
+    }
+
+    if (conn->body != NULL && left > 0) {
+        link_sqe(prev);
+        prev = conn_sqe(ring, conn, IORING_OP_SEND, conn->sock, OP_SEND_BODY);
+        prev->addr = (uintptr_t)(conn->body + conn->file_offset);
+        prev->len = left;
+        prev->msg_flags = MSG_NOSIGNAL;
+    } else if (conn->file != NULL && conn->body == NULL && (left > 0 || conn->pipe_data > 0)) {
+        if (conn->pipe[0] < 0 && pipe2(conn->pipe, O_CLOEXEC) < 0) {
+            perror("pipe2");
+            return -1;
+        }
+        size_t chunk = conn->pipe_data;
+        if (chunk == 0) {
+            chunk = left < SPLICE_CHUNK ? (size_t)left : SPLICE_CHUNK;
+            link_sqe(prev);
+            prev = submit_splice(ring, conn, OP_SPLICE_IN, conn->file->fd, conn->file_offset,
+                                 conn->pipe[1], chunk, SPLICE_F_MOVE);
+        }
+        complete = (off_t)(chunk - conn->pipe_data) == left;
+        link_sqe(prev);
+        prev = submit_splice(ring, conn, OP_SPLICE_OUT, conn->pipe[0], -1, conn->sock, chunk,
+                             SPLICE_F_MOVE | (complete ? 0 : SPLICE_F_MORE));
+    }
+
+    if (complete && !conn->keep_alive) {
+        submit_close(ring, conn, prev);
+    }
+    return 0;
+}
+
+static int res_done(const conn_t *conn) {
+    return conn->res_sent == conn->res_size &&
+           ((conn->file == NULL && conn->body == NULL) ||
+            (conn->file_offset == conn->file_end && conn->pipe_data == 0));
+}
+
+// Ответ без keep-alive уходит одной цепочкой с закрытием сокета
+// и учитывается здесь, если отправлен полностью
+static void conn_free(worker_t *worker, conn_t *conn) {
+    if (conn->res_size != 0 && res_done(conn)) {
+        finish_res(worker, conn);
+    } else {
+        release_res(&worker->files, conn);
+    }
+    if (conn->pipe[0] >= 0) {
+        close(conn->pipe[0]);
+        close(conn->pipe[1]);
+    }
+    conn_release(&worker->pool, conn);
+    stats_set(&worker->stats->active, worker->pool.active);
+}
+
+// Следующий шаг соединения, когда все его операции завершены:
+// продолжение ответа, разбор следующего запроса, чтение или закрытие
+static void conn_step(worker_t *worker, conn_t *conn) {
+    uring_t *ring = worker->uring;
+    if (conn->uring_state & CONN_CLOSED) {
+        conn_free(worker, conn);
+        return;
+    }
+    if (conn->uring_state & CONN_FAILED) {
+        submit_close(ring, conn, NULL);
+        return;
+    }
+
+    for (;;) {
+        if (conn->res_size != 0) {
+            if (!res_done(conn)) {
+                if (submit_res(ring, conn) < 0) {
+                    submit_close(ring, conn, NULL);
+                }
+                return;
+            }
+            if (!conn->keep_alive) {
+                submit_close(ring, conn, NULL);
+                return;
+            }
+            finish_res(worker, conn);
+            conn_next_request(conn, conn->parser.length);
+        }
+
+        if (prepare_res(&worker->files, conn) == 0) {
+            submit_recv(ring, conn);
+            return;
+        }
+    }
+}
+
+static void on_recv(uring_t *ring, conn_t *conn, int res, unsigned flags) {
+    if (flags & IORING_CQE_F_BUFFER) {
+        const unsigned bid = flags >> IORING_CQE_BUFFER_SHIFT;
+        if (res > 0) {
+            memcpy(conn->req_buf + conn->req_size, ring->bufs + (size_t)bid * BUF_SZ, res);
+            conn->req_size += res;
+        }
+        buf_recycle(ring, bid);
+    }
+    // Без свободных буферов recv повторяется со следующим шагом
+    if (res <= 0 && res != -ENOBUFS) {
+        conn->uring_state |= CONN_FAILED;
+    }
+}
+
+static void on_conn(worker_t *worker, conn_t *conn, int op, int res, unsigned flags, time_t now) {
+    conn->uring_pending--;
+    if (res < 0 && res != -ECANCELED && op != OP_RECV && op != OP_CLOSE) {
+        conn->uring_state |= CONN_FAILED;
+    }
+
+    switch (op) {
+    case OP_RECV:
+        on_recv(worker->uring, conn, res, flags);
+        break;
+    case OP_SEND_HEAD:
+        if (res > 0) {
+            conn->res_sent += res;
+        }
+        break;
+    case OP_SEND_BODY:
+        if (res > 0) {
+            conn->file_offset += res;
+        }
+        break;
+    case OP_SPLICE_IN:
+        if (res > 0) {
+            conn->file_offset += res;
+            conn->pipe_data += res;
+        } else if (res == 0) {
+            // Файл укоротился после fstat, Content-Length уже не выполнить
+            conn->uring_state |= CONN_FAILED;
+        }
+        break;
+    case OP_SPLICE_OUT:
+        if (res > 0) {
+            conn->pipe_data -= res;
+        }
+        break;
+    case OP_CLOSE:
+        conn->uring_state &= ~CONN_CLOSING;
+        if (res != -ECANCELED) {
+            conn->uring_state |= CONN_CLOSED;
+        }
+        break;
+    }
+
+    if (!(conn->uring_state & CONN_CLOSED)) {
+        conn_touch(&worker->pool, conn, now);
+    }
+    if (conn->uring_pending == 0) {
+        conn_step(worker, conn);
+    }
+}
+
+static void on_accept(worker_t *worker, int res, unsigned flags, time_t now) {
+    if (!(flags & IORING_CQE_F_MORE)) {
+        submit_accept(worker);
+    }
+    if (res < 0) {
+        if (res != -EAGAIN && res != -EINTR && res != -ECONNABORTED) {
+            fprintf(stderr, "accept: %s\n", strerror(-res));
+            stats_add(&worker->stats->accept_errors, 1);
+        }
+        return;
+    }
+
+    conn_t *conn = conn_alloc(&worker->pool, res, now);
+    if (conn == NULL) {
+        fprintf(stderr, "Out of memory for connection %d\n", res);
+        close(res);
+        stats_add(&worker->stats->accept_errors, 1);
+        return;
+    }
+    // Многоразовый accept не возвращает адрес клиента, он нужен только журналу
+    if (worker->log.fd >= 0) {
+        struct sockaddr_in addr;
+        socklen_t addr_len = sizeof(addr);
+        if (getpeername(res, (struct sockaddr*)&addr, &addr_len) == 0) {
+            conn->peer_addr = addr.sin_addr.s_addr;
+        }
+    }
+    stats_add(&worker->stats->accepted, 1);
+    stats_set(&worker->stats->active, worker->pool.active);
+    submit_recv(worker->uring, conn);
+}
+
+// Простаивающим соединениям сокет закрывается на чтение и запись:
+// их операции завершаются с ошибкой, и соединение закрывается обычным путем
+static void shutdown_idle(worker_t *worker, time_t now) {
+    conn_t *conn;
+    while ((conn = conn_idle_oldest(&worker->pool)) != NULL && now - conn->last_active >= IDLE_TIMEOUT) {
+        shutdown(conn->sock, SHUT_RDWR);
+        conn_touch(&worker->pool, conn, now);
+    }
+}
+
+void uring_run(worker_t *worker) {
+    uring_t *ring = worker->uring;
+    submit_accept(worker);
+    submit_timer(worker);
+    submit_files(worker);
+
+    for (;;) {
+        if (uring_enter(ring, 1) < 0) {
+            break;
+        }
+        const time_t now = now_sec();
+        // Обработчики могут перенести завершения кольца в backlog (uring_reserve),
+        // поэтому голова кольца перечитывается для каждого
+        struct io_uring_cqe cqe;
+        while (uring_next_cqe(ring, &cqe)) {
+            const uint64_t data = cqe.user_data;
+            const int res = cqe.res;
+            const unsigned flags = cqe.flags;
+
+            switch (data) {
+            case ACCEPT_DATA:
+                on_accept(worker, res, flags, now);
+                break;
+            case TIMER_DATA:
+                shutdown_idle(worker, now);
+                access_log_flush(&worker->log);
+                submit_timer(worker);
+                break;
+            case FILES_DATA:
+                file_cache_process_events(&worker->files);
+                if (!(flags & IORING_CQE_F_MORE)) {
+                    submit_files(worker);
+                }
+                break;
+            default:
+                on_conn(worker, (conn_t*)(uintptr_t)(data & ~(uint64_t)OP_MASK), data & OP_MASK, res, flags, now);
+                break;
+            }
+        }
+    }
+}
@@ -0,0 +1,12 @@
+#pragma once
+
+#include "worker.h"
+
+// Кольцо io_uring для рабочего потока вместо epoll: accept, recv, отправка
+// ответа и закрытие соединения идут операциями кольца, разбор запроса
+// и подготовка ответа те же, что для epoll.
+// Возвращает -1, если ядро не поддерживает io_uring или нужные операции
+int uring_init(worker_t *worker);
+
+// Цикл обработки событий кольца рабочего потока
+void uring_run(worker_t *worker);
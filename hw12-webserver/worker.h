@@ -0,0 +1,40 @@
+#pragma once
+
+#include <pthread.h>
+#include <time.h>
+#include <sys/epoll.h>
+
+#include "access_log.h"
+#include "conn.h"
+#include "file_cache.h"
+#include "stats.h"
+
+// Событий за один epoll_wait, на количество соединений не влияет
+#define EPOLL_MAX 128
+// Соединение без активности закрывается через IDLE_TIMEOUT секунд
+#define IDLE_TIMEOUT 15
+
+// Рабочий поток: свой слушающий сокет с SO_REUSEPORT, свой epoll или
+// io_uring и пул соединений, общих данных между потоками на пути запроса нет
+typedef struct {
+    int         id;
+    int         cpu;
+    int         server;
+    conn_pool_t pool;
+    file_cache_t files;
+    pthread_t   thread;
+    worker_stats_t *stats;
+    access_log_t log;
+    // epoll
+    int         epoll;
+    int         timer;
+    struct epoll_event events[EPOLL_MAX];
+    // Кольцо io_uring, NULL для epoll
+    struct uring_s *uring;
+} worker_t;
+
+// Учет отправленного ответа в счетчиках и журнале и освобождение его файла
+void finish_res(worker_t* worker, conn_t* conn);
+
+// Монотонное время в секундах для учета простоя
+time_t now_sec(void);